@@ -0,0 +1,367 @@
+#include "pch.h"
+#include "Base64.h"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cstring>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define BASE64_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+// MSVC exposes all intrinsics unconditionally; GCC/Clang need the target enabled per function
+#if defined(BASE64_X86) && (defined(__GNUC__) || defined(__clang__))
+#define BASE64_TARGET(isa) __attribute__((target(isa)))
+#else
+#define BASE64_TARGET(isa)
+#endif
+
+namespace {
+	const char kAlphabet[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+		"abcdefghijklmnopqrstuvwxyz"
+		"0123456789+/";
+
+	// Original byte-at-a-time encoder, kept verbatim as the reference
+	std::string encodeReference(const unsigned char* bytes_to_encode, size_t bytes_len) {
+		std::string ret;
+		int i = 0;
+		int j = 0;
+		unsigned char char_array_3[3];
+		unsigned char char_array_4[4];
+
+		while (bytes_len--) {
+			char_array_3[i++] = *(bytes_to_encode++);
+			if (i == 3) {
+				char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+				char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+				char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+				char_array_4[3] = char_array_3[2] & 0x3f;
+
+				for (i = 0; (i < 4); i++)
+					ret += kAlphabet[char_array_4[i]];
+				i = 0;
+			}
+		}
+
+		if (i) {
+			for (j = i; j < 3; j++)
+				char_array_3[j] = '\0';
+
+			char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+			char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+			char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+			char_array_4[3] = char_array_3[2] & 0x3f;
+
+			for (j = 0; (j < i + 1); j++)
+				ret += kAlphabet[char_array_4[j]];
+
+			while ((i++ < 3))
+				ret += '=';
+		}
+
+		return ret;
+	}
+
+	// Encodes whole 3-byte groups plus the padded tail; used directly and for SIMD leftovers
+	size_t encodeScalar(const unsigned char* in, size_t size, char* out) {
+		char* start = out;
+		size_t i = 0;
+		for (; i + 3 <= size; i += 3) {
+			uint32_t v = (uint32_t(in[i]) << 16) | (uint32_t(in[i + 1]) << 8) | in[i + 2];
+			out[0] = kAlphabet[(v >> 18) & 0x3F];
+			out[1] = kAlphabet[(v >> 12) & 0x3F];
+			out[2] = kAlphabet[(v >> 6) & 0x3F];
+			out[3] = kAlphabet[v & 0x3F];
+			out += 4;
+		}
+
+		size_t remaining = size - i;
+		if (remaining) {
+			uint32_t v = uint32_t(in[i]) << 16;
+			if (remaining == 2) v |= uint32_t(in[i + 1]) << 8;
+			out[0] = kAlphabet[(v >> 18) & 0x3F];
+			out[1] = kAlphabet[(v >> 12) & 0x3F];
+			out[2] = remaining == 2 ? kAlphabet[(v >> 6) & 0x3F] : '=';
+			out[3] = '=';
+			out += 4;
+		}
+		return static_cast<size_t>(out - start);
+	}
+
+#ifdef BASE64_X86
+	// Split 12 input bytes (in the low lanes) into 16 six-bit indices, one per byte
+	BASE64_TARGET("ssse3")
+	inline __m128i unpackIndices(__m128i in) {
+		in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+		const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+		const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+		const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+		const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+		return _mm_or_si128(t1, t3);
+	}
+
+	// Map six-bit indices to ASCII by adding a per-range offset picked with pshufb
+	BASE64_TARGET("ssse3")
+	inline __m128i lookupASCII(__m128i indices) {
+		const __m128i shiftLUT = _mm_setr_epi8(
+			'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+		__m128i result = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+		result = _mm_or_si128(result, _mm_and_si128(less, _mm_set1_epi8(13)));
+		result = _mm_shuffle_epi8(shiftLUT, result);
+		return _mm_add_epi8(result, indices);
+	}
+
+	BASE64_TARGET("ssse3")
+	size_t encodeSSSE3(const unsigned char* in, size_t size, char* out) {
+		char* start = out;
+		size_t i = 0;
+		// Each step reads 16 bytes but consumes 12, so stop while a full load is still in bounds
+		for (; i + 16 <= size; i += 12) {
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out), lookupASCII(unpackIndices(block)));
+			out += 16;
+		}
+		out += encodeScalar(in + i, size - i, out);
+		return static_cast<size_t>(out - start);
+	}
+
+	BASE64_TARGET("avx2")
+	inline __m256i unpackIndices256(__m256i in) {
+		in = _mm256_shuffle_epi8(in, _mm256_set_epi8(
+			10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+			10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+		const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+		const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+		const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+		const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+		return _mm256_or_si256(t1, t3);
+	}
+
+	BASE64_TARGET("avx2")
+	inline __m256i lookupASCII256(__m256i indices) {
+		const __m256i shiftLUT = _mm256_setr_epi8(
+			'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+			'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+		__m256i result = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+		const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+		result = _mm256_or_si256(result, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+		result = _mm256_shuffle_epi8(shiftLUT, result);
+		return _mm256_add_epi8(result, indices);
+	}
+
+	BASE64_TARGET("avx2")
+	size_t encodeAVX2(const unsigned char* in, size_t size, char* out) {
+		char* start = out;
+		size_t i = 0;
+		// Two 12-byte groups per step, one per 128-bit lane; the upper load ends at i + 28
+		for (; i + 28 <= size; i += 24) {
+			__m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			__m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12));
+			__m256i block = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out), lookupASCII256(unpackIndices256(block)));
+			out += 32;
+		}
+		out += encodeSSSE3(in + i, size - i, out);
+		return static_cast<size_t>(out - start);
+	}
+
+	void cpuid(int info[4], int leaf, int subleaf) {
+#if defined(_MSC_VER)
+		__cpuidex(info, leaf, subleaf);
+#else
+		unsigned int a, b, c, d;
+		__cpuid_count(leaf, subleaf, a, b, c, d);
+		info[0] = static_cast<int>(a); info[1] = static_cast<int>(b);
+		info[2] = static_cast<int>(c); info[3] = static_cast<int>(d);
+#endif
+	}
+
+	unsigned long long readXCR0() {
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int eax, edx;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+	}
+
+	bool cpuHasSSSE3() {
+		int info[4];
+		cpuid(info, 1, 0);
+		return (info[2] & (1 << 9)) != 0;
+	}
+
+	bool cpuHasAVX2() {
+		int info[4];
+		cpuid(info, 0, 0);
+		if (info[0] < 7) return false;
+
+		cpuid(info, 1, 0);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		// The OS must save YMM state across context switches
+		if (!osxsave || !avx || (readXCR0() & 0x6) != 0x6) return false;
+
+		cpuid(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+	}
+#endif
+
+	Base64::Implementation detectImplementation() {
+#ifdef BASE64_X86
+		if (cpuHasAVX2()) return Base64::Implementation::AVX2;
+		if (cpuHasSSSE3()) return Base64::Implementation::SSSE3;
+#endif
+		return Base64::Implementation::Scalar;
+	}
+
+	size_t encodeDispatch(Base64::Implementation implementation, const unsigned char* data, size_t size, char* out) {
+		switch (implementation) {
+#ifdef BASE64_X86
+		case Base64::Implementation::AVX2: return encodeAVX2(data, size, out);
+		case Base64::Implementation::SSSE3: return encodeSSSE3(data, size, out);
+#endif
+		default: return encodeScalar(data, size, out);
+		}
+	}
+}
+
+Base64::Implementation Base64::activeImplementation() {
+	static const Implementation active = detectImplementation();
+	return active;
+}
+
+bool Base64::isSupported(Implementation implementation) {
+	switch (implementation) {
+	case Implementation::Reference:
+	case Implementation::Scalar:
+		return true;
+	case Implementation::SSSE3:
+		return activeImplementation() == Implementation::SSSE3 || activeImplementation() == Implementation::AVX2;
+	case Implementation::AVX2:
+		return activeImplementation() == Implementation::AVX2;
+	}
+	return false;
+}
+
+const wchar_t* Base64::implementationName(Implementation implementation) {
+	switch (implementation) {
+	case Implementation::Reference: return L"Reference";
+	case Implementation::Scalar: return L"Scalar";
+	case Implementation::SSSE3: return L"SSSE3";
+	case Implementation::AVX2: return L"AVX2";
+	}
+	return L"Unknown";
+}
+
+size_t Base64::encode(const unsigned char* data, size_t size, char* out) {
+	return encodeDispatch(activeImplementation(), data, size, out);
+}
+
+std::string Base64::encode(const unsigned char* data, size_t size) {
+	std::string result(encodedSize(size), '\0');
+	if (size) {
+		encode(data, size, &result[0]);
+	}
+	return result;
+}
+
+std::string Base64::encode(const std::string& data) {
+	return encode(reinterpret_cast<const unsigned char*>(data.data()), data.size());
+}
+
+std::string Base64::encodeWith(Implementation implementation, const unsigned char* data, size_t size) {
+	if (implementation == Implementation::Reference) {
+		return encodeReference(data, size);
+	}
+	if (!isSupported(implementation)) {
+		return std::string();
+	}
+
+	std::string result(encodedSize(size), '\0');
+	if (size) {
+		encodeDispatch(implementation, data, size, &result[0]);
+	}
+	return result;
+}
+
+bool Base64::verify(size_t maxLength) {
+	const Implementation candidates[] = { Implementation::Scalar, Implementation::SSSE3, Implementation::AVX2 };
+
+	std::mt19937 rng(12345);
+	std::vector<size_t> lengths;
+	for (size_t len = 0; len <= maxLength; ++len) {
+		lengths.push_back(len);
+	}
+	// A few payload-sized buffers with awkward remainders
+	lengths.push_back(200 * 1024 + 1);
+	lengths.push_back(600 * 1024 + 2);
+
+	for (size_t len : lengths) {
+		std::vector<unsigned char> data(len);
+		for (auto& byte : data) {
+			byte = static_cast<unsigned char>(rng() & 0xFF);
+		}
+		const unsigned char* ptr = data.empty() ? nullptr : data.data();
+		std::string expected = encodeReference(ptr, len);
+
+		for (Implementation implementation : candidates) {
+			if (!isSupported(implementation)) continue;
+			if (encodeWith(implementation, ptr, len) != expected) {
+				std::wcout << L"[Base64] Mismatch for " << implementationName(implementation)
+					<< L" at length " << len << std::endl;
+				return false;
+			}
+		}
+	}
+
+	std::wcout << L"[Base64] All implementations match the reference up to length " << maxLength << std::endl;
+	return true;
+}
+
+std::vector<Base64::BenchmarkResult> Base64::benchmark(size_t bytes, int iterations) {
+	const Implementation candidates[] = { Implementation::Reference, Implementation::Scalar, Implementation::SSSE3, Implementation::AVX2 };
+
+	std::mt19937 rng(67890);
+	std::vector<unsigned char> data(bytes);
+	for (auto& byte : data) {
+		byte = static_cast<unsigned char>(rng() & 0xFF);
+	}
+
+	std::vector<BenchmarkResult> results;
+	for (Implementation implementation : candidates) {
+		if (!isSupported(implementation)) continue;
+
+		size_t checksum = 0;
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int iter = 0; iter < iterations; ++iter) {
+			checksum += encodeWith(implementation, data.data(), data.size()).size();
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		double seconds = std::chrono::duration<double>(end - start).count();
+
+		BenchmarkResult result;
+		result.implementation = implementation;
+		result.bytes = bytes;
+		result.iterations = iterations;
+		result.gbPerSecond = seconds > 0.0 ? (static_cast<double>(bytes) * iterations) / seconds / 1e9 : 0.0;
+		results.push_back(result);
+
+		std::wcout << L"[Base64] " << implementationName(implementation) << L": " << result.gbPerSecond
+			<< L" GB/s (" << checksum << L" chars)" << std::endl;
+	}
+	return results;
+}
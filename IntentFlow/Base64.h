@@ -0,0 +1,46 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstddef>
+
+// Base64 encoder with SIMD fast paths.
+// Picks the best implementation for the running CPU once (AVX2, then SSSE3, then a table-driven
+// scalar loop) and always writes into a pre-sized output buffer. The byte-at-a-time encoder that
+// QwenAPI::base64Encode used originally is kept as the reference for bit-exact verification.
+class Base64 {
+public:
+    enum class Implementation {
+        Reference,  // Original byte-at-a-time encoder
+        Scalar,     // 3 bytes -> 4 chars per step, pre-sized output
+        SSSE3,      // 12 bytes -> 16 chars per step (pshufb)
+        AVX2        // 24 bytes -> 32 chars per step
+    };
+
+    struct BenchmarkResult {
+        Implementation implementation = Implementation::Reference;
+        size_t bytes = 0;
+        int iterations = 0;
+        double gbPerSecond = 0.0;
+    };
+
+    static size_t encodedSize(size_t size) { return (size + 2) / 3 * 4; }
+
+    // Encode with the best implementation available on this CPU
+    static std::string encode(const std::string& data);
+    static std::string encode(const unsigned char* data, size_t size);
+
+    // Encode into out, which must hold encodedSize(size) chars; returns the number written
+    static size_t encode(const unsigned char* data, size_t size, char* out);
+
+    static std::string encodeWith(Implementation implementation, const unsigned char* data, size_t size);
+    static bool isSupported(Implementation implementation);
+    static Implementation activeImplementation();
+    static const wchar_t* implementationName(Implementation implementation);
+
+    // Compare every supported implementation with the reference encoder over all lengths up to
+    // maxLength plus a few large random buffers; returns false on the first mismatch
+    static bool verify(size_t maxLength = 1024);
+
+    // Throughput of every supported implementation on a random buffer
+    static std::vector<BenchmarkResult> benchmark(size_t bytes = 512 * 1024, int iterations = 50);
+};
@@ -0,0 +1,114 @@
+#include "pch.h"
+#include "BufferPool.h"
+#include <iostream>
+#include <atomic>
+
+namespace {
+	// Mat allocations made by the current thread (any Mat, not only pooled ones)
+	thread_local uint64_t tlsMatAllocations = 0;
+	thread_local uint64_t tlsMatBytes = 0;
+
+	std::atomic<uint64_t> images(0);
+	std::atomic<uint64_t> steadyImages(0);
+	std::atomic<uint64_t> matAllocations(0);
+	std::atomic<uint64_t> matBytes(0);
+	std::atomic<uint64_t> bufferGrowths(0);
+	std::atomic<uint64_t> bufferBytes(0);
+
+	// Default Mat allocator that counts what it hands out. The UMatData it returns belongs to the wrapped
+	// allocator, so deallocation and the map/unmap calls go straight there.
+	class CountingMatAllocator : public cv::MatAllocator {
+	public:
+		explicit CountingMatAllocator(cv::MatAllocator* inner) : inner_(inner) {}
+
+		cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+			cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+			cv::UMatData* u = inner_->allocate(dims, sizes, type, data, step, flags, usageFlags);
+			if (u && !data) {
+				tlsMatAllocations++;
+				tlsMatBytes += u->size;
+			}
+			return u;
+		}
+
+		bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override {
+			return inner_->allocate(data, accessFlags, usageFlags);
+		}
+
+		void deallocate(cv::UMatData* data) const override {
+			inner_->deallocate(data);
+		}
+
+	private:
+		cv::MatAllocator* inner_;
+	};
+}
+
+BufferPool::ImageScope::ImageScope()
+	: startAllocations_(tlsMatAllocations), startMatBytes_(tlsMatBytes), startCapacity_(capacity(local())) {
+}
+
+BufferPool::ImageScope::~ImageScope() {
+	uint64_t allocations = tlsMatAllocations - startAllocations_;
+	size_t endCapacity = capacity(local());
+
+	images++;
+	matAllocations += allocations;
+	matBytes += tlsMatBytes - startMatBytes_;
+	if (endCapacity > startCapacity_) {
+		bufferGrowths++;
+		bufferBytes += endCapacity - startCapacity_;
+	}
+	if (allocations == 0 && endCapacity <= startCapacity_) {
+		steadyImages++;
+	}
+}
+
+uint64_t BufferPool::ImageScope::matAllocations() const {
+	return tlsMatAllocations - startAllocations_;
+}
+
+BufferPool::Buffers& BufferPool::local() {
+	static const bool installed = (installAllocator(), true);
+	(void)installed;
+	thread_local Buffers buffers;
+	return buffers;
+}
+
+void BufferPool::installAllocator() {
+	// Never destroyed: Mats released during static destruction still go through it
+	static CountingMatAllocator* allocator = new CountingMatAllocator(cv::Mat::getDefaultAllocator());
+	cv::Mat::setDefaultAllocator(allocator);
+}
+
+size_t BufferPool::capacity(const Buffers& buffers) {
+	// Swapping between two pooled buffers moves capacity around without allocating, so compare the total
+	return buffers.fileBytes.capacity() + buffers.encoded.bytes.capacity() + buffers.encodeScratch.capacity();
+}
+
+BufferPool::Statistics BufferPool::getStatistics() {
+	Statistics stats;
+	stats.images = images;
+	stats.steadyImages = steadyImages;
+	stats.matAllocations = matAllocations;
+	stats.matBytes = matBytes;
+	stats.bufferGrowths = bufferGrowths;
+	stats.bufferBytes = bufferBytes;
+	return stats;
+}
+
+void BufferPool::resetStatistics() {
+	images = 0;
+	steadyImages = 0;
+	matAllocations = 0;
+	matBytes = 0;
+	bufferGrowths = 0;
+	bufferBytes = 0;
+}
+
+void BufferPool::logStatistics() {
+	Statistics stats = getStatistics();
+	std::wcout << L"[BufferPool] Images: " << stats.images << L", allocation-free: " << stats.steadyImages
+		<< L", Mat allocations: " << stats.matAllocations << L" (" << stats.matBytes / 1024 << L" KB), buffer growths: "
+		<< stats.bufferGrowths << L" (" << stats.bufferBytes / 1024 << L" KB)" << std::endl;
+}
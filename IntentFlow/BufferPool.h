@@ -0,0 +1,66 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include "ImageEncoder.h"
+
+// Per-thread scratch buffers of the preprocessing pipeline (file bytes -> decode -> resize -> encode).
+// Every thread that runs QwenAPI::scaleImage (normally the preprocessing WorkerPool's workers) keeps one
+// set for its whole lifetime. Mats are refilled through OpenCV's create() semantics, which keep the existing
+// data when size and type match, and byte buffers only grow, so once a worker has seen an image of a given
+// geometry it preprocesses further ones without touching the heap.
+//
+// To check that, a counting cv::MatAllocator is installed as OpenCV's default allocator and the byte buffers'
+// capacities are compared around each image. The base64 payload handed to the ImageContext is the product of
+// the pipeline, not scratch, and stays one allocation per image.
+class BufferPool {
+public:
+    struct Buffers {
+        std::vector<uchar> fileBytes;   // Source file as read from disk
+        cv::Mat decoded;                // Possibly reduced-resolution decode
+        cv::Mat resized;                // Content-size resize output
+        cv::Mat canvas;                 // Padded canvas (Letterbox only)
+        cv::Mat converted;              // BGR copy of a resized raw framebuffer
+        EncodedImage encoded;           // Compressed bytes of the image being sent
+        std::vector<uchar> encodeScratch;   // Size-estimation encodes of the byte-budget search
+        cv::Mat encodeSample;           // Sampled bands those estimates are run on
+    };
+
+    struct Statistics {
+        uint64_t images = 0;            // Images run under an ImageScope
+        uint64_t steadyImages = 0;      // ... of which allocated no Mat and grew no buffer
+        uint64_t matAllocations = 0;    // Mat allocations on pipeline threads, all images
+        uint64_t matBytes = 0;
+        uint64_t bufferGrowths = 0;     // Images that had to grow at least one byte buffer
+        uint64_t bufferBytes = 0;       // Capacity added to the byte buffers, all threads
+    };
+
+    // Counts the Mat allocations and buffer growth of one image on the current thread
+    class ImageScope {
+    public:
+        ImageScope();
+        ~ImageScope();
+
+        ImageScope(const ImageScope&) = delete;
+        ImageScope& operator=(const ImageScope&) = delete;
+
+        // Mat allocations made on this thread since the scope started
+        uint64_t matAllocations() const;
+
+    private:
+        uint64_t startAllocations_;
+        uint64_t startMatBytes_;
+        size_t startCapacity_;
+    };
+
+    // This thread's buffers; installs the counting allocator on first use
+    static Buffers& local();
+
+    static Statistics getStatistics();
+    static void resetStatistics();
+    static void logStatistics();
+
+private:
+    static void installAllocator();
+    static size_t capacity(const Buffers& buffers);
+};
@@ -0,0 +1,271 @@
+#include "CurlTransport.h"
+#include <iostream>
+#include <thread>
+#include <algorithm>
+
+std::shared_ptr<HttpTransport> HttpTransport::createDefault(const Options& options) {
+	return std::make_shared<CurlTransport>(options);
+}
+
+CurlTransport::CurlTransport(const Options& options) : options_(options) {
+	options_.connections = (std::max)(1, options_.connections);
+	// curl_global_init is not thread safe; do it once before any handle exists
+	static std::once_flag globalInit;
+	std::call_once(globalInit, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+CurlTransport::~CurlTransport() {
+	// Transfers in flight finish, and their completions run, before the event thread exits
+	if (eventThread_.joinable()) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			stopping_ = true;
+		}
+		curl_multi_wakeup(multi_);
+		eventThread_.join();
+		curl_multi_cleanup(multi_);
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (CURL* handle : idle_) {
+		curl_easy_cleanup(handle);
+	}
+	idle_.clear();
+}
+
+CURL* CurlTransport::acquire() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	if (idle_.empty() && leased_ >= options_.connections) {
+		stats_.waits++;
+		released_.wait(lock, [this]() { return !idle_.empty() || leased_ < options_.connections; });
+	}
+	leased_++;
+	if (!idle_.empty()) {
+		// Most recently used: the likeliest to still have its connection open
+		CURL* handle = idle_.back();
+		idle_.pop_back();
+		return handle;
+	}
+	lock.unlock();
+
+	CURL* handle = curl_easy_init();
+	if (!handle) {
+		release(nullptr, false);
+	}
+	return handle;
+}
+
+void CurlTransport::release(CURL* handle, bool healthy) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		leased_--;
+		if (handle && healthy) {
+			idle_.push_back(handle);
+			handle = nullptr;
+		}
+	}
+	if (handle) {
+		curl_easy_cleanup(handle);
+	}
+	released_.notify_one();
+}
+
+size_t CurlTransport::appendBody(char* data, size_t size, size_t count, void* userData) {
+	static_cast<std::string*>(userData)->append(data, size * count);
+	return size * count;
+}
+
+void CurlTransport::configure(CURL* handle, const HttpRequest& request, Transfer& transfer) {
+	// Reset clears the options of the last request but keeps the handle's connection and TLS session caches
+	curl_easy_reset(handle);
+	curl_easy_setopt(handle, CURLOPT_URL, request.url.c_str());
+	curl_easy_setopt(handle, CURLOPT_ERRORBUFFER, transfer.errorBuffer);
+	curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(handle, CURLOPT_TCP_KEEPALIVE, 1L);
+	curl_easy_setopt(handle, CURLOPT_MAXAGE_CONN, static_cast<long>(options_.idleTimeoutSeconds));
+	curl_easy_setopt(handle, CURLOPT_PRIVATE, &transfer);
+
+	if (request.method == "HEAD") {
+		curl_easy_setopt(handle, CURLOPT_NOBODY, 1L);
+	}
+	else if (request.method == "POST" || request.body) {
+		// The body is sent from the caller's buffer, not copied
+		curl_easy_setopt(handle, CURLOPT_POST, 1L);
+		curl_easy_setopt(handle, CURLOPT_POSTFIELDS, request.body ? request.body->data() : "");
+		curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE_LARGE, static_cast<curl_off_t>(request.body ? request.body->size() : 0));
+		if (request.method != "POST") {
+			curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+		}
+	}
+	else if (request.method != "GET") {
+		curl_easy_setopt(handle, CURLOPT_CUSTOMREQUEST, request.method.c_str());
+	}
+
+	for (const auto& header : request.headers) {
+		transfer.headers = curl_slist_append(transfer.headers, (header.first + ": " + header.second).c_str());
+	}
+	// Image bodies are often over 1 MB; without this curl waits for a 100 Continue first
+	transfer.headers = curl_slist_append(transfer.headers, "Expect:");
+	curl_easy_setopt(handle, CURLOPT_HTTPHEADER, transfer.headers);
+
+	if (request.timeoutSeconds > 0) {
+		// Like the WinHTTP timeouts: a limit on connecting and on stalls, not on the whole exchange
+		curl_easy_setopt(handle, CURLOPT_CONNECTTIMEOUT, static_cast<long>(request.timeoutSeconds));
+		curl_easy_setopt(handle, CURLOPT_LOW_SPEED_LIMIT, 1L);
+		curl_easy_setopt(handle, CURLOPT_LOW_SPEED_TIME, static_cast<long>(request.timeoutSeconds));
+	}
+
+	curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, &CurlTransport::appendBody);
+	curl_easy_setopt(handle, CURLOPT_WRITEDATA, &transfer.response.body);
+}
+
+void CurlTransport::finish(CURL* handle, Transfer& transfer, CURLcode code) {
+	curl_slist_free_all(transfer.headers);
+	transfer.headers = nullptr;
+	HttpResponse& response = transfer.response;
+
+	if (code != CURLE_OK) {
+		response.errorMessage = std::string("HTTP request failed: ") +
+			(transfer.errorBuffer[0] ? transfer.errorBuffer : curl_easy_strerror(code));
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats_.failed++;
+		return;
+	}
+
+	long statusCode = 0;
+	long connects = 0;
+	curl_easy_getinfo(handle, CURLINFO_RESPONSE_CODE, &statusCode);
+	curl_easy_getinfo(handle, CURLINFO_NUM_CONNECTS, &connects);
+	response.completed = true;
+	response.statusCode = static_cast<int>(statusCode);
+	response.connectionReused = connects == 0;
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	stats_.requests++;
+	stats_.opened += static_cast<uint64_t>(connects);
+	if (response.connectionReused) {
+		stats_.reused++;
+	}
+}
+
+HttpResponse CurlTransport::send(const HttpRequest& request) {
+	HttpResponse response;
+	CURL* handle = acquire();
+	if (!handle) {
+		response.errorMessage = "Failed to create curl handle";
+		return response;
+	}
+	Transfer transfer;
+	configure(handle, request, transfer);
+	finish(handle, transfer, curl_easy_perform(handle));
+	// A handle whose transfer failed may hold a broken connection; start the next request on a fresh one
+	release(handle, transfer.response.completed);
+	return std::move(transfer.response);
+}
+
+void CurlTransport::sendAsync(const HttpRequest& request, Completion done) {
+	std::unique_ptr<Transfer> transfer(new Transfer());
+	transfer->request = request;
+	transfer->done = std::move(done);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!multi_) {
+			multi_ = curl_multi_init();
+			// As many connections per host as the blocking pool; further transfers wait inside curl
+			curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, static_cast<long>(options_.connections));
+			curl_multi_setopt(multi_, CURLMOPT_MAXCONNECTS, static_cast<long>(options_.connections));
+			eventThread_ = std::thread(&CurlTransport::eventLoop, this);
+		}
+		incoming_.push_back(std::move(transfer));
+	}
+	curl_multi_wakeup(multi_);
+}
+
+void CurlTransport::eventLoop() {
+	std::vector<CURL*> idle;    // Only this thread touches the multi handle's easy handles
+	int running = 0;
+	for (;;) {
+		std::vector<std::unique_ptr<Transfer>> started;
+		bool stopping = false;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			started.swap(incoming_);
+			stopping = stopping_;
+		}
+		if (stopping && started.empty() && running == 0) {
+			break;
+		}
+
+		for (auto& transfer : started) {
+			CURL* handle = nullptr;
+			if (!idle.empty()) {
+				handle = idle.back();
+				idle.pop_back();
+			}
+			else {
+				handle = curl_easy_init();
+			}
+			if (!handle) {
+				transfer->response.errorMessage = "Failed to create curl handle";
+				transfer->done(transfer->response);
+				continue;
+			}
+			configure(handle, transfer->request, *transfer);
+			curl_multi_add_handle(multi_, handle);
+			transfer.release();     // Owned by the handle's CURLOPT_PRIVATE until it finishes
+		}
+
+		curl_multi_perform(multi_, &running);
+		int queued = 0;
+		while (CURLMsg* message = curl_multi_info_read(multi_, &queued)) {
+			if (message->msg != CURLMSG_DONE) {
+				continue;
+			}
+			CURL* handle = message->easy_handle;
+			CURLcode code = message->data.result;
+			Transfer* finished = nullptr;
+			curl_easy_getinfo(handle, CURLINFO_PRIVATE, reinterpret_cast<char**>(&finished));
+			std::unique_ptr<Transfer> transfer(finished);
+			curl_multi_remove_handle(multi_, handle);
+
+			finish(handle, *transfer, code);
+			if (transfer->response.completed) {
+				idle.push_back(handle);
+			}
+			else {
+				curl_easy_cleanup(handle);
+			}
+			transfer->done(transfer->response);
+		}
+
+		// Sleeps until a socket is ready, a timeout is due or sendAsync wakes it up
+		curl_multi_poll(multi_, nullptr, 0, 1000, nullptr);
+	}
+
+	for (CURL* handle : idle) {
+		curl_easy_cleanup(handle);
+	}
+}
+
+int CurlTransport::prewarm(const std::string& url, int count) {
+	if (count <= 0 || count > options_.connections) {
+		count = options_.connections;
+	}
+	// Warms the multi handle's connection cache, which every request of the request engine is sent from
+	int warmed = prewarmAsync(url, count);
+	std::wcout << L"[CurlTransport] Pre-warmed " << warmed << L"/" << count << L" connections to "
+		<< std::wstring(url.begin(), url.end()) << std::endl;
+	return warmed;
+}
+
+HttpTransport::Statistics CurlTransport::getStatistics() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void CurlTransport::logStatistics() const {
+	Statistics stats = getStatistics();
+	std::wcout << L"[CurlTransport] Requests: " << stats.requests << L", on a reused connection: " << stats.reused
+		<< L" (" << (stats.requests ? stats.reused * 100 / stats.requests : 0) << L"%), connections opened: " << stats.opened
+		<< L", failed: " << stats.failed << L", waits for a free connection: " << stats.waits << std::endl;
+}
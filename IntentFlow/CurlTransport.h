@@ -0,0 +1,64 @@
+#pragma once
+#include "HttpTransport.h"
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <curl/curl.h>
+
+// HttpTransport over libcurl, for POSIX hosts (built instead of WinHttpTransport there). Each pooled easy
+// handle keeps its own connection cache, so a handle reused for the same host skips the TCP and TLS
+// handshakes; curl closes connections idle past Options::idleTimeoutSeconds itself.
+// Asynchronous requests share one multi handle, and its connection cache, on a single event thread;
+// prewarm() warms that cache.
+class CurlTransport : public HttpTransport {
+public:
+    explicit CurlTransport(const Options& options);
+    ~CurlTransport();
+
+    CurlTransport(const CurlTransport&) = delete;
+    CurlTransport& operator=(const CurlTransport&) = delete;
+
+    HttpResponse send(const HttpRequest& request) override;
+    void sendAsync(const HttpRequest& request, Completion done) override;
+    int prewarm(const std::string& url, int count) override;
+    Statistics getStatistics() const override;
+    void logStatistics() const override;
+
+private:
+    // Most recently used idle handle, a new one while below Options::connections, or the next one released
+    CURL* acquire();
+    void release(CURL* handle, bool healthy);
+
+    // Per-request state curl writes into while the transfer runs
+    struct Transfer {
+        HttpRequest request;        // Asynchronous requests only; the caller's copy is gone by then
+        HttpResponse response;
+        Completion done;
+        struct curl_slist* headers = nullptr;
+        char errorBuffer[CURL_ERROR_SIZE] = { 0 };
+    };
+
+    // Sets up a transfer on handle, and fills the response and statistics once curl is done with it
+    void configure(CURL* handle, const HttpRequest& request, Transfer& transfer);
+    void finish(CURL* handle, Transfer& transfer, CURLcode code);
+
+    // Drives the multi handle until the transport is destroyed and the last transfer has finished
+    void eventLoop();
+
+    static size_t appendBody(char* data, size_t size, size_t count, void* userData);
+
+    Options options_;
+    std::vector<CURL*> idle_;
+    int leased_ = 0;
+
+    // Asynchronous requests: the multi handle and event thread start on first use
+    CURLM* multi_ = nullptr;
+    std::thread eventThread_;
+    std::vector<std::unique_ptr<Transfer>> incoming_;   // Handed to the event thread on its next wakeup
+    bool stopping_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    Statistics stats_;
+};
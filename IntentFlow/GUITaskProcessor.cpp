@@ -15,10 +15,16 @@
 #include <ctime>
 #include <locale>
 #include <codecvt>
+#include <climits>
+#include <algorithm>
+#include <future>
+#include <mutex>
 #include <opencv2/opencv.hpp>
 #include "QwenAPI.h"
-
-static thread_local std::string currentImagePath;
+#include "ImageProbe.h"
+#include "ImagePreprocessor.h"
+#include "ImageEncoder.h"
+#include "Base64.h"
 
 // Function declarations
 std::wstring ANSIToUnicode(const std::string& str);
@@ -26,6 +32,17 @@ std::string UnicodeToUTF8(const std::wstring& wstr);
 std::wstring UTF8ToUnicode(const std::string& str);
 std::pair<int, int> getImageDimensions(const std::string& imagePath);
 void WriteLog(const std::wstring& message);
+bool parseBox(const std::string& text, int box[4]);
+std::string describeImageForPrompt(const ImageContext& imageContext);
+std::string promptImageName(const ImageContext& imageContext);
+std::string extractResponseText(const std::string& response);
+bool findQuestionBox(const std::string& question, int box[4]);
+bool findAnswerBox(const std::string& answer, int box[4]);
+ImageRegion contextRegion(const int box[4], int imageWidth, int imageHeight, double margin, int minContext);
+std::vector<ImageRegion> tileRegions(int imageWidth, int imageHeight, double aspectThreshold, double overlap);
+double boxOverlap(const int a[4], const int b[4]);
+bool answersMatch(const std::string& answer, const std::string& reference);
+bool splitAnswerList(const std::string& text, size_t count, std::vector<std::string>& items);
 
 // Helper functions for string conversion
 std::wstring ANSIToUnicode(const std::string& str) {
@@ -54,6 +71,13 @@ std::wstring UTF8ToUnicode(const std::string& str) {
 
 // Function to get image dimensions
 std::pair<int, int> getImageDimensions(const std::string& imagePath) {
+	// Read the size from the file header (PNG/JPEG/BMP/WebP) without decoding pixels
+	ImageProbe::ProbeResult probed = ImageProbe::probe(imagePath);
+	if (probed.success) {
+		return std::make_pair(probed.width, probed.height);
+	}
+
+	// Unknown format: fall back to a full decode
 	// Convert imagePath to wide string for OpenCV
 	std::wstring widePath = ANSIToUnicode(imagePath);
 
@@ -69,37 +93,21 @@ std::pair<int, int> getImageDimensions(const std::string& imagePath) {
 }
 
 // Function to scale coordinates based on image resizing
-std::string scaleCoordinatesInQuestion(const std::string& question, const std::string& imagePath);
+std::string scaleCoordinatesInQuestion(const std::string& question, const ImageContext& imageContext);
 
-// Function to scale coordinates from 960x960 back to original image size
-std::string GUITaskProcessor::scaleCoordinatesInAnswer(const std::string& coordinates) {
+// Function to scale coordinates from the model canvas back to original image size
+std::string GUITaskProcessor::scaleCoordinatesInAnswer(const std::string& coordinates, const ImageContext& imageContext) {
 	WriteLog(L"[scaleCoordinatesInAnswer] Processing coordinates: " + std::wstring(coordinates.begin(), coordinates.end()));
-	WriteLog(L"[scaleCoordinatesInAnswer] Current image path: " + std::wstring(currentImagePath.begin(), currentImagePath.end()));
-
-	// Get image dimensions
-	std::pair<int, int> dimensions = getImageDimensions(currentImagePath);
-	int originalWidth = dimensions.first;
-	int originalHeight = dimensions.second;
+	WriteLog(L"[scaleCoordinatesInAnswer] Current image path: " + std::wstring(imageContext.imagePath.begin(), imageContext.imagePath.end()));
 
-	if (originalWidth <= 0 || originalHeight <= 0) {
-		WriteLog(L"[scaleCoordinatesInAnswer] Failed to get image dimensions");
+	// Image size comes from the context prepared in processGUITask, no need to reopen the file
+	if (!imageContext.scaled || !imageContext.transform.isValid()) {
+		WriteLog(L"[scaleCoordinatesInAnswer] Image was not scaled, returning coordinates as is");
 		return coordinates;
 	}
 
 	WriteLog(L"[scaleCoordinatesInAnswer] Original image size: " +
-		std::to_wstring(originalWidth) + L"x" + std::to_wstring(originalHeight));
-
-	// Target dimensions (960x960) - same as in QwenAPI::scaleImage
-	const int targetWidth = 960;
-	const int targetHeight = 960;
-
-	// Calculate scale factors for each dimension separately (not maintaining aspect ratio)
-	// 修复：正确的缩放因子应该是原始尺寸/目标尺寸，而不是目标尺寸/原始尺寸
-	float scaleX = (float)originalWidth / targetWidth;
-	float scaleY = (float)originalHeight / targetHeight;
-
-	WriteLog(L"[scaleCoordinatesInAnswer] Scale factors - X: " + std::to_wstring(scaleX) +
-		L", Y: " + std::to_wstring(scaleY));
+		std::to_wstring(imageContext.transform.originalWidth) + L"x" + std::to_wstring(imageContext.transform.originalHeight));
 
 	// Parse coordinate values
 	std::vector<std::string> coords;
@@ -127,13 +135,13 @@ std::string GUITaskProcessor::scaleCoordinatesInAnswer(const std::string& coordi
 
 			try {
 				int value = std::stoi(trimmedCoord);
-				// Scale X coordinates with scaleX and Y coordinates with scaleY
+				// Map X and Y back through the inverse of the resize
 				int scaledValue;
 				if (i % 2 == 0) { // X coordinate (0, 2, ...)
-					scaledValue = static_cast<int>(value * scaleX);
+					scaledValue = imageContext.toOriginalX(value);
 				}
 				else { // Y coordinate (1, 3, ...)
-					scaledValue = static_cast<int>(value * scaleY);
+					scaledValue = imageContext.toOriginalY(value);
 				}
 				scaledCoords.push_back(scaledValue);
 				WriteLog(L"[scaleCoordinatesInAnswer] Original: " + std::wstring(trimmedCoord.begin(), trimmedCoord.end()) +
@@ -171,12 +179,206 @@ std::string scaleCoordinatesInAnswer(const std::string& coordinates) {
 	return coordinates;
 }
 
+// Parse "[x1,y1,x2,y2]" (spaces allowed)
+bool parseBox(const std::string& text, int box[4]) {
+	return sscanf_s(text.c_str(), " [ %d , %d , %d , %d ]", &box[0], &box[1], &box[2], &box[3]) == 4;
+}
+
+// The box a referring question points at, "([x1,y1,x2,y2])" or "([x,y])" in original image coordinates;
+// a point gives a zero-size box
+bool findQuestionBox(const std::string& question, int box[4]) {
+	size_t parenOpenPos = question.find('(');
+	size_t bracketOpenPos = parenOpenPos == std::string::npos ? std::string::npos : question.find('[', parenOpenPos);
+	if (bracketOpenPos == std::string::npos) {
+		return false;
+	}
+	std::string coordinates = question.substr(bracketOpenPos);
+	if (parseBox(coordinates, box)) {
+		return box[2] >= box[0] && box[3] >= box[1];
+	}
+	if (sscanf_s(coordinates.c_str(), " [ %d , %d ]", &box[0], &box[1]) == 2) {
+		box[2] = box[0];
+		box[3] = box[1];
+		return true;
+	}
+	return false;
+}
+
+// The last [x1,y1,x2,y2] box in an answer ("[...]" for grounding, "text [...]" for VQA); a point gives a zero-size box
+bool findAnswerBox(const std::string& answer, int box[4]) {
+	size_t bracketOpenPos = answer.rfind('[');
+	if (bracketOpenPos == std::string::npos) {
+		return false;
+	}
+	std::string coordinates = answer.substr(bracketOpenPos);
+	if (parseBox(coordinates, box)) {
+		return box[2] >= box[0] && box[3] >= box[1];
+	}
+	if (sscanf_s(coordinates.c_str(), " [ %d , %d ]", &box[0], &box[1]) == 2) {
+		box[2] = box[0];
+		box[3] = box[1];
+		return true;
+	}
+	return false;
+}
+
+// Box plus margin (in multiples of the box size) on each side, at least minContext per side,
+// shifted back inside the image
+ImageRegion contextRegion(const int box[4], int imageWidth, int imageHeight, double margin, int minContext) {
+	const int boxWidth = box[2] - box[0], boxHeight = box[3] - box[1];
+	ImageRegion region;
+	region.width = (std::min)(imageWidth, (std::max)(minContext, (int)std::lround(boxWidth * (1.0 + 2.0 * margin))));
+	region.height = (std::min)(imageHeight, (std::max)(minContext, (int)std::lround(boxHeight * (1.0 + 2.0 * margin))));
+	region.x = (std::max)(0, (std::min)((box[0] + box[2]) / 2 - region.width / 2, imageWidth - region.width));
+	region.y = (std::max)(0, (std::min)((box[1] + box[3]) / 2 - region.height / 2, imageHeight - region.height));
+	return region;
+}
+
+// Overlapping full-width (or full-height) tiles along the long side of an elongated image; empty when the
+// aspect ratio is below the threshold. Tiles are as long as the short side, so each one is about square.
+std::vector<ImageRegion> tileRegions(int imageWidth, int imageHeight, double aspectThreshold, double overlap) {
+	std::vector<ImageRegion> tiles;
+	const bool tall = imageHeight >= imageWidth;
+	const int shortSide = tall ? imageWidth : imageHeight, longSide = tall ? imageHeight : imageWidth;
+	if (shortSide <= 0 || (double)longSide / shortSide <= aspectThreshold) {
+		return tiles;
+	}
+
+	// Enough tiles that neighbours share at least overlap * shortSide, spread evenly so the last one ends at the edge
+	const int stride = (std::max)(1, (int)std::lround(shortSide * (1.0 - overlap)));
+	const int count = 1 + (longSide - shortSide + stride - 1) / stride;
+	for (int i = 0; i < count; ++i) {
+		int start = count > 1 ? (int)((int64_t)(longSide - shortSide) * i / (count - 1)) : 0;
+		ImageRegion tile;
+		tile.x = tall ? 0 : start;
+		tile.y = tall ? start : 0;
+		tile.width = shortSide;
+		tile.height = shortSide;
+		tiles.push_back(tile);
+	}
+	return tiles;
+}
+
+// Intersection over union of two boxes; zero-size boxes (points) count as 1x1
+double boxOverlap(const int a[4], const int b[4]) {
+	int ix = (std::min)(a[2], b[2]) - (std::max)(a[0], b[0]) + 1;
+	int iy = (std::min)(a[3], b[3]) - (std::max)(a[1], b[1]) + 1;
+	if (ix <= 0 || iy <= 0) {
+		return 0.0;
+	}
+	double intersection = (double)ix * iy;
+	double areaA = (double)(a[2] - a[0] + 1) * (a[3] - a[1] + 1);
+	double areaB = (double)(b[2] - b[0] + 1) * (b[3] - b[1] + 1);
+	return intersection / (areaA + areaB - intersection);
+}
+
+// Loose match of two short descriptions: equal or one contains the other, ignoring surrounding whitespace
+bool answersMatch(const std::string& answer, const std::string& reference) {
+	auto trim = [](const std::string& text) {
+		size_t first = text.find_first_not_of(" \t\r\n");
+		return first == std::string::npos ? std::string() : text.substr(first, text.find_last_not_of(" \t\r\n") - first + 1);
+	};
+	std::string a = trim(answer), b = trim(reference);
+	if (a.empty() || b.empty()) {
+		return false;
+	}
+	return a.find(b) != std::string::npos || b.find(a) != std::string::npos;
+}
+
+// What the model is looking at, from the resize policy's transform (nothing to say for raw images)
+std::string describeImageForPrompt(const ImageContext& imageContext) {
+	return imageContext.scaled ? ResizePolicy::describeForPrompt(imageContext.transform) : std::string();
+}
+
+// The coordinate space the model should answer in, e.g. "the 960x960 pixel image"
+std::string promptImageName(const ImageContext& imageContext) {
+	if (!imageContext.scaled) {
+		return "the input image";
+	}
+	return "the " + std::to_string(imageContext.transform.canvasWidth) + "x" +
+		std::to_string(imageContext.transform.canvasHeight) + " pixel image";
+}
+
+// The model's reply text from a raw API response (DashScope "content":[{"text":...}] or OpenAI-style "content":"...")
+std::string extractResponseText(const std::string& response) {
+	Json::CharReaderBuilder builder;
+	std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+	Json::Value root;
+	std::string errors;
+	if (!reader->parse(response.c_str(), response.c_str() + response.size(), &root, &errors)) {
+		return response;
+	}
+
+	const Json::Value& choices = root.isMember("output") ? root["output"]["choices"] : root["choices"];
+	if (!choices.isArray() || choices.empty()) {
+		return response;
+	}
+	const Json::Value& content = choices[0]["message"]["content"];
+	if (content.isString()) {
+		return content.asString();
+	}
+	if (content.isArray() && !content.empty() && content[0]["text"].isString()) {
+		return content[0]["text"].asString();
+	}
+	return response;
+}
+
+// Split a packed reply into count answers: a JSON array (possibly inside a code fence or surrounding text),
+// or numbered lines "1. ...", "2) ...", "3: ...". Non-string array items (e.g. [x1,y1,x2,y2]) are kept as JSON.
+bool splitAnswerList(const std::string& text, size_t count, std::vector<std::string>& items) {
+	items.assign(count, std::string());
+
+	size_t open = text.find('[');
+	size_t close = text.rfind(']');
+	if (open != std::string::npos && close != std::string::npos && close > open) {
+		Json::CharReaderBuilder builder;
+		std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+		Json::Value list;
+		std::string errors;
+		if (reader->parse(text.c_str() + open, text.c_str() + close + 1, &list, &errors) && list.isArray() &&
+			list.size() == count && !list[0].isNumeric()) {
+			Json::StreamWriterBuilder writer;
+			writer["indentation"] = "";
+			for (Json::ArrayIndex i = 0; i < list.size(); ++i) {
+				items[i] = list[i].isString() ? list[i].asString() : Json::writeString(writer, list[i]);
+			}
+			return true;
+		}
+	}
+
+	std::istringstream lines(text);
+	std::string line;
+	size_t found = 0;
+	while (std::getline(lines, line)) {
+		size_t number = 0, pos = line.find_first_not_of(" \t");
+		if (pos == std::string::npos || !isdigit(static_cast<unsigned char>(line[pos]))) {
+			continue;
+		}
+		while (pos < line.size() && isdigit(static_cast<unsigned char>(line[pos]))) {
+			number = number * 10 + (line[pos++] - '0');
+		}
+		if (pos >= line.size() || (line[pos] != '.' && line[pos] != ')' && line[pos] != ':') || number < 1 || number > count) {
+			continue;
+		}
+		std::string item = line.substr(pos + 1);
+		item.erase(0, item.find_first_not_of(" \t"));
+		item.erase(item.find_last_not_of(" \t\r") + 1);
+		if (items[number - 1].empty() && !item.empty()) {
+			items[number - 1] = item;
+			found++;
+		}
+	}
+	return found > 0;
+}
+
 // Add log file stream
 static std::ofstream logFile;
 static bool logInitialized = false;
+static std::mutex logMutex;     // Tile queries log from several threads
 
 // Log function
 void WriteLog(const std::wstring& message) {
+	std::lock_guard<std::mutex> lock(logMutex);
 	if (!logInitialized) {
 		logFile.open("D:\\Git_ZPY\\IntentFlow\\gui_task_processor.log", std::ios::out | std::ios::app);
 		logInitialized = true;
@@ -217,63 +419,901 @@ GUITaskProcessor::~GUITaskProcessor() {
 	}
 }
 
+bool GUITaskProcessor::knownTaskType(const std::string& taskType, TaskKind& kind) {
+	if (taskKindFromName(taskType, kind)) {
+		return true;
+	}
+	WriteLog(L"[GUITaskProcessor] Unknown task type: " + std::wstring(taskType.begin(), taskType.end()));
+	return false;
+}
+
+template <TaskKind Kind>
+std::string GUITaskProcessor::buildPrompt(const std::string& question, const ImageContext& imageContext) {
+	typedef TaskTraits<Kind> Traits;
+	// Fixed text around the question, assembled once per task type
+	static const std::string beforeQuestion = std::string(Traits::instruction()) + "The question is: \"";
+	static const std::string beforeQuestionOutlined = std::string(Traits::instruction()) +
+		"The component is outlined with a red rectangle. The question is: \"";
+	static const std::string afterQuestion = std::string("\". ") + Traits::answerFormat() +
+		(Traits::coordinateNote() ? Traits::coordinateNote() : "");
+
+	std::string prompt = Traits::role();
+	// Text answers need no coordinate space; the original prompt only says what the image is once a crop
+	// or padding makes it differ from the plain stretched screenshot
+	if (Traits::coordinateNote() || imageContext.transform.mode != ResizeMode::Stretch) {
+		prompt += describeImageForPrompt(imageContext);
+	}
+	prompt += imageContext.outlined ? beforeQuestionOutlined : beforeQuestion;
+	prompt += question;
+	prompt += afterQuestion;
+	if (Traits::coordinateNote()) {
+		prompt += promptImageName(imageContext) + ", not the original image size.";
+	}
+	return prompt;
+}
+
+template <>
+std::string GUITaskProcessor::parseResult<TaskKind::Grounding>(const std::string& response, const ImageContext& imageContext) {
+	return parseResultForGrounding(response, imageContext);
+}
+
+template <>
+std::string GUITaskProcessor::parseResult<TaskKind::Referring>(const std::string& response, const ImageContext& imageContext) {
+	return parseResultForReferring(response);
+}
+
+template <>
+std::string GUITaskProcessor::parseResult<TaskKind::VQA>(const std::string& response, const ImageContext& imageContext) {
+	return parseResultForVQA(response, imageContext);
+}
+
 void GUITaskProcessor::setApiKey(const std::string& apiKey) {
 	WriteLog(L"setApiKey called");
 	qwenAPI_.setApiKey(apiKey);
 }
 
-bool GUITaskProcessor::processAllTasks() {
-	WriteLog(L"processAllTasks called");
-	std::wcout << L"[GUITaskProcessor] Starting to process all GUI tasks..." << std::endl;
-	WriteLog(L"[GUITaskProcessor] Starting to process all GUI tasks...");
+void GUITaskProcessor::setModel(const std::string& model, const QwenAPI::GenerationParameters& generation) {
+	WriteLog(L"[GUITaskProcessor] Model: " + std::wstring(model.begin(), model.end()) +
+		L", max tokens: " + std::to_wstring(generation.maxTokens));
+	qwenAPI_.setModel(model);
+	qwenAPI_.setGenerationParameters(generation);
+}
 
-	// Define task types and paths
-	std::vector<std::pair<std::string, std::string>> taskConfigs = {
-		{"gui_grounding", "D:\\Git_ZPY\\IntentFlow\\test\\GUI_Grounding"},
-		{"gui_referring", "D:\\Git_ZPY\\IntentFlow\\test\\GUI_Referring"},
-		{"advanced_vqa", "D:\\Git_ZPY\\IntentFlow\\test\\GUI_VQA"}
+void GUITaskProcessor::setMaxInFlight(int maxInFlight) {
+	WriteLog(L"[GUITaskProcessor] Requests in flight: " + std::to_wstring(maxInFlight));
+	qwenAPI_.setMaxInFlight(maxInFlight);
+}
+
+void GUITaskProcessor::setResizeKernel(const std::string& taskType, ResizeKernel kernel) {
+	TaskKind kind;
+	if (!knownTaskType(taskType, kind)) {
+		return;
+	}
+	WriteLog(L"[GUITaskProcessor] Resize kernel for " + std::wstring(taskType.begin(), taskType.end()) + L": " +
+		ImagePreprocessor::kernelName(kernel));
+	resizeKernels_[kind] = kernel;
+}
+
+void GUITaskProcessor::setDecodeMode(const std::string& taskType, DecodeMode decodeMode) {
+	TaskKind kind;
+	if (!knownTaskType(taskType, kind)) {
+		return;
+	}
+	WriteLog(L"[GUITaskProcessor] Decode mode for " + std::wstring(taskType.begin(), taskType.end()) + L": " +
+		(decodeMode == DecodeMode::Reduced ? L"reduced" : L"full"));
+	decodeModes_[kind] = decodeMode;
+}
+
+void GUITaskProcessor::setAdaptiveResolution(const std::string& taskType, const AdaptiveResolution& adaptive) {
+	TaskKind kind;
+	if (!knownTaskType(taskType, kind)) {
+		return;
+	}
+	WriteLog(L"[GUITaskProcessor] Adaptive resolution for " + std::wstring(taskType.begin(), taskType.end()) + L": " +
+		std::wstring(adaptive.enabled ? L"on, " : L"off, ") + QwenAPI::ANSIToUnicodeSafe(adaptive.toString()));
+	adaptiveResolutions_[kind] = adaptive;
+}
+
+void GUITaskProcessor::setResizePolicy(const std::string& taskType, const ResizePolicy& policy) {
+	TaskKind kind;
+	if (!knownTaskType(taskType, kind)) {
+		return;
+	}
+	WriteLog(L"[GUITaskProcessor] Resize policy for " + std::wstring(taskType.begin(), taskType.end()) + L": " +
+		QwenAPI::ANSIToUnicodeSafe(policy.toString()));
+	resizePolicies_[kind] = policy;
+}
+
+ImagePreprocessOptions GUITaskProcessor::baseOptionsFor(TaskKind kind) const {
+	ImagePreprocessOptions options;
+	auto kernelIt = resizeKernels_.find(kind);
+	if (kernelIt != resizeKernels_.end()) {
+		options.kernel = kernelIt->second;
+	}
+	auto decodeIt = decodeModes_.find(kind);
+	if (decodeIt != decodeModes_.end()) {
+		options.decodeMode = decodeIt->second;
+	}
+	auto policyIt = resizePolicies_.find(kind);
+	if (policyIt != resizePolicies_.end()) {
+		options.policy = policyIt->second;
+	}
+	auto adaptiveIt = adaptiveResolutions_.find(kind);
+	if (adaptiveIt != adaptiveResolutions_.end()) {
+		options.adaptive = adaptiveIt->second;
+	}
+	return options;
+}
+
+ImagePreprocessOptions GUITaskProcessor::preprocessOptionsFor(TaskKind kind) const {
+	ImagePreprocessOptions options = baseOptionsFor(kind);
+	// The first pass of two-pass mode only has to find the neighbourhood of the target. PatchGrid and
+	// adaptive sizing ignore targetSize, so their token budgets are capped at a coarseSize square as well.
+	const TwoPassOptions* twoPass = twoPassFor(kind);
+	if (twoPass) {
+		options.policy.targetSize = (std::min)(options.policy.targetSize, twoPass->coarseSize);
+		const int coarseSide = (std::max)(1, twoPass->coarseSize / (std::max)(1, options.policy.patchSize));
+		const int coarseTokens = coarseSide * coarseSide;
+		if (options.policy.mode == ResizeMode::PatchGrid) {
+			options.policy.maxTokens = (std::max)(options.policy.minTokens, (std::min)(options.policy.maxTokens, coarseTokens));
+		}
+		if (options.adaptive.enabled) {
+			options.adaptive.maxTokens = (std::min)(options.adaptive.maxTokens, coarseTokens);
+			options.adaptive.minTokens = (std::min)(options.adaptive.minTokens, options.adaptive.maxTokens);
+		}
+	}
+	return options;
+}
+
+const GUITaskProcessor::TwoPassOptions* GUITaskProcessor::twoPassFor(TaskKind kind) const {
+	auto it = twoPass_.find(kind);
+	return it != twoPass_.end() && it->second.enabled ? &it->second : nullptr;
+}
+
+void GUITaskProcessor::setTwoPassGrounding(const std::string& taskType, const TwoPassOptions& twoPass) {
+	TaskKind kind;
+	if (!knownTaskType(taskType, kind)) {
+		return;
+	}
+	if (!taskInfo(kind).refinable) {
+		WriteLog(L"[GUITaskProcessor] Two-pass mode does not apply to " + taskKindName(kind) + L" (answers carry no box)");
+		return;
+	}
+	WriteLog(L"[GUITaskProcessor] Two-pass " + std::wstring(taskType.begin(), taskType.end()) + L": " +
+		std::wstring(twoPass.enabled ? L"on" : L"off") + L", coarse " + std::to_wstring(twoPass.coarseSize) +
+		L", fine " + std::to_wstring(twoPass.fineSize) + L", margin " + std::to_wstring(twoPass.margin) +
+		L", min context " + std::to_wstring(twoPass.minContext));
+	twoPass_[kind] = twoPass;
+}
+
+GUITaskProcessor::TwoPassStatistics GUITaskProcessor::getTwoPassStatistics() const {
+	std::lock_guard<std::mutex> lock(statsMutex_);
+	return twoPassStats_;
+}
+
+template <TaskKind Kind>
+void GUITaskProcessor::submitRefinement(SharedImageContext coarseContext, const std::string& question,
+	const std::string& questionId, const std::string& coarseAnswer, const TwoPassOptions& twoPass, AnswerCallback done) {
+	int box[4];
+	const ImageTransform& coarse = coarseContext->transform;
+	if (!coarseContext->scaled || !coarse.isValid() || !findAnswerBox(coarseAnswer, box)) {
+		{
+			std::lock_guard<std::mutex> lock(statsMutex_);
+			twoPassStats_.coarseOnly++;
+		}
+		done(coarseAnswer);
+		return;
+	}
+
+	// Crop in original pixels around the coarse box; its transform takes the fine answer back to the screenshot
+	ImagePreprocessOptions options = baseOptionsFor(Kind);
+	options.crop = contextRegion(box, coarse.originalWidth, coarse.originalHeight, twoPass.margin, twoPass.minContext);
+	options.policy.mode = ResizeMode::Fit;
+	options.policy.targetSize = (std::min)(twoPass.fineSize, (std::max)(options.crop.width, options.crop.height));
+	options.adaptive.enabled = false;  // Sized for the crop already
+
+	const std::string imagePath = coarseContext->imagePath;
+	postFollowUp([this, imagePath, options, question, questionId, coarseAnswer, done]() {
+		qwenAPI_.prepareImageContextAsync(imagePath, options, [this, question, questionId, coarseAnswer, done](ImageContext& prepared) {
+			if (!prepared.scaled || prepared.base64Payload.empty()) {
+				{
+					std::lock_guard<std::mutex> lock(statsMutex_);
+					twoPassStats_.coarseOnly++;
+				}
+				done(coarseAnswer);
+				return;
+			}
+			SharedImageContext fineContext = std::make_shared<ImageContext>(std::move(prepared));
+			{
+				std::lock_guard<std::mutex> lock(statsMutex_);
+				twoPassStats_.fineBytes += fineContext->base64Payload.size();
+			}
+
+			std::string prompt = buildPrompt<Kind>(question, *fineContext);
+			WriteLog(L"[GUITaskProcessor] Refinement prompt: " + std::wstring(prompt.begin(), prompt.end()));
+			qwenAPI_.submitImageQuery(*fineContext, prompt, [this, fineContext, questionId, coarseAnswer, done](const QwenAPI::APIResponse& response) {
+				std::string answer;
+				if (response.success) {
+					answer = parseResult<Kind>(response.content, *fineContext);
+				}
+
+				int refined[4];
+				if (!findAnswerBox(answer, refined)) {
+					WriteLog(L"[GUITaskProcessor] Refinement gave no box for task " + std::wstring(questionId.begin(), questionId.end()) +
+						L", keeping the coarse answer");
+					{
+						std::lock_guard<std::mutex> lock(statsMutex_);
+						twoPassStats_.coarseOnly++;
+					}
+					done(coarseAnswer);
+					return;
+				}
+				WriteLog(L"[GUITaskProcessor] Refined task " + std::wstring(questionId.begin(), questionId.end()) + L": " +
+					std::wstring(coarseAnswer.begin(), coarseAnswer.end()) + L" -> " + std::wstring(answer.begin(), answer.end()));
+				{
+					std::lock_guard<std::mutex> lock(statsMutex_);
+					twoPassStats_.refined++;
+				}
+				done(answer);
+			});
+		});
+	});
+}
+
+bool GUITaskProcessor::validTiling(TilingOptions& tiling) {
+	if (!(tiling.aspectThreshold >= 1.0)) {
+		WriteLog(L"[GUITaskProcessor] Tiling aspect threshold must be at least 1, got " + std::to_wstring(tiling.aspectThreshold));
+		return false;
+	}
+	double overlap = (std::max)(0.0, (std::min)(0.9, tiling.overlap));
+	if (!(overlap == tiling.overlap)) {
+		WriteLog(L"[GUITaskProcessor] Tiling overlap " + std::to_wstring(tiling.overlap) + L" clamped to " + std::to_wstring(overlap));
+		tiling.overlap = overlap;
+	}
+	return true;
+}
+
+void GUITaskProcessor::setTiling(const TilingOptions& tiling) {
+	TilingOptions checked = tiling;
+	if (!validTiling(checked)) {
+		return;
+	}
+	WriteLog(L"[GUITaskProcessor] Tiling: " + std::wstring(checked.enabled ? L"on" : L"off") + L", aspect threshold " +
+		std::to_wstring(checked.aspectThreshold) + L", overlap " + std::to_wstring(checked.overlap) + L", tile size " +
+		std::to_wstring(checked.tileSize));
+	tiling_ = checked;
+}
+
+bool GUITaskProcessor::tileOptionsFor(const std::string& imagePath, const TilingOptions& tiling,
+	std::vector<ImagePreprocessOptions>& tileOptions) const {
+	tileOptions.clear();
+	std::pair<int, int> imageSize = getImageDimensions(imagePath);
+	std::vector<ImageRegion> tiles = tileRegions(imageSize.first, imageSize.second, tiling.aspectThreshold, tiling.overlap);
+	for (const ImageRegion& tile : tiles) {
+		ImagePreprocessOptions options = baseOptionsFor(TaskKind::Grounding);
+		options.crop = tile;
+		options.policy.mode = ResizeMode::Fit;
+		options.policy.targetSize = (std::min)(tiling.tileSize, (std::max)(tile.width, tile.height));
+		options.adaptive.enabled = false;
+		tileOptions.push_back(options);
+	}
+	return !tileOptions.empty();
+}
+
+void GUITaskProcessor::submitTiledTask(std::shared_ptr<const std::vector<ImageContext>> tiles, const std::string& question,
+	const std::string& questionId, AnswerCallback done) {
+	WriteLog(L"[GUITaskProcessor] Processing task " + std::wstring(questionId.begin(), questionId.end()) + L" over " +
+		std::to_wstring(tiles->size()) + L" tiles");
+	if (tiles->empty()) {
+		done("");
+		return;
+	}
+	const bool tall = (*tiles)[0].transform.sourceWidth == (*tiles)[0].transform.originalWidth;
+
+	// One request per tile, all submitted at once; tiles that do not show the component answer []. The last
+	// reply to arrive merges them.
+	struct TileAnswers {
+		std::mutex mutex;
+		std::vector<std::string> answers;
+		size_t outstanding = 0;
 	};
+	auto tileAnswers = std::make_shared<TileAnswers>();
+	tileAnswers->answers.resize(tiles->size());
+	tileAnswers->outstanding = tiles->size();
+	for (size_t i = 0; i < tiles->size(); ++i) {
+		const ImageContext& tile = (*tiles)[i];
+		std::string prompt = buildPrompt<TaskKind::Grounding>(question, tile) + " This image is section " + std::to_string(i + 1) +
+			" of " + std::to_string(tiles->size()) + " of a long screenshot, counted from the " + (tall ? "top" : "left") +
+			". If the component is not visible in this section, return [] instead.";
+		qwenAPI_.submitImageQuery(tile, prompt, [this, tiles, tileAnswers, i, questionId, done](const QwenAPI::APIResponse& response) {
+			std::string answer = response.success ? parseResultForGrounding(response.content, (*tiles)[i]) : std::string();
+			{
+				std::lock_guard<std::mutex> lock(tileAnswers->mutex);
+				tileAnswers->answers[i] = answer;
+				if (--tileAnswers->outstanding > 0) {
+					return;
+				}
+			}
+			done(mergeTileAnswers(*tiles, tileAnswers->answers, questionId));
+		});
+	}
+}
 
-	// Process each task type
-	for (const auto& taskConfig : taskConfigs) {
-		std::string taskType = taskConfig.first;
-		std::string basePath = taskConfig.second;
+std::string GUITaskProcessor::processTiledTask(const std::vector<ImageContext>& tiles, const std::string& question,
+	const std::string& questionId) {
+	std::shared_ptr<const std::vector<ImageContext>> borrowed(std::shared_ptr<const std::vector<ImageContext>>(), &tiles);
+	std::string answer;
+	bool answered = false;
+	submitTiledTask(borrowed, question, questionId, [this, &answer, &answered](const std::string& result) {
+		std::lock_guard<std::mutex> lock(taskLoopMutex_);
+		answer = result;
+		answered = true;
+		taskLoopChanged_.notify_all();
+	});
+	runFollowUpsUntil([&answered]() { return answered; });
+	return answer;
+}
 
-		std::wcout << L"[GUITaskProcessor] Processing task type: " <<
-			std::wstring(taskType.begin(), taskType.end()) << std::endl;
-		WriteLog(L"[GUITaskProcessor] Processing task type: " + std::wstring(taskType.begin(), taskType.end()));
+std::string GUITaskProcessor::mergeTileAnswers(const std::vector<ImageContext>& tiles, const std::vector<std::string>& answers,
+	const std::string& questionId) {
+	const bool tall = !tiles.empty() && tiles[0].transform.sourceWidth == tiles[0].transform.originalWidth;
+
+	// Boxes are already in screenshot coordinates. A component in an overlap can be found by both tiles:
+	// keep the sighting farthest from a cut edge, where the tile showed it whole.
+	struct Sighting {
+		std::string answer;
+		int box[4];
+		int edgeDistance;
+	};
+	std::vector<Sighting> sightings;
+	int duplicates = 0;
+	for (size_t i = 0; i < answers.size(); ++i) {
+		Sighting sighting;
+		sighting.answer = answers[i];
+		if (!findAnswerBox(sighting.answer, sighting.box)) {
+			continue;
+		}
+		const ImageTransform& t = tiles[i].transform;
+		const int tileStart = tall ? t.sourceY : t.sourceX;
+		const int tileEnd = tileStart + (tall ? t.sourceHeight : t.sourceWidth);
+		const int imageEnd = tall ? t.originalHeight : t.originalWidth;
+		const int boxStart = tall ? sighting.box[1] : sighting.box[0];
+		const int boxEnd = tall ? sighting.box[3] : sighting.box[2];
+		sighting.edgeDistance = (std::min)(tileStart > 0 ? boxStart - tileStart : INT_MAX,
+			tileEnd < imageEnd ? tileEnd - boxEnd : INT_MAX);
+
+		bool merged = false;
+		for (Sighting& existing : sightings) {
+			if (boxOverlap(existing.box, sighting.box) > 0.5) {
+				if (sighting.edgeDistance > existing.edgeDistance) {
+					existing = sighting;
+				}
+				merged = true;
+				duplicates++;
+				break;
+			}
+		}
+		if (!merged) {
+			sightings.push_back(sighting);
+		}
+	}
+
+	if (sightings.empty()) {
+		WriteLog(L"[GUITaskProcessor] No tile found the component for task " + std::wstring(questionId.begin(), questionId.end()));
+		return "";
+	}
+	const Sighting* best = &sightings[0];
+	for (const Sighting& sighting : sightings) {
+		if (sighting.edgeDistance > best->edgeDistance) {
+			best = &sighting;
+		}
+	}
+	WriteLog(L"[GUITaskProcessor] Tiled task " + std::wstring(questionId.begin(), questionId.end()) + L": " +
+		std::to_wstring(sightings.size()) + L" distinct boxes, " + std::to_wstring(duplicates) + L" overlap duplicates, answer " +
+		std::wstring(best->answer.begin(), best->answer.end()));
+	return best->answer;
+}
+
+void GUITaskProcessor::setReferringCrop(const ReferringCropOptions& crop) {
+	WriteLog(L"[GUITaskProcessor] Referring crop: " + std::wstring(crop.enabled ? L"on" : L"off") + L", margin " +
+		std::to_wstring(crop.margin) + L", min context " + std::to_wstring(crop.minContext) + L", target " +
+		std::to_wstring(crop.targetSize) + (crop.outline ? L", outlined" : L""));
+	referringCrop_ = crop;
+}
+
+bool GUITaskProcessor::referringCropOptionsFor(const std::string& imagePath, const std::string& question,
+	const ReferringCropOptions& crop, ImagePreprocessOptions& options) const {
+	int box[4];
+	if (!findQuestionBox(question, box)) {
+		return false;
+	}
+	std::pair<int, int> imageSize = getImageDimensions(imagePath);
+	const int imageWidth = imageSize.first, imageHeight = imageSize.second;
+	if (imageWidth <= 0 || imageHeight <= 0) {
+		return false;
+	}
+
+	const int boxWidth = box[2] - box[0], boxHeight = box[3] - box[1];
+	options = baseOptionsFor(TaskKind::Referring);
+	options.crop = contextRegion(box, imageWidth, imageHeight, crop.margin, crop.minContext);
+	// The crop keeps its native resolution up to targetSize; upscaling would only add bytes and tokens
+	options.policy.mode = ResizeMode::Fit;
+	options.policy.targetSize = (std::min)(crop.targetSize, (std::max)(options.crop.width, options.crop.height));
+	options.adaptive.enabled = false;
+	if (crop.outline && boxWidth > 0 && boxHeight > 0) {
+		options.outline.x = box[0];
+		options.outline.y = box[1];
+		options.outline.width = boxWidth;
+		options.outline.height = boxHeight;
+	}
+	return true;
+}
+
+bool GUITaskProcessor::loadBenchmarkTasks(TaskKind kind, size_t maxTasks, Json::Value& tasks,
+	std::vector<std::string>& imagePaths) {
+	const std::string imageBasePath = taskBasePath(kind) + "\\image";
+	Json::Value allTasks;
+	if (!loadTaskData(taskDataPath(kind), allTasks)) {
+		std::wcout << L"[GUITaskProcessor] Failed to load " << taskKindName(kind) << L" tasks for the benchmark" << std::endl;
+		return false;
+	}
+
+	tasks = Json::Value(Json::arrayValue);
+	imagePaths.clear();
+	for (Json::ArrayIndex i = 0; i < allTasks.size() && i < maxTasks; ++i) {
+		tasks.append(allTasks[i]);
+		imagePaths.push_back(imageBasePath + "\\" + allTasks[i]["image"].asString());
+	}
+	return true;
+}
 
-		std::string jsonFilePath;
-		if (taskType == "gui_grounding") {
-			jsonFilePath = basePath + "\\GUI_Grounding.json";
+GUITaskProcessor::GroundingPass GUITaskProcessor::runGroundingPass(const ImagePreprocessOptions& options, const Json::Value& tasks,
+	const std::vector<std::string>& imagePaths, const GroundingPass* baseline, const TilingOptions* tiling) {
+	GroundingPass pass;
+	for (Json::ArrayIndex i = 0; i < tasks.size(); ++i) {
+		const Json::Value& task = tasks[i];
+		std::string question = QwenAPI::UnicodeToANSI(UTF8ToUnicode(task["question"].asString()));
+
+		auto start = std::chrono::high_resolution_clock::now();
+		std::string answer;
+		std::vector<ImagePreprocessOptions> tileOptions;
+		if (tiling && tileOptionsFor(imagePaths[i], *tiling, tileOptions)) {
+			std::vector<ImageContext> tiles(tileOptions.size());
+			for (size_t t = 0; t < tileOptions.size(); ++t) {
+				QwenAPI::prepareImageContext(imagePaths[i], tiles[t], tileOptions[t]);
+				pass.payloadBytes += tiles[t].base64Payload.size();
+				pass.imageTokens += tiles[t].estimatedTokens;
+			}
+			answer = processTiledTask(tiles, question, task["question_id"].asString());
+		}
+		else {
+			ImageContext imageContext;
+			QwenAPI::prepareImageContext(imagePaths[i], imageContext, options);
+			pass.payloadBytes += imageContext.base64Payload.size();
+			pass.imageTokens += imageContext.estimatedTokens;
+			answer = processGUITask<TaskKind::Grounding>(imageContext, question, task["question_id"].asString());
 		}
-		else if (taskType == "gui_referring") {
-			jsonFilePath = basePath + "\\GUI_Referring.json";
+		pass.elapsedMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		pass.answers.push_back(answer);
+
+		int box[4];
+		if (!parseBox(answer, box)) {
+			continue;
+		}
+		pass.answered++;
+		int centerX = (box[0] + box[2]) / 2;
+		int centerY = (box[1] + box[3]) / 2;
+
+		int truth[4];
+		if (task.isMember("ground_truth") && parseBox(task["ground_truth"].asString(), truth)) {
+			pass.withTruth++;
+			if (centerX >= truth[0] && centerX <= truth[2] && centerY >= truth[1] && centerY <= truth[3]) {
+				pass.hits++;
+			}
 		}
-		else if (taskType == "advanced_vqa") {
-			jsonFilePath = basePath + "\\GUI_VQA.json";
+
+		int reference[4];
+		if (baseline && i < baseline->answers.size() && parseBox(baseline->answers[i], reference)) {
+			if (centerX >= reference[0] && centerX <= reference[2] && centerY >= reference[1] && centerY <= reference[3]) {
+				pass.agreed++;
+			}
 		}
+	}
+	return pass;
+}
+
+bool GUITaskProcessor::benchmarkResizeKernels(const std::vector<ResizeKernel>& kernels, size_t maxTasks) {
+	WriteLog(L"benchmarkResizeKernels called");
+	Json::Value tasks;
+	std::vector<std::string> imagePaths;
+	if (kernels.empty() || !loadBenchmarkTasks(TaskKind::Grounding, maxTasks, tasks, imagePaths)) {
+		return false;
+	}
+
+	// Resize time and output fidelity against Lanczos4 on the same images
+	ImagePreprocessor::benchmarkResizeKernels(imagePaths, kernels, ResizeKernel::Lanczos4, preprocessOptionsFor(TaskKind::Grounding));
+
+	// Grounding accuracy: the same questions, one pass per kernel
+	std::vector<GroundingPass> passes;
+	for (size_t k = 0; k < kernels.size(); ++k) {
+		ImagePreprocessOptions options = preprocessOptionsFor(TaskKind::Grounding);
+		options.kernel = kernels[k];
+		passes.push_back(runGroundingPass(options, tasks, imagePaths, k > 0 ? &passes[0] : nullptr));
+		const GroundingPass& pass = passes.back();
+
+		std::wstring summary = L"[GUITaskProcessor] Grounding with " + std::wstring(ImagePreprocessor::kernelName(kernels[k])) +
+			L": answered " + std::to_wstring(pass.answered) + L"/" + std::to_wstring(tasks.size()) +
+			L", hits " + std::to_wstring(pass.hits) + L"/" + std::to_wstring(pass.withTruth) +
+			(k > 0 ? L", agrees with " + std::wstring(ImagePreprocessor::kernelName(kernels[0])) + L": " + std::to_wstring(pass.agreed) : L"");
+		std::wcout << summary << std::endl;
+		WriteLog(summary);
+	}
+	return true;
+}
 
-		std::string imageBasePath = basePath + "\\image";
+bool GUITaskProcessor::benchmarkByteBudgets(const std::vector<int>& byteBudgets, size_t maxTasks) {
+	WriteLog(L"benchmarkByteBudgets called");
+	Json::Value tasks;
+	std::vector<std::string> imagePaths;
+	if (byteBudgets.empty() || !loadBenchmarkTasks(TaskKind::Grounding, maxTasks, tasks, imagePaths)) {
+		return false;
+	}
+
+	std::vector<GroundingPass> passes;
+	for (size_t b = 0; b < byteBudgets.size(); ++b) {
+		ImagePreprocessOptions options = preprocessOptionsFor(TaskKind::Grounding);
+		options.byteBudget = byteBudgets[b];
+		passes.push_back(runGroundingPass(options, tasks, imagePaths, b > 0 ? &passes[0] : nullptr));
+		const GroundingPass& pass = passes.back();
+
+		double saved = passes[0].payloadBytes > 0 ? 100.0 * (1.0 - (double)pass.payloadBytes / passes[0].payloadBytes) : 0.0;
+		std::wstring summary = L"[GUITaskProcessor] Grounding with byte budget " + std::to_wstring(byteBudgets[b]) +
+			L": payload " + std::to_wstring(pass.payloadBytes) + L" bytes (" + std::to_wstring(saved) + L"% saved)" +
+			L", answered " + std::to_wstring(pass.answered) + L"/" + std::to_wstring(tasks.size()) +
+			L", hits " + std::to_wstring(pass.hits) + L"/" + std::to_wstring(pass.withTruth) +
+			(b > 0 ? L", agrees with budget " + std::to_wstring(byteBudgets[0]) + L": " + std::to_wstring(pass.agreed) : L"");
+		std::wcout << summary << std::endl;
+		WriteLog(summary);
+	}
+
+	return true;
+}
+
+bool GUITaskProcessor::benchmarkAdaptiveResolution(const AdaptiveResolution& adaptive, size_t maxTasks) {
+	WriteLog(L"benchmarkAdaptiveResolution called");
+	Json::Value tasks;
+	std::vector<std::string> imagePaths;
+	if (!loadBenchmarkTasks(TaskKind::Grounding, maxTasks, tasks, imagePaths)) {
+		return false;
+	}
+
+	// Per-image decisions are logged by QwenAPI::scaleImage during the adaptive pass
+	std::vector<GroundingPass> passes;
+	for (int p = 0; p < 2; ++p) {
+		ImagePreprocessOptions options = preprocessOptionsFor(TaskKind::Grounding);
+		options.adaptive = adaptive;
+		options.adaptive.enabled = p == 1;
+		passes.push_back(runGroundingPass(options, tasks, imagePaths, p > 0 ? &passes[0] : nullptr));
+		const GroundingPass& pass = passes.back();
+
+		std::wstring summary = L"[GUITaskProcessor] Grounding with " + std::wstring(p == 0 ? L"fixed" : L"adaptive") +
+			L" resolution: payload " + std::to_wstring(pass.payloadBytes / (std::max)(1u, tasks.size())) + L" bytes and ~" +
+			std::to_wstring(pass.imageTokens / (std::max)(1u, tasks.size())) + L" image tokens per question" +
+			L", hits " + std::to_wstring(pass.hits) + L"/" + std::to_wstring(pass.withTruth) +
+			L", answered " + std::to_wstring(pass.answered) + L"/" + std::to_wstring(tasks.size()) +
+			(p > 0 ? L", agrees with fixed: " + std::to_wstring(pass.agreed) : L"");
+		std::wcout << summary << std::endl;
+		WriteLog(summary);
+	}
+	return true;
+}
+
+bool GUITaskProcessor::benchmarkTwoPassGrounding(const TwoPassOptions& twoPass, size_t maxTasks) {
+	WriteLog(L"benchmarkTwoPassGrounding called");
+	Json::Value tasks;
+	std::vector<std::string> imagePaths;
+	if (!loadBenchmarkTasks(TaskKind::Grounding, maxTasks, tasks, imagePaths)) {
+		return false;
+	}
+
+	// Single pass with the configured policy, then two passes; the caller's two-pass setting is restored afterwards
+	const TwoPassOptions saved = twoPass_[TaskKind::Grounding];
+	std::vector<GroundingPass> passes;
+	for (int p = 0; p < 2; ++p) {
+		TwoPassOptions mode = twoPass;
+		mode.enabled = p == 1;
+		twoPass_[TaskKind::Grounding] = mode;
+		const TwoPassStatistics before = getTwoPassStatistics();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		passes.push_back(runGroundingPass(preprocessOptionsFor(TaskKind::Grounding), tasks, imagePaths, p > 0 ? &passes[0] : nullptr));
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		const GroundingPass& pass = passes.back();
+
+		const TwoPassStatistics after = getTwoPassStatistics();
+		uint64_t fineBytes = after.fineBytes - before.fineBytes;
+		std::wstring summary = L"[GUITaskProcessor] Grounding " + std::wstring(p == 0 ? L"single-pass" : L"two-pass") +
+			L": hits " + std::to_wstring(pass.hits) + L"/" + std::to_wstring(pass.withTruth) +
+			L", answered " + std::to_wstring(pass.answered) + L"/" + std::to_wstring(tasks.size()) +
+			L", " + std::to_wstring(tasks.size() ? elapsedMs / tasks.size() : 0.0) + L" ms per question" +
+			L", payload " + std::to_wstring(pass.payloadBytes + fineBytes) + L" bytes" +
+			(p == 1 ? L" (" + std::to_wstring(fineBytes) + L" in crops), refined " +
+				std::to_wstring(after.refined - before.refined) + L", agrees with single-pass: " +
+				std::to_wstring(pass.agreed) : L"");
+		std::wcout << summary << std::endl;
+		WriteLog(summary);
+	}
+	twoPass_[TaskKind::Grounding] = saved;
+	return true;
+}
+
+bool GUITaskProcessor::benchmarkTiling(const TilingOptions& requestedTiling, size_t maxTasks) {
+	WriteLog(L"benchmarkTiling called");
+	TilingOptions tiling = requestedTiling;
+	if (!validTiling(tiling)) {
+		return false;
+	}
+	Json::Value allTasks;
+	std::vector<std::string> allImagePaths;
+	if (!loadBenchmarkTasks(TaskKind::Grounding, maxTasks, allTasks, allImagePaths)) {
+		return false;
+	}
+
+	// Only the questions about screenshots that would be tiled
+	Json::Value tasks(Json::arrayValue);
+	std::vector<std::string> imagePaths;
+	std::vector<ImagePreprocessOptions> tileOptions;
+	for (Json::ArrayIndex i = 0; i < allTasks.size(); ++i) {
+		if (tileOptionsFor(allImagePaths[i], tiling, tileOptions)) {
+			tasks.append(allTasks[i]);
+			imagePaths.push_back(allImagePaths[i]);
+		}
+	}
+	if (tasks.empty()) {
+		std::wcout << L"[GUITaskProcessor] No screenshot in the grounding test set exceeds aspect ratio " << tiling.aspectThreshold << std::endl;
+		return false;
+	}
+
+	std::vector<GroundingPass> passes;
+	for (int p = 0; p < 2; ++p) {
+		passes.push_back(runGroundingPass(preprocessOptionsFor(TaskKind::Grounding), tasks, imagePaths,
+			p > 0 ? &passes[0] : nullptr, p > 0 ? &tiling : nullptr));
+		const GroundingPass& pass = passes.back();
+
+		std::wstring summary = L"[GUITaskProcessor] Elongated screenshots " + std::wstring(p == 0 ? L"whole" : L"tiled") +
+			L": hits " + std::to_wstring(pass.hits) + L"/" + std::to_wstring(pass.withTruth) +
+			L", answered " + std::to_wstring(pass.answered) + L"/" + std::to_wstring(tasks.size()) +
+			L", " + std::to_wstring(pass.elapsedMs / tasks.size()) + L" ms per question, payload " +
+			std::to_wstring(pass.payloadBytes) + L" bytes" +
+			(p > 0 ? L", agrees with whole screen: " + std::to_wstring(pass.agreed) : L"");
+		std::wcout << summary << std::endl;
+		WriteLog(summary);
+	}
+	return true;
+}
+
+bool GUITaskProcessor::benchmarkInFlightWindows(const std::vector<int>& windows, size_t maxTasks) {
+	WriteLog(L"benchmarkInFlightWindows called");
+	Json::Value tasks;
+	std::vector<std::string> imagePaths;
+	if (windows.empty() || !loadBenchmarkTasks(TaskKind::Grounding, maxTasks, tasks, imagePaths)) {
+		return false;
+	}
+
+	// Bodies are built once, so every window sends the same bytes and only the network stage is timed
+	const ImagePreprocessOptions options = preprocessOptionsFor(TaskKind::Grounding);
+	std::vector<std::future<ImageContext>> preparedImages;
+	for (const std::string& imagePath : imagePaths) {
+		preparedImages.push_back(qwenAPI_.prepareImageContextAsync(imagePath, options));
+	}
+	std::vector<QwenAPI::SharedRequestBody> bodies;
+	for (Json::ArrayIndex i = 0; i < tasks.size(); ++i) {
+		ImageContext imageContext = preparedImages[i].get();
+		std::string question = QwenAPI::UnicodeToANSI(UTF8ToUnicode(tasks[i]["question"].asString()));
+		bodies.push_back(qwenAPI_.buildRequestBody(imageContext, buildPrompt<TaskKind::Grounding>(question, imageContext)));
+	}
+
+	const int previousWindow = qwenAPI_.getMaxInFlight();
+	double baselineMs = 0.0;
+	for (size_t w = 0; w < windows.size(); ++w) {
+		qwenAPI_.setMaxInFlight(windows[w]);
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<std::future<QwenAPI::APIResponse>> replies;
+		for (const auto& body : bodies) {
+			replies.push_back(qwenAPI_.submitRequestBody(body));
+		}
+		int succeeded = 0;
+		int rateLimited = 0;
+		for (auto& reply : replies) {
+			QwenAPI::APIResponse response = reply.get();
+			succeeded += response.success ? 1 : 0;
+			rateLimited += response.statusCode == 429 ? 1 : 0;
+		}
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+		if (w == 0) {
+			baselineMs = elapsedMs;
+		}
+
+		std::wstring summary = L"[GUITaskProcessor] In-flight window " + std::to_wstring(windows[w]) + L": " +
+			std::to_wstring(bodies.size()) + L" requests in " + std::to_wstring(elapsedMs) + L" ms, " +
+			std::to_wstring(elapsedMs > 0.0 ? bodies.size() * 1000.0 / elapsedMs : 0.0) + L" requests/s, speedup " +
+			std::to_wstring(elapsedMs > 0.0 ? baselineMs / elapsedMs : 0.0) + L"x, succeeded " + std::to_wstring(succeeded) +
+			L", rate limited " + std::to_wstring(rateLimited);
+		std::wcout << summary << std::endl;
+		WriteLog(summary);
+	}
+	qwenAPI_.setMaxInFlight(previousWindow);
+	qwenAPI_.logConnectionStatistics();
+	return true;
+}
+
+bool GUITaskProcessor::benchmarkReferringCrop(const ReferringCropOptions& crop, size_t maxTasks) {
+	WriteLog(L"benchmarkReferringCrop called");
+	Json::Value tasks;
+	std::vector<std::string> imagePaths;
+	if (!loadBenchmarkTasks(TaskKind::Referring, maxTasks, tasks, imagePaths)) {
+		return false;
+	}
+
+	// Same questions, whole screen then cropped; questions without a usable box stay on the whole screen
+	struct ReferringPass {
+		uint64_t payloadBytes = 0;
+		int64_t imageTokens = 0;
+		int cropped = 0;
+		int correct = 0;
+		int withTruth = 0;
+		int agreed = 0;
+		std::vector<std::string> answers;
+	};
+	ReferringPass passes[2];
+	for (int p = 0; p < 2; ++p) {
+		ReferringPass& pass = passes[p];
+		for (Json::ArrayIndex i = 0; i < tasks.size(); ++i) {
+			const Json::Value& task = tasks[i];
+			std::string question = QwenAPI::UnicodeToANSI(UTF8ToUnicode(task["question"].asString()));
+
+			ImagePreprocessOptions options = preprocessOptionsFor(TaskKind::Referring);
+			if (p == 1 && referringCropOptionsFor(imagePaths[i], question, crop, options)) {
+				pass.cropped++;
+			}
+			ImageContext imageContext;
+			QwenAPI::prepareImageContext(imagePaths[i], imageContext, options);
+			pass.payloadBytes += imageContext.base64Payload.size();
+			pass.imageTokens += imageContext.estimatedTokens;
+			std::string answer = processGUITask<TaskKind::Referring>(imageContext, question, task["question_id"].asString());
+			pass.answers.push_back(answer);
+
+			if (task.isMember("ground_truth")) {
+				pass.withTruth++;
+				if (answersMatch(answer, task["ground_truth"].asString())) {
+					pass.correct++;
+				}
+			}
+			if (p == 1 && answersMatch(answer, passes[0].answers[i])) {
+				pass.agreed++;
+			}
+		}
+
+		std::wstring summary = L"[GUITaskProcessor] Referring " + std::wstring(p == 0 ? L"full screen" : L"cropped") +
+			L" (" + std::to_wstring(pass.cropped) + L"/" + std::to_wstring(tasks.size()) + L" cropped): payload " +
+			std::to_wstring(pass.payloadBytes) + L" bytes, ~" + std::to_wstring(pass.imageTokens) + L" image tokens" +
+			L", matches ground truth " + std::to_wstring(pass.correct) + L"/" + std::to_wstring(pass.withTruth) +
+			(p == 1 ? L", agrees with full screen: " + std::to_wstring(pass.agreed) : L"");
+		std::wcout << summary << std::endl;
+		WriteLog(summary);
+	}
+	return true;
+}
+
+bool GUITaskProcessor::benchmarkImagePipeline(size_t maxTasks) {
+	WriteLog(L"benchmarkImagePipeline called");
+	Json::Value tasks;
+	std::vector<std::string> allImagePaths;
+	if (!loadBenchmarkTasks(TaskKind::Grounding, maxTasks, tasks, allImagePaths)) {
+		return false;
+	}
+	// Several questions share a screenshot; each one is measured once
+	std::vector<std::string> imagePaths;
+	for (const std::string& imagePath : allImagePaths) {
+		if (std::find(imagePaths.begin(), imagePaths.end(), imagePath) == imagePaths.end()) {
+			imagePaths.push_back(imagePath);
+		}
+	}
+	bool passed = true;
+
+	ImageProbe::BenchmarkResult probe = ImageProbe::benchmark(imagePaths, 3);
+	WriteLog(L"[GUITaskProcessor] Header probe over " + std::to_wstring(probe.imageCount) + L" images x " +
+		std::to_wstring(probe.iterations) + L": " + std::to_wstring(probe.probeMs) + L" ms vs " + std::to_wstring(probe.decodeMs) +
+		L" ms for a full decode, probe failures " + std::to_wstring(probe.probeFailures) + L", size mismatches " +
+		std::to_wstring(probe.mismatches));
+	passed = passed && probe.mismatches == 0;
+
+	const ImagePreprocessOptions options = preprocessOptionsFor(TaskKind::Grounding);
+	ImagePreprocessor::DecodeBenchmarkResult decode = ImagePreprocessor::benchmarkDecodeModes(imagePaths, options);
+	WriteLog(L"[GUITaskProcessor] Decode and resize over " + std::to_wstring(decode.imageCount) + L" images (" +
+		std::to_wstring(decode.reducedCount) + L" decoded reduced): full " + std::to_wstring(decode.fullMs) + L" ms, reduced " +
+		std::to_wstring(decode.reducedMs) + L" ms, PSNR " + std::to_wstring(decode.meanPSNR) + L" dB, SSIM " +
+		std::to_wstring(decode.meanSSIM));
+
+	ImageEncoder::JpegBenchmarkResult jpeg = ImageEncoder::benchmarkJpeg(imagePaths, options);
+	if (jpeg.turboAvailable) {
+		WriteLog(L"[GUITaskProcessor] JPEG encode over " + std::to_wstring(jpeg.imageCount) + L" images: imencode " +
+			std::to_wstring(jpeg.imencodeMs) + L" ms (" + std::to_wstring(jpeg.imencodeBytes) + L" bytes), libjpeg-turbo " +
+			std::to_wstring(jpeg.turboMs) + L" ms (" + std::to_wstring(jpeg.turboBytes) + L" bytes)");
+	}
+	else {
+		WriteLog(L"[GUITaskProcessor] JPEG encode over " + std::to_wstring(jpeg.imageCount) + L" images: imencode " +
+			std::to_wstring(jpeg.imencodeMs) + L" ms (" + std::to_wstring(jpeg.imencodeBytes) + L" bytes), libjpeg-turbo not available");
+	}
+
+	// Raw screencap dumps (adb exec-out screencap > frame.raw) are kept apart from the task images, which are PNGs
+	std::vector<std::string> rawPaths;
+	const std::string rawDirectory = "D:\\Git_ZPY\\IntentFlow\\test\\raw";
+	WIN32_FIND_DATAA findData;
+	HANDLE hFind = FindFirstFileA((rawDirectory + "\\*.raw").c_str(), &findData);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) {
+				rawPaths.push_back(rawDirectory + "\\" + findData.cFileName);
+			}
+		} while (FindNextFileA(hFind, &findData));
+		FindClose(hFind);
+	}
+	if (rawPaths.empty()) {
+		WriteLog(L"[GUITaskProcessor] No raw framebuffer dumps in " + std::wstring(rawDirectory.begin(), rawDirectory.end()) +
+			L", raw ingestion not measured");
+	}
+	else {
+		QwenAPI::RawIngestionBenchmark raw = QwenAPI::benchmarkRawIngestion(rawPaths, options);
+		WriteLog(L"[GUITaskProcessor] Raw ingestion over " + std::to_wstring(raw.imageCount) + L" frames x " +
+			std::to_wstring(raw.iterations) + L": raw " + std::to_wstring(raw.rawMs) + L" ms (" + std::to_wstring(raw.rawBytes) +
+			L" bytes captured), PNG " + std::to_wstring(raw.pngMs) + L" ms (" + std::to_wstring(raw.pngBytes) + L" bytes captured)");
+	}
+
+	// Every SIMD encoder has to match the reference bit for bit before its speed means anything
+	bool base64Exact = Base64::verify();
+	WriteLog(std::wstring(L"[GUITaskProcessor] Base64 encoders ") + (base64Exact ? L"match" : L"DO NOT match") +
+		L" the reference; active: " + Base64::implementationName(Base64::activeImplementation()));
+	passed = passed && base64Exact;
+	for (const Base64::BenchmarkResult& result : Base64::benchmark()) {
+		WriteLog(L"[GUITaskProcessor] Base64 " + std::wstring(Base64::implementationName(result.implementation)) + L": " +
+			std::to_wstring(result.gbPerSecond) + L" GB/s");
+	}
+
+	std::wstring summary = std::wstring(L"[GUITaskProcessor] Image pipeline benchmark ") + (passed ? L"passed" : L"FAILED");
+	std::wcout << summary << std::endl;
+	WriteLog(summary);
+	return passed;
+}
+
+bool GUITaskProcessor::processAllTasks() {
+	WriteLog(L"processAllTasks called");
+	std::wcout << L"[GUITaskProcessor] Starting to process all GUI tasks..." << std::endl;
+	WriteLog(L"[GUITaskProcessor] Starting to process all GUI tasks...");
+
+	// Load every task type first, so questions about the same screenshot share one payload across types
+	std::vector<TaskBatch> batches;
+	for (TaskKind kind : kTaskKinds) {
+		std::wcout << L"[GUITaskProcessor] Loading task type: " << taskKindName(kind) << std::endl;
+		WriteLog(L"[GUITaskProcessor] Loading task type: " + taskKindName(kind));
 
 		// Load task data
-		Json::Value tasks;
-		if (!loadTaskData(jsonFilePath, tasks)) {
+		TaskBatch batch;
+		batch.kind = kind;
+		batch.imageBasePath = taskBasePath(kind) + "\\image";
+		std::string jsonFilePath = taskDataPath(kind);
+		if (!loadTaskData(jsonFilePath, batch.tasks)) {
 			std::wcout << L"[GUITaskProcessor] Failed to load task data from: " <<
 				std::wstring(jsonFilePath.begin(), jsonFilePath.end()) << std::endl;
 			WriteLog(L"[GUITaskProcessor] Failed to load task data from: " + std::wstring(jsonFilePath.begin(), jsonFilePath.end()));
 			continue;
 		}
-
-		// Process tasks
-		if (!processGUITasks(taskType, imageBasePath, jsonFilePath, tasks)) {
-			std::wcout << L"[GUITaskProcessor] Failed to process tasks for type: " <<
-				std::wstring(taskType.begin(), taskType.end()) << std::endl;
-			WriteLog(L"[GUITaskProcessor] Failed to process tasks for type: " + std::wstring(taskType.begin(), taskType.end()));
-			continue;
-		}
+		batches.push_back(std::move(batch));
 	}
 
+	// Process tasks; each type's results are saved as soon as its last task is answered
+	runTaskBatches(batches);
+
 	std::wcout << L"[GUITaskProcessor] Finished processing all GUI tasks." << std::endl;
 	WriteLog(L"[GUITaskProcessor] Finished processing all GUI tasks.");
 	return true;
@@ -285,33 +1325,14 @@ bool GUITaskProcessor::processGUITasks(const std::string& taskType) {
 		std::wstring(taskType.begin(), taskType.end()) << std::endl;
 
 	// Define task type and path
-	std::string basePath;
-	if (taskType == "gui_grounding") {
-		basePath = "D:\\Git_ZPY\\IntentFlow\\test\\GUI_Grounding";
-	}
-	else if (taskType == "gui_referring") {
-		basePath = "D:\\Git_ZPY\\IntentFlow\\test\\GUI_Referring";
-	}
-	else if (taskType == "advanced_vqa") {
-		basePath = "D:\\Git_ZPY\\IntentFlow\\test\\GUI_VQA";
-	}
-	else {
+	TaskKind kind;
+	if (!taskKindFromName(taskType, kind)) {
 		std::wcout << L"[GUITaskProcessor] Unknown task type: " <<
 			std::wstring(taskType.begin(), taskType.end()) << std::endl;
 		return false;
 	}
-
-	std::string jsonFilePath;
-	if (taskType == "gui_grounding") {
-		jsonFilePath = basePath + "\\GUI_Grounding.json";
-	}
-	else if (taskType == "gui_referring") {
-		jsonFilePath = basePath + "\\GUI_Referring.json";
-	}
-	else if (taskType == "advanced_vqa") {
-		jsonFilePath = basePath + "\\GUI_VQA.json";
-	}
-
+	std::string basePath = taskBasePath(kind);
+	std::string jsonFilePath = taskDataPath(kind);
 	std::string imageBasePath = basePath + "\\image";
 
 	// Load task data
@@ -323,7 +1344,7 @@ bool GUITaskProcessor::processGUITasks(const std::string& taskType) {
 	}
 
 	// Process tasks
-	bool result = processGUITasks(taskType, imageBasePath, jsonFilePath, tasks);
+	bool result = processGUITasks(kind, imageBasePath, jsonFilePath, tasks);
 
 	if (result) {
 		std::wcout << L"[GUITaskProcessor] Finished processing GUI tasks of type: " <<
@@ -403,152 +1424,519 @@ bool GUITaskProcessor::parseJsonLines(const std::string& content, Json::Value& r
 	return true;
 }
 
-bool GUITaskProcessor::processGUITasks(const std::string& taskType,
+bool GUITaskProcessor::processGUITasks(TaskKind kind,
 	const std::string& imagePath,
 	const std::string& jsonDataPath,
 	Json::Value& tasks) {
-	WriteLog(L"processGUITasks called with taskType: " + std::wstring(taskType.begin(), taskType.end()));
-	std::wcout << L"[GUITaskProcessor] Processing " << tasks.size() << L" " <<
-		std::wstring(taskType.begin(), taskType.end()) << L" tasks" << std::endl;
-	WriteLog(L"[GUITaskProcessor] Processing " + std::to_wstring(tasks.size()) + L" " +
-		std::wstring(taskType.begin(), taskType.end()) + L" tasks");
+	std::vector<TaskBatch> batches(1);
+	batches[0].kind = kind;
+	batches[0].imageBasePath = imagePath;
+	batches[0].tasks.swap(tasks);
+	bool result = runTaskBatches(batches);
+	tasks.swap(batches[0].tasks);
+	return result;
+}
+
+std::vector<GUITaskProcessor::ImageGroup> GUITaskProcessor::groupTasksByImage(const std::vector<TaskBatch>& batches) const {
+	std::vector<ImageGroup> groups;
+	std::map<std::string, size_t> groupByPath;                  // path|options -> group
+	std::map<std::string, size_t> groupByFile;  // file name|size|write time|options -> group from any directory
+
+	// Each task type has its own image directory, so the same screenshot can appear under several paths.
+	// Copies are recognised from the file attributes alone (no file is read here, this runs before any
+	// preprocessing starts): same name, size and last write time.
+
+	for (size_t b = 0; b < batches.size(); ++b) {
+		const TaskBatch& batch = batches[b];
+		const ImagePreprocessOptions options = preprocessOptionsFor(batch.kind);
+		const std::string optionsKey = options.toString();
+
+		for (Json::ArrayIndex i = 0; i < batch.tasks.size(); ++i) {
+			std::string fileName = batch.tasks[i]["image"].asString();
+			std::string path = batch.imageBasePath + "\\" + fileName;
+			std::string pathKey = path + "|" + optionsKey;
+
+			auto found = groupByPath.find(pathKey);
+			size_t group = groups.size();
+			if (found != groupByPath.end()) {
+				group = found->second;
+			}
+			else {
+				WIN32_FILE_ATTRIBUTE_DATA attributes;
+				if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes)) {
+					uint64_t fileSize = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+					uint64_t lastWrite = (static_cast<uint64_t>(attributes.ftLastWriteTime.dwHighDateTime) << 32) |
+						attributes.ftLastWriteTime.dwLowDateTime;
+					std::string fileKey = fileName + "|" + std::to_string(fileSize) + "|" + std::to_string(lastWrite) + "|" + optionsKey;
+					auto sameFile = groupByFile.find(fileKey);
+					if (sameFile != groupByFile.end()) {
+						group = sameFile->second;
+					}
+					else {
+						groupByFile[fileKey] = group;
+					}
+				}
+
+				if (group == groups.size()) {
+					ImageGroup newGroup;
+					newGroup.imagePath = path;
+					newGroup.options = options;
+					groups.push_back(newGroup);
+				}
+				groupByPath[pathKey] = group;
+			}
+			groups[group].tasks.push_back(std::make_pair(b, i));
+		}
+	}
+	return groups;
+}
+
+bool GUITaskProcessor::runTaskBatches(std::vector<TaskBatch>& batches) {
+	size_t questionCount = 0;
+	for (const auto& batch : batches) {
+		WriteLog(L"processGUITasks called with taskType: " + taskKindName(batch.kind));
+		std::wcout << L"[GUITaskProcessor] Processing " << batch.tasks.size() << L" " << taskKindName(batch.kind) << L" tasks" << std::endl;
+		WriteLog(L"[GUITaskProcessor] Processing " + std::to_wstring(batch.tasks.size()) + L" " + taskKindName(batch.kind) + L" tasks");
+		questionCount += batch.tasks.size();
+	}
+
+	// Every screenshot is prepared once and all questions about it are submitted together.
+	// Answers are written into their own task entries, so the result files keep the source order.
+	std::vector<ImageGroup> groups = groupTasksByImage(batches);
+	std::wstring groupSummary = L"[GUITaskProcessor] " + std::to_wstring(questionCount) + L" questions over " +
+		std::to_wstring(groups.size()) + L" distinct images";
+	std::wcout << groupSummary << std::endl;
+	WriteLog(groupSummary);
+
+	// A result file is written as soon as the last task of its type is answered, so a type that finishes
+	// early is on disk even if a later one fails or is interrupted
+	bool saved = true;
+	std::vector<size_t> unansweredTasks(batches.size());
+	auto saveBatch = [&](const TaskBatch& batch) {
+		if (!saveResults(batch.kind, batch.tasks)) {
+			std::wcout << L"[GUITaskProcessor] Failed to save results for type: " << taskKindName(batch.kind) << std::endl;
+			WriteLog(L"[GUITaskProcessor] Failed to save results for type: " + taskKindName(batch.kind));
+			saved = false;
+		}
+	};
+	for (size_t b = 0; b < batches.size(); ++b) {
+		unansweredTasks[b] = batches[b].tasks.size();
+		if (unansweredTasks[b] == 0) {
+			saveBatch(batches[b]);
+		}
+	}
+
+	// Questions are submitted without waiting for their replies; each answer is written into its task entry
+	// by the callback that receives it, on a transport thread. Task entries, unansweredTasks and
+	// pendingQuestions change only under taskLoopMutex_; the save of a finished type is a follow-up, run here.
+	size_t pendingQuestions = 0;
+	auto answerTo = [&](const std::pair<size_t, Json::ArrayIndex>& taskRef, const std::string& questionId) -> AnswerCallback {
+		TaskBatch* batch = &batches[taskRef.first];
+		size_t* unanswered = &unansweredTasks[taskRef.first];
+		const Json::ArrayIndex index = taskRef.second;
+		return [this, batch, unanswered, index, questionId, &saveBatch, &pendingQuestions](const std::string& answer) {
+			std::wcout << L"[GUITaskProcessor] Processed task " <<
+				std::wstring(questionId.begin(), questionId.end()) <<
+				L", answer: " << std::wstring(answer.begin(), answer.end()) << std::endl;
+			WriteLog(L"[GUITaskProcessor] Processed task " + std::wstring(questionId.begin(), questionId.end()) +
+				L", answer: " + std::wstring(answer.begin(), answer.end()));
+
+			std::lock_guard<std::mutex> lock(taskLoopMutex_);
+			batch->tasks[index]["answer"] = answer;
+			if (--*unanswered == 0) {
+				followUps_.push_back([batch, &saveBatch]() { saveBatch(*batch); });
+			}
+			pendingQuestions--;
+			taskLoopChanged_.notify_all();
+		};
+	};
+
+	// About two windows of questions are kept submitted: enough to refill every request slot as replies come
+	// in, without prepared payloads piling up behind the request engine
+	const size_t maxPendingQuestions = static_cast<size_t>((std::max)(1, qwenAPI_.getMaxInFlight())) * 2;
+	const std::vector<TaskBatch>& sourceBatches = batches;  // Read only from here on; answers go through answerTo
+	auto runStart = std::chrono::high_resolution_clock::now();
+
+	// Decode/resize/encode runs on the preprocessing pool, a window of images ahead of the network stage,
+	// so the next images are ready by the time the current requests return
+	const size_t prefetchDepth = qwenAPI_.preprocessThreadCount() * 2;
+	std::vector<std::future<ImageContext>> preparedImages(groups.size());
+	std::vector<std::vector<std::future<ImageContext>>> croppedImages(groups.size());
+	std::vector<std::vector<std::future<ImageContext>>> tiledImages(groups.size());
+	size_t nextToPrepare = 0;
+
+	for (size_t g = 0; g < groups.size(); ++g) {
+		while (nextToPrepare < groups.size() && nextToPrepare <= g + prefetchDepth) {
+			// Referring questions in crop mode get their own crop and grounding questions about an elongated
+			// screenshot share its tiles; the whole screen is only prepared when some question still needs it
+			const ImageGroup& prefetch = groups[nextToPrepare];
+			std::vector<std::future<ImageContext>>& crops = croppedImages[nextToPrepare];
+			crops.resize(prefetch.tasks.size());
+			std::vector<ImagePreprocessOptions> tileOptions;
+			if (tiling_.enabled) {
+				tileOptionsFor(prefetch.imagePath, tiling_, tileOptions);
+			}
+			bool fullImageNeeded = false;
+			for (size_t t = 0; t < prefetch.tasks.size(); ++t) {
+				const TaskBatch& batch = sourceBatches[prefetch.tasks[t].first];
+				const TaskInfo info = taskInfo(batch.kind);
+				ImagePreprocessOptions cropOptions;
+				if (info.tileable && !tileOptions.empty()) {
+					if (tiledImages[nextToPrepare].empty()) {
+						for (const ImagePreprocessOptions& options : tileOptions) {
+							tiledImages[nextToPrepare].push_back(qwenAPI_.prepareImageContextAsync(prefetch.imagePath, options));
+						}
+					}
+				}
+				else if (referringCrop_.enabled && info.croppable &&
+					referringCropOptionsFor(prefetch.imagePath, batch.tasks[prefetch.tasks[t].second]["question"].asString(),
+						referringCrop_, cropOptions)) {
+					crops[t] = qwenAPI_.prepareImageContextAsync(prefetch.imagePath, cropOptions);
+				}
+				else {
+					fullImageNeeded = true;
+				}
+			}
+			if (fullImageNeeded) {
+				preparedImages[nextToPrepare] = qwenAPI_.prepareImageContextAsync(prefetch.imagePath, prefetch.options);
+			}
+			nextToPrepare++;
+		}
 
-	// Process each task
-	for (Json::Value& task : tasks) {
-		// Get task information
-		std::string imageFileName = task["image"].asString();
-		std::string question = task["question"].asString();
-		std::string questionId = task["question_id"].asString();
+		// Wait for a free place in the window, running follow-ups (two-pass crops, saves) in the meantime
+		runFollowUpsUntil([&]() { return pendingQuestions < maxPendingQuestions; });
 
-		// Ensure question is properly UTF-8 encoded
-		std::wstring wideQuestion = UTF8ToUnicode(question);
-		//std::string utf8Question = UnicodeToUTF8(wideQuestion);
-		std::string utf8Question = QwenAPI::UnicodeToANSI(wideQuestion);
-		WriteLog(L"Question: " + std::wstring(utf8Question.begin(), utf8Question.end()));
+		// Wait for this image (usually already prepared while the previous requests were in flight)
+		SharedImageContext imageContext = std::make_shared<ImageContext>(preparedImages[g].valid() ? preparedImages[g].get() : ImageContext());
+		auto tiles = std::make_shared<std::vector<ImageContext>>();
+		for (auto& tile : tiledImages[g]) {
+			tiles->push_back(tile.get());
+		}
+		const ImageGroup& group = groups[g];
+
+		std::vector<std::string> questions, questionIds;
+		for (const auto& taskRef : group.tasks) {
+			const Json::Value& task = sourceBatches[taskRef.first].tasks[taskRef.second];
+
+			// Ensure question is properly UTF-8 encoded
+			std::wstring wideQuestion = UTF8ToUnicode(task["question"].asString());
+			//std::string utf8Question = UnicodeToUTF8(wideQuestion);
+			std::string utf8Question = QwenAPI::UnicodeToANSI(wideQuestion);
+			WriteLog(L"Question: " + std::wstring(utf8Question.begin(), utf8Question.end()));
+			questions.push_back(utf8Question);
+			questionIds.push_back(task["question_id"].asString());
+		}
 
-		// Build full image path
-		std::string fullImagePath = imagePath + "\\" + imageFileName;
+		std::vector<AnswerCallback> answerCallbacks;
+		for (size_t t = 0; t < group.tasks.size(); ++t) {
+			answerCallbacks.push_back(answerTo(group.tasks[t], questionIds[t]));
+		}
+		{
+			std::lock_guard<std::mutex> lock(taskLoopMutex_);
+			pendingQuestions += group.tasks.size();
+		}
 
-		// Process single task
-		std::string answer = processGUITask(taskType, fullImagePath, utf8Question, questionId);
+		// Packed calls first; a question a packed reply leaves unanswered is asked on its own from its callback
+		std::vector<bool> packed(group.tasks.size(), false);
+		if (questionsPerCall_ > 1 && !imageContext->base64Payload.empty()) {
+			for (TaskKind kind : kTaskKinds) {
+				const TaskInfo info = taskInfo(kind);
+				if (!info.packable || twoPassFor(kind) || (info.tileable && !tiles->empty())) {
+					continue;
+				}
+				std::vector<size_t> members;
+				for (size_t t = 0; t < group.tasks.size(); ++t) {
+					if (sourceBatches[group.tasks[t].first].kind == kind) {
+						members.push_back(t);
+					}
+				}
 
-		// Update task result
-		task["answer"] = answer;
+				for (size_t first = 0; first + 1 < members.size(); first += questionsPerCall_) {
+					size_t last = (std::min)(members.size(), first + static_cast<size_t>(questionsPerCall_));
+					std::vector<std::string> packQuestions, packIds;
+					std::vector<AnswerCallback> packCallbacks;
+					for (size_t m = first; m < last; ++m) {
+						packQuestions.push_back(questions[members[m]]);
+						packIds.push_back(questionIds[members[m]]);
+						packCallbacks.push_back(answerCallbacks[members[m]]);
+						packed[members[m]] = true;
+					}
+					visitTaskKind(kind, [&](auto traits) {
+						typedef decltype(traits) Traits;
+						this->submitPackedTasks<Traits::kind>(imageContext, packQuestions, packIds,
+							[this, imageContext, packQuestions, packIds, packCallbacks](const std::vector<std::string>& answers) {
+								for (size_t i = 0; i < answers.size(); ++i) {
+									if (answers[i].empty()) {
+										this->submitGUITask<Traits::kind>(imageContext, packQuestions[i], packIds[i], packCallbacks[i]);
+									}
+									else {
+										packCallbacks[i](answers[i]);
+									}
+								}
+							});
+					});
+				}
+			}
+		}
+
+		for (size_t t = 0; t < group.tasks.size(); ++t) {
+			if (packed[t]) {
+				continue;
+			}
+			const TaskKind kind = sourceBatches[group.tasks[t].first].kind;
 
-		std::wcout << L"[GUITaskProcessor] Processed task " <<
-			std::wstring(questionId.begin(), questionId.end()) <<
-			L", answer: " << std::wstring(answer.begin(), answer.end()) << std::endl;
-		WriteLog(L"[GUITaskProcessor] Processed task " + std::wstring(questionId.begin(), questionId.end()) +
-			L", answer: " + std::wstring(answer.begin(), answer.end()));
+			// Process single task
+			if (croppedImages[g][t].valid()) {
+				submitGUITask(kind, std::make_shared<ImageContext>(croppedImages[g][t].get()), questions[t], questionIds[t],
+					answerCallbacks[t]);
+			}
+			else if (taskInfo(kind).tileable && !tiles->empty()) {
+				submitTiledTask(tiles, questions[t], questionIds[t], answerCallbacks[t]);
+			}
+			else {
+				submitGUITask(kind, imageContext, questions[t], questionIds[t], answerCallbacks[t]);
+			}
+		}
 	}
 
-	// Save results
-	std::string outputFileName;
-	if (taskType == "gui_grounding") {
-		outputFileName = "gui_grounding_result.json";
+	// Every answer, two-pass refinements included, is in its task entry and every type saved before this returns
+	runFollowUpsUntil([&]() { return pendingQuestions == 0; });
+	qwenAPI_.waitForSubmitted();
+	double runSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - runStart).count();
+	std::wstring runSummary = L"[GUITaskProcessor] " + std::to_wstring(questionCount) + L" questions in " +
+		std::to_wstring(runSeconds) + L" s, " + std::to_wstring(runSeconds > 0 ? questionCount / runSeconds : 0.0) +
+		L" questions/s with " + std::to_wstring(qwenAPI_.getMaxInFlight()) + L" requests in flight";
+	std::wcout << runSummary << std::endl;
+	WriteLog(runSummary);
+
+	// Report how much preprocessing the payload cache saved on this batch
+	QwenAPI::imageCache().logStatistics();
+	qwenAPI_.logPayloadStatistics();
+	qwenAPI_.logPreprocessStatistics();
+	qwenAPI_.logConnectionStatistics();
+	if (questionsPerCall_ > 1) {
+		logPackingStatistics();
 	}
-	else if (taskType == "gui_referring") {
-		outputFileName = "gui_referring_result.json";
+	bool twoPassUsed = false;
+	for (TaskKind kind : kTaskKinds) {
+		twoPassUsed = twoPassUsed || twoPassFor(kind);
 	}
-	else if (taskType == "advanced_vqa") {
-		outputFileName = "gui_vqa_result.json";
+	if (twoPassUsed) {
+		const TwoPassStatistics twoPassStats = getTwoPassStatistics();
+		std::wstring summary = L"[GUITaskProcessor] Two-pass: refined " + std::to_wstring(twoPassStats.refined) +
+			L", kept coarse " + std::to_wstring(twoPassStats.coarseOnly) + L", crop payload " +
+			std::to_wstring(twoPassStats.fineBytes) + L" bytes";
+		std::wcout << summary << std::endl;
+		WriteLog(summary);
 	}
+	return saved;
+}
 
-	std::string outputFilePath = "D:\\Git_ZPY\\IntentFlow\\" + outputFileName;
-	return saveResults(outputFilePath, tasks);
+void GUITaskProcessor::setQuestionPacking(int maxQuestionsPerCall) {
+	WriteLog(L"[GUITaskProcessor] Questions per call: " + std::to_wstring(maxQuestionsPerCall));
+	questionsPerCall_ = maxQuestionsPerCall;
 }
 
-std::string GUITaskProcessor::processGUITask(const std::string& taskType,
-	const std::string& imagePath,
-	const std::string& question,
-	const std::string& questionId) {
-	WriteLog(L"processGUITask called for questionId: " + std::wstring(questionId.begin(), questionId.end()));
-	std::wcout << L"[GUITaskProcessor] Processing task: " <<
-		std::wstring(questionId.begin(), questionId.end()) << std::endl;
-	WriteLog(L"[GUITaskProcessor] Processing task: " + std::wstring(questionId.begin(), questionId.end()));
+GUITaskProcessor::PackingStatistics GUITaskProcessor::getPackingStatistics() const {
+	std::lock_guard<std::mutex> lock(statsMutex_);
+	return packingStats_;
+}
 
-	// Store the current image path for use in parseResultForGrounding
-	currentImagePath = imagePath;
+void GUITaskProcessor::logPackingStatistics() const {
+	const PackingStatistics stats = getPackingStatistics();
+	std::wstring summary = L"[GUITaskProcessor] Packed calls: " + std::to_wstring(stats.packedCalls) + L" for " +
+		std::to_wstring(stats.packedQuestions) + L" questions, " + std::to_wstring(stats.fallbackQuestions) +
+		L" fell back to single calls; calls saved: " + std::to_wstring(stats.callsSaved) +
+		L", image tokens saved: " + std::to_wstring(stats.imageTokensSaved);
+	std::wcout << summary << std::endl;
+	WriteLog(summary);
+}
 
-	// Build prompt
-	std::string prompt;
-	if (taskType == "gui_grounding") {
-		prompt = buildPromptForGrounding(question);
-	}
-	else if (taskType == "gui_referring") {
-		// For GUI Referring, we need to scale the coordinates in the question
-		std::string scaledQuestion = scaleCoordinatesInQuestion(question, imagePath);
-		prompt = buildPromptForReferring(scaledQuestion);
-	}
-	else if (taskType == "advanced_vqa") {
-		prompt = buildPromptForVQA(question);
+template <TaskKind Kind>
+void GUITaskProcessor::submitPackedTasks(SharedImageContext imageContext, const std::vector<std::string>& questions,
+	const std::vector<std::string>& questionIds, PackedAnswerCallback done) {
+	std::string idList;
+	for (const auto& questionId : questionIds) {
+		idList += (idList.empty() ? "" : ",") + questionId;
 	}
+	std::wcout << L"[GUITaskProcessor] Processing packed tasks: " << std::wstring(idList.begin(), idList.end()) << std::endl;
+	WriteLog(L"[GUITaskProcessor] Processing packed tasks: " + std::wstring(idList.begin(), idList.end()));
 
+	std::string prompt = buildPackedPrompt<Kind>(questions, *imageContext);
 	WriteLog(L"[GUITaskProcessor] Prompt: " + std::wstring(prompt.begin(), prompt.end()));
 
-	// Call Qwen API
-	std::vector<std::string> imagePaths = { imagePath };
-	QwenAPI::APIResponse response = qwenAPI_.sendImageQuery(imagePaths, prompt);
+	qwenAPI_.submitImageQuery(*imageContext, prompt, [this, imageContext, questionIds, done](const QwenAPI::APIResponse& response) {
+		WriteLog(L"[GUITaskProcessor] API Response success: " + std::wstring(response.success ? L"true" : L"false"));
+		WriteLog(L"[GUITaskProcessor] API Response content: " + std::wstring(response.content.begin(), response.content.end()));
 
-	WriteLog(L"[GUITaskProcessor] API Response success: " + std::wstring(response.success ? L"true" : L"false"));
-	WriteLog(L"[GUITaskProcessor] API Response content: " + std::wstring(response.content.begin(), response.content.end()));
+		std::vector<std::string> answers(questionIds.size());
+		std::vector<std::string> items;
+		if (response.success && splitAnswerList(extractResponseText(response.content), questionIds.size(), items)) {
+			for (size_t i = 0; i < items.size(); ++i) {
+				if (items[i].empty()) {
+					continue;
+				}
+				// Same coordinate mapping as the single-question parsers; a grounding item without a box counts as unparsed
+				answers[i] = TaskTraits<Kind>::boxAnswer ? parseResultForGrounding(items[i], *imageContext) :
+					scaleBoxInText(items[i], *imageContext);
+			}
+		}
 
-	if (!response.success) {
-		std::wcout << L"[GUITaskProcessor] Failed to get response for task: " <<
-			std::wstring(questionId.begin(), questionId.end()) << std::endl;
-		WriteLog(L"[GUITaskProcessor] Failed to get response for task: " + std::wstring(questionId.begin(), questionId.end()));
-		return "";
-	}
+		int unanswered = 0;
+		for (size_t i = 0; i < answers.size(); ++i) {
+			if (answers[i].empty()) {
+				unanswered++;
+				WriteLog(L"[GUITaskProcessor] Packed answer missing for task " +
+					std::wstring(questionIds[i].begin(), questionIds[i].end()) + L", falling back to a single call");
+			}
+		}
 
-	// Parse result
-	std::string answer;
-	if (taskType == "gui_grounding") {
-		answer = parseResultForGrounding(response.content);
-	}
-	else if (taskType == "gui_referring") {
-		answer = parseResultForReferring(response.content);
-	}
-	else if (taskType == "advanced_vqa") {
-		answer = parseResultForVQA(response.content);
+		// Without packing every question is its own call; each fallback adds one back
+		int saved = static_cast<int>(questionIds.size()) - 1 - unanswered;
+		{
+			std::lock_guard<std::mutex> lock(statsMutex_);
+			packingStats_.packedCalls++;
+			packingStats_.packedQuestions += static_cast<int>(questionIds.size());
+			packingStats_.fallbackQuestions += unanswered;
+			packingStats_.callsSaved += saved;
+			packingStats_.imageTokensSaved += static_cast<int64_t>(saved) * imageContext->estimatedTokens;
+		}
+		done(answers);
+	});
+}
+
+template <TaskKind Kind>
+std::string GUITaskProcessor::buildPackedPrompt(const std::vector<std::string>& questions, const ImageContext& imageContext) {
+	typedef TaskTraits<Kind> Traits;
+	const std::string count = std::to_string(questions.size());
+	std::string prompt = Traits::role();
+	prompt += describeImageForPrompt(imageContext);
+	prompt += Traits::packedInstruction() + count + Traits::packedInstructionEnd();
+	for (size_t i = 0; i < questions.size(); ++i) {
+		prompt += "Question " + std::to_string(i + 1) + ": \"" + questions[i] + "\". ";
 	}
+	prompt += "Return only a JSON array of exactly " + count + " strings, the i-th string answering question i, nothing else. ";
+	prompt += Traits::packedItemFormat();
+	prompt += "The coordinates should be based on " + promptImageName(imageContext) + ", not the original image size.";
+	return prompt;
+}
 
-	WriteLog(L"[GUITaskProcessor] Parsed answer: " + std::wstring(answer.begin(), answer.end()));
+std::string GUITaskProcessor::taskBasePath(TaskKind kind) {
+	return std::string("D:\\Git_ZPY\\IntentFlow\\test\\") + taskInfo(kind).folder;
+}
 
-	return answer;
+std::string GUITaskProcessor::taskDataPath(TaskKind kind) {
+	return taskBasePath(kind) + "\\" + taskInfo(kind).folder + ".json";
 }
 
-std::string GUITaskProcessor::buildPromptForGrounding(const std::string& question) {
-	std::string prompt = "You are an expert in GUI understanding. ";
-	prompt += "The input image has been resized to 960x960 pixels for processing. ";
-	prompt += "Please identify the coordinates of the UI component mentioned in the question. ";
-	prompt += "The question is: \"" + question + "\". ";
-	prompt += "Return only the coordinates in the format [x1,y1,x2,y2] or [x,y], nothing else. ";
-	prompt += "Note that the coordinates should be based on the 960x960 pixel image, not the original image size.";
-	return prompt;
+std::string GUITaskProcessor::resultPathFor(TaskKind kind) {
+	return std::string("D:\\Git_ZPY\\IntentFlow\\") + taskInfo(kind).resultFile;
 }
 
-std::string GUITaskProcessor::buildPromptForReferring(const std::string& question) {
-	// For GUI Referring, the question contains a coordinate box like [x1,y1,x2,y2]
-	// We need to ask the model to describe what's in that box
+void GUITaskProcessor::submitGUITask(TaskKind kind,
+	SharedImageContext imageContext,
+	const std::string& question,
+	const std::string& questionId,
+	AnswerCallback done) {
+	visitTaskKind(kind, [&](auto traits) {
+		typedef decltype(traits) Traits;
+		this->submitGUITask<Traits::kind>(imageContext, question, questionId, done);
+	});
+}
 
-	std::string prompt = "You are an expert in mobile app GUI understanding. ";
-	prompt += "Please identify and describe the UI component at the specified location. ";
-	prompt += "The question is: \"" + question + "\". ";
-	prompt += "Return only a brief textual description of the component's function or content, nothing else.";
-	return prompt;
+template <TaskKind Kind>
+void GUITaskProcessor::submitGUITask(SharedImageContext imageContext,
+	const std::string& question,
+	const std::string& questionId,
+	AnswerCallback done) {
+	typedef TaskTraits<Kind> Traits;
+	WriteLog(L"processGUITask called for questionId: " + std::wstring(questionId.begin(), questionId.end()));
+	std::wcout << L"[GUITaskProcessor] Processing task: " <<
+		std::wstring(questionId.begin(), questionId.end()) << std::endl;
+	WriteLog(L"[GUITaskProcessor] Processing task: " + std::wstring(questionId.begin(), questionId.end()));
+
+	// The image was decoded and encoded once on the preprocessing pool; size, scale factors and payload are reused below
+	if (imageContext->base64Payload.empty()) {
+		std::wcout << L"[GUITaskProcessor] Failed to prepare image for task: " <<
+			std::wstring(questionId.begin(), questionId.end()) << std::endl;
+		WriteLog(L"[GUITaskProcessor] Failed to prepare image for task: " + std::wstring(questionId.begin(), questionId.end()));
+		done("");
+		return;
+	}
+
+	// Build prompt; a box in the question is in original pixels and has to be mapped onto the canvas
+	std::string prompt = buildPrompt<Kind>(Traits::mapsQuestionBox ? scaleCoordinatesInQuestion(question, *imageContext) : question,
+		*imageContext);
+
+	WriteLog(L"[GUITaskProcessor] Prompt: " + std::wstring(prompt.begin(), prompt.end()));
+
+	// Call Qwen API; the reply is handled on a transport thread
+	qwenAPI_.submitImageQuery(*imageContext, prompt, [this, imageContext, question, questionId, done](const QwenAPI::APIResponse& response) {
+		WriteLog(L"[GUITaskProcessor] API Response success: " + std::wstring(response.success ? L"true" : L"false"));
+		WriteLog(L"[GUITaskProcessor] API Response content: " + std::wstring(response.content.begin(), response.content.end()));
+
+		if (!response.success) {
+			std::wcout << L"[GUITaskProcessor] Failed to get response for task: " <<
+				std::wstring(questionId.begin(), questionId.end()) << std::endl;
+			WriteLog(L"[GUITaskProcessor] Failed to get response for task: " + std::wstring(questionId.begin(), questionId.end()));
+			done("");
+			return;
+		}
+
+		// Parse result
+		std::string answer = this->parseResult<Kind>(response.content, *imageContext);
+
+		WriteLog(L"[GUITaskProcessor] Parsed answer: " + std::wstring(answer.begin(), answer.end()));
+
+		const TwoPassOptions* twoPass = Traits::refinable ? this->twoPassFor(Kind) : nullptr;
+		if (twoPass && !answer.empty()) {
+			this->submitRefinement<Kind>(imageContext, question, questionId, answer, *twoPass, done);
+			return;
+		}
+		done(answer);
+	});
 }
 
-std::string GUITaskProcessor::buildPromptForVQA(const std::string& question) {
-	std::string prompt = "You are an expert in mobile app GUI understanding. ";
-	prompt += "The input image has been resized to 960x960 pixels for processing. ";
-	prompt += "Please answer the question according to the screen information. ";
-	prompt += "The question is: \"" + question + "\". ";
-	prompt += "Return the answer in the format \"text [x1, y1, x2, y2]\" where the coordinates indicate relevant UI components. ";
-	prompt += "The coordinates should be based on the 960x960 pixel image, not the original image size.";
-	return prompt;
+template <TaskKind Kind>
+std::string GUITaskProcessor::processGUITask(const ImageContext& imageContext,
+	const std::string& question,
+	const std::string& questionId) {
+	// Borrowed rather than owned: the answer, and with it the last use of the context, arrives before this returns
+	SharedImageContext borrowed(SharedImageContext(), &imageContext);
+	std::string answer;
+	bool answered = false;
+	submitGUITask<Kind>(borrowed, question, questionId, [this, &answer, &answered](const std::string& result) {
+		std::lock_guard<std::mutex> lock(taskLoopMutex_);
+		answer = result;
+		answered = true;
+		taskLoopChanged_.notify_all();
+	});
+	runFollowUpsUntil([&answered]() { return answered; });
+	return answer;
+}
+
+void GUITaskProcessor::postFollowUp(std::function<void()> work) {
+	std::lock_guard<std::mutex> lock(taskLoopMutex_);
+	followUps_.push_back(std::move(work));
+	taskLoopChanged_.notify_all();
 }
 
-std::string GUITaskProcessor::parseResultForGrounding(const std::string& response) {
+void GUITaskProcessor::runFollowUpsUntil(const std::function<bool()>& finished) {
+	std::unique_lock<std::mutex> lock(taskLoopMutex_);
+	for (;;) {
+		taskLoopChanged_.wait(lock, [&]() { return !followUps_.empty() || finished(); });
+		if (followUps_.empty()) {
+			return;
+		}
+		std::function<void()> work = std::move(followUps_.front());
+		followUps_.pop_front();
+		lock.unlock();
+		work();
+		lock.lock();
+	}
+}
+
+std::string GUITaskProcessor::parseResultForGrounding(const std::string& response, const ImageContext& imageContext) {
 	WriteLog(L"[parseResultForGrounding] Processing response");
 	WriteLog(L"[parseResultForGrounding] Response content: " + std::wstring(response.begin(), response.end()));
 
@@ -584,7 +1972,7 @@ std::string GUITaskProcessor::parseResultForGrounding(const std::string& respons
 					if (contentText.length() > 2 && contentText.front() == '[' && contentText.back() == ']') {
 						WriteLog(L"[parseResultForGrounding] Found coordinates in content text: " + std::wstring(contentText.begin(), contentText.end()));
 						// Scale the coordinates back to original image size
-						std::string scaledCoords = scaleCoordinatesInAnswer(contentText);
+						std::string scaledCoords = scaleCoordinatesInAnswer(contentText, imageContext);
 						return scaledCoords;
 					}
 				}
@@ -627,7 +2015,7 @@ std::string GUITaskProcessor::parseResultForGrounding(const std::string& respons
 			if (valid && potentialCoords.front() == '[' && potentialCoords.back() == ']') {
 				WriteLog(L"[parseResultForGrounding] Found coordinates directly using string parsing: " + std::wstring(potentialCoords.begin(), potentialCoords.end()));
 				// Scale the coordinates back to original image size
-				std::string scaledCoords = scaleCoordinatesInAnswer(potentialCoords);
+				std::string scaledCoords = scaleCoordinatesInAnswer(potentialCoords, imageContext);
 				return scaledCoords;
 			}
 			else {
@@ -720,7 +2108,39 @@ size_t findMatchingClosingBrace(const std::string& str, size_t openBracePos) {
 	return (braceCount == 0) ? (pos - 1) : std::string::npos;
 }
 
-std::string GUITaskProcessor::parseResultForVQA(const std::string& response) {
+std::string GUITaskProcessor::scaleBoxInText(const std::string& text, const ImageContext& imageContext) {
+	std::string contentText = text;
+
+	// Check if the content text contains coordinates and scale them back to original image size
+	size_t openBracketPos = contentText.find('[');
+	if (openBracketPos != std::string::npos) {
+		size_t closeBracketPos = contentText.find(']', openBracketPos);
+		if (closeBracketPos != std::string::npos) {
+			// Extract the coordinate part
+			std::string coordPart = contentText.substr(openBracketPos, closeBracketPos - openBracketPos + 1);
+
+			// Check if it looks like valid coordinates
+			bool isValidCoord = true;
+			for (size_t i = 1; i < coordPart.length() - 1; i++) {
+				if (!isdigit(coordPart[i]) && coordPart[i] != ',' && coordPart[i] != ' ') {
+					isValidCoord = false;
+					break;
+				}
+			}
+
+			if (isValidCoord && coordPart.length() > 2) {
+				// Scale coordinates back to original image size
+				std::string scaledCoords = scaleCoordinatesInAnswer(coordPart, imageContext);
+
+				// Replace the original coordinates with scaled ones
+				contentText.replace(openBracketPos, closeBracketPos - openBracketPos + 1, scaledCoords);
+			}
+		}
+	}
+	return contentText;
+}
+
+std::string GUITaskProcessor::parseResultForVQA(const std::string& response, const ImageContext& imageContext) {
 	WriteLog(L"[parseResultForVQA] Processing response");
 	WriteLog(L"[parseResultForVQA] Response content: " + std::wstring(response.begin(), response.end()));
 
@@ -753,34 +2173,8 @@ std::string GUITaskProcessor::parseResultForVQA(const std::string& response) {
 					std::string contentText = contentWithBraces.substr(firstQuote, secondQuote - firstQuote);
 					WriteLog(L"[parseResultForVQA] Extracted content text: " + std::wstring(contentText.begin(), contentText.end()));
 					
-					// Check if the content text contains coordinates and scale them back to original image size
-					size_t openBracketPos = contentText.find('[');
-					if (openBracketPos != std::string::npos) {
-						size_t closeBracketPos = contentText.find(']', openBracketPos);
-						if (closeBracketPos != std::string::npos) {
-							// Extract the coordinate part
-							std::string coordPart = contentText.substr(openBracketPos, closeBracketPos - openBracketPos + 1);
-							
-							// Check if it looks like valid coordinates
-							bool isValidCoord = true;
-							for (size_t i = 1; i < coordPart.length() - 1; i++) {
-								if (!isdigit(coordPart[i]) && coordPart[i] != ',' && coordPart[i] != ' ') {
-									isValidCoord = false;
-									break;
-								}
-							}
-							
-							if (isValidCoord && coordPart.length() > 2) {
-								// Scale coordinates back to original image size
-								std::string scaledCoords = scaleCoordinatesInAnswer(coordPart);
-								
-								// Replace the original coordinates with scaled ones
-								contentText.replace(openBracketPos, closeBracketPos - openBracketPos + 1, scaledCoords);
-							}
-						}
-					}
-					
-					return contentText;
+					// Scale the coordinates in the content text back to original image size
+					return scaleBoxInText(contentText, imageContext);
 				}
 				else {
 					WriteLog(L"[parseResultForVQA] Could not find matching closing brace");
@@ -803,55 +2197,14 @@ std::string GUITaskProcessor::parseResultForVQA(const std::string& response) {
 	return response;
 }
 
-bool GUITaskProcessor::saveResults(const std::string& outputPath, const Json::Value& results) {
+bool GUITaskProcessor::saveResults(TaskKind kind, const Json::Value& results) {
+	const std::string outputPath = resultPathFor(kind);
 	std::wcout << L"[GUITaskProcessor] Saving results to: " <<
 		std::wstring(outputPath.begin(), outputPath.end()) << std::endl;
 	WriteLog(L"[GUITaskProcessor] Saving results to: " + std::wstring(outputPath.begin(), outputPath.end()));
 
-	// Determine the source file path based on the output path
-	std::string sourceFilePath;
-	if (outputPath.find("gui_grounding_result.json") != std::string::npos) {
-		sourceFilePath = "D:\\Git_ZPY\\IntentFlow\\test\\GUI_Grounding\\GUI_Grounding.json";
-	}
-	else if (outputPath.find("gui_referring_result.json") != std::string::npos) {
-		sourceFilePath = "D:\\Git_ZPY\\IntentFlow\\test\\GUI_Referring\\GUI_Referring.json";
-	}
-	else if (outputPath.find("gui_vqa_result.json") != std::string::npos) {
-		sourceFilePath = "D:\\Git_ZPY\\IntentFlow\\test\\GUI_VQA\\GUI_VQA.json";
-	}
-	else {
-		std::wcout << L"[GUITaskProcessor] Unknown output file type, using default save method" << std::endl;
-		WriteLog(L"[GUITaskProcessor] Unknown output file type, using default save method");
-		// Fallback to original method
-		std::ofstream outputFile(outputPath);
-		if (!outputFile.is_open()) {
-			std::wcout << L"[GUITaskProcessor] Failed to open output file: " <<
-				std::wstring(outputPath.begin(), outputPath.end()) << std::endl;
-			WriteLog(L"[GUITaskProcessor] Failed to open output file: " + std::wstring(outputPath.begin(), outputPath.end()));
-			return false;
-		}
-
-		for (const auto& result : results) {
-			Json::Value outputResult;
-			outputResult["image"] = result["image"];
-			outputResult["type"] = result["type"];
-			outputResult["question_id"] = result["question_id"];
-			outputResult["question"] = result["question"];
-			outputResult["answer"] = result["answer"];
-
-			Json::StreamWriterBuilder builder;
-			builder["indentation"] = "";
-			std::unique_ptr<Json::StreamWriter> writer(builder.newStreamWriter());
-			std::ostringstream oss;
-			writer->write(outputResult, &oss);
-			outputFile << oss.str() << std::endl;
-		}
-
-		outputFile.close();
-		std::wcout << L"[GUITaskProcessor] Saved " << results.size() << L" results" << std::endl;
-		WriteLog(L"[GUITaskProcessor] Saved " + std::to_wstring(results.size()) + L" results");
-		return true;
-	}
+	// Answers are written back into the task type's source file, which keeps its formatting
+	const std::string sourceFilePath = taskDataPath(kind);
 
 	WriteLog(L"[GUITaskProcessor] Source file path: " + std::wstring(sourceFilePath.begin(), sourceFilePath.end()));
 
@@ -949,37 +2302,24 @@ bool GUITaskProcessor::saveResults(const std::string& outputPath, const Json::Va
 }
 
 // Function to scale coordinates based on image resizing
-std::string scaleCoordinatesInQuestion(const std::string& question, const std::string& imagePath) {
+std::string scaleCoordinatesInQuestion(const std::string& question, const ImageContext& imageContext) {
 	// Convert question to wide string and back to UTF-8 to ensure proper encoding
 	std::wstring wideQuestion = QwenAPI::UTF8ToUnicode(question);
 	std::string utf8Question = QwenAPI::UnicodeToUTF8(wideQuestion);
 
 	WriteLog(L"[scaleCoordinatesInQuestion] Processing question: " + std::wstring(utf8Question.begin(), utf8Question.end()));
-	WriteLog(L"[scaleCoordinatesInQuestion] Image path: " + std::wstring(imagePath.begin(), imagePath.end()));
-
-	// Get image dimensions
-	std::pair<int, int> dimensions = getImageDimensions(imagePath);
-	int originalWidth = dimensions.first;
-	int originalHeight = dimensions.second;
+	WriteLog(L"[scaleCoordinatesInQuestion] Image path: " + std::wstring(imageContext.imagePath.begin(), imageContext.imagePath.end()));
 
-	if (originalWidth <= 0 || originalHeight <= 0) {
-		WriteLog(L"[scaleCoordinatesInQuestion] Failed to get image dimensions");
+	// Image size and scale factors come from the context prepared in processGUITask
+	if (!imageContext.scaled || !imageContext.transform.isValid()) {
+		WriteLog(L"[scaleCoordinatesInQuestion] Image was not scaled, keeping question as is");
 		return utf8Question;
 	}
 
 	WriteLog(L"[scaleCoordinatesInQuestion] Original image size: " +
-		std::to_wstring(originalWidth) + L"x" + std::to_wstring(originalHeight));
-
-	// Target dimensions (960x960) - same as in QwenAPI::scaleImage, not maintaining aspect ratio
-	const int targetWidth = 960;
-	const int targetHeight = 960;
-
-	// Calculate scale factors for each dimension separately (not maintaining aspect ratio)
-	float scaleX = (float)targetWidth / originalWidth;
-	float scaleY = (float)targetHeight / originalHeight;
-
-	WriteLog(L"[scaleCoordinatesInQuestion] Scale factors - X: " + std::to_wstring(scaleX) +
-		L", Y: " + std::to_wstring(scaleY));
+		std::to_wstring(imageContext.transform.originalWidth) + L"x" + std::to_wstring(imageContext.transform.originalHeight));
+	WriteLog(L"[scaleCoordinatesInQuestion] Scale factors - X: " + std::to_wstring(imageContext.transform.scaleX()) +
+		L", Y: " + std::to_wstring(imageContext.transform.scaleY()));
 
 	// Find coordinate pattern in question like ([x1,y1,x2,y2]) or ([x,y])
 	// Simple string parsing approach instead of regex
@@ -1026,13 +2366,13 @@ std::string scaleCoordinatesInQuestion(const std::string& question, const std::s
 
 					try {
 						int value = std::stoi(trimmedCoord);
-						// Scale X coordinates with scaleX and Y coordinates with scaleY
+						// Map X and Y coordinates through the forward transform
 						int scaledValue;
 						if (i % 2 == 0) { // X coordinate (0, 2, ...)
-							scaledValue = static_cast<int>(value * scaleX);
+							scaledValue = imageContext.toTargetX(value);
 						}
 						else { // Y coordinate (1, 3, ...)
-							scaledValue = static_cast<int>(value * scaleY);
+							scaledValue = imageContext.toTargetY(value);
 						}
 						scaledCoords.push_back(scaledValue);
 						WriteLog(L"[scaleCoordinatesInQuestion] Original: " + std::wstring(trimmedCoord.begin(), trimmedCoord.end()) +
@@ -1,10 +1,16 @@
 #pragma once
 #include "framework.h"
 #include "QwenAPI.h"
+#include "TaskTraits.h"
 #include <string>
 #include <vector>
 #include <json/json.h>
 #include <memory>
+#include <map>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
 
 // String conversion function declarations
 std::wstring UTF8ToUnicode(const std::string& str);
@@ -14,6 +20,50 @@ void WriteLog(const std::wstring& message);
 
 class GUITaskProcessor {
 public:
+    // Effect of question packing over the runs so far
+    struct PackingStatistics {
+        int packedCalls = 0;            // Requests carrying several questions
+        int packedQuestions = 0;        // Questions sent in those requests
+        int fallbackQuestions = 0;      // ... whose answer could not be parsed and were asked again on their own
+        int callsSaved = 0;             // Against one call per question
+        int64_t imageTokensSaved = 0;   // Estimated image tokens of the calls saved
+    };
+
+    // Referring questions sent as a context crop around their box instead of the whole screen
+    struct ReferringCropOptions {
+        bool enabled = false;
+        double margin = 1.0;        // Context added on each side of the box, in multiples of the box size
+        int minContext = 320;       // Smallest crop side, in original pixels
+        int targetSize = 448;       // Long side of the crop on the canvas (crops are never upscaled)
+        bool outline = true;        // Draw the referred box on the crop
+    };
+
+    // Coarse-to-fine grounding: a low-resolution full screen gives a coarse box, then a high-resolution
+    // crop around it gives the final one, mapped back to the original screenshot through the crop
+    struct TwoPassOptions {
+        bool enabled = false;
+        int coarseSize = 512;       // Caps the long side of the first-pass canvas
+        double margin = 1.5;        // Context added on each side of the coarse box, in multiples of its size
+        int minContext = 384;       // Smallest crop side, in original pixels
+        int fineSize = 1024;        // Long side of the crop on the canvas (crops are never upscaled)
+    };
+
+    // Second passes over the runs so far
+    struct TwoPassStatistics {
+        int refined = 0;            // Answers replaced by the second pass
+        int coarseOnly = 0;         // ... kept from the first pass (no box, or the refinement failed)
+        uint64_t fineBytes = 0;     // Base64 payload bytes of the crops
+    };
+
+    // Screenshots much longer than wide (or wider than long) are split into overlapping tiles along the
+    // long side instead of being squeezed onto one canvas
+    struct TilingOptions {
+        bool enabled = false;
+        double aspectThreshold = 2.5;   // Long side / short side above which a screenshot is tiled (phones are ~2.2)
+        double overlap = 0.2;           // Share of a tile's length shared with the next tile
+        int tileSize = 960;             // Long side of each tile on the canvas (tiles are never upscaled)
+    };
+
     // Constructor
     GUITaskProcessor();
     
@@ -28,39 +78,251 @@ public:
     
     // Set API key
     void setApiKey(const std::string& apiKey);
+
+    // Model and sampling parameters sent with every request (default: qwen-vl-max, max_tokens 1024)
+    void setModel(const std::string& model, const QwenAPI::GenerationParameters& generation = QwenAPI::GenerationParameters());
+
+    // Requests in flight at once on the asynchronous path (tiles, benchmarks; default 8)
+    void setMaxInFlight(int maxInFlight);
+
+    // Resize kernel used when preparing images for a task type (default: ImagePreprocessOptions::kernel)
+    void setResizeKernel(const std::string& taskType, ResizeKernel kernel);
+
+    // Source decode for a task type (default: ImagePreprocessOptions::decodeMode, full resolution); Reduced
+    // decodes large JPEG sources at 1/2, 1/4 or 1/8 scale, which changes the payload
+    void setDecodeMode(const std::string& taskType, DecodeMode decodeMode);
+
+    // Canvas geometry for a task type (default: stretch to 960x960); prompts and coordinate mapping follow it
+    void setResizePolicy(const std::string& taskType, const ResizePolicy& policy);
+
+    // Per-image size for a task type from the screenshot's UI density (off by default); scales the task
+    // type's resize policy
+    void setAdaptiveResolution(const std::string& taskType, const AdaptiveResolution& adaptive);
+
+    // Ask up to maxQuestionsPerCall grounding or VQA questions about the same image in one request
+    // (0 or 1 = one question per call, the default). Answers that cannot be split out of the packed
+    // reply are asked again with a single-question call.
+    void setQuestionPacking(int maxQuestionsPerCall);
+    PackingStatistics getPackingStatistics() const;
+
+    // Run the grounding test set with the fixed policy and with adaptive resolution: payload bytes, image
+    // tokens and accuracy
+    bool benchmarkAdaptiveResolution(const AdaptiveResolution& adaptive, size_t maxTasks = 50);
+
+    // Two-pass mode for a task type whose answers carry a box (gui_grounding, advanced_vqa; off by default).
+    // Questions of such a type are not packed.
+    void setTwoPassGrounding(const std::string& taskType, const TwoPassOptions& twoPass);
+    TwoPassStatistics getTwoPassStatistics() const;
+
+    // Run the grounding test set single-pass and two-pass: accuracy, mean latency per question and
+    // total payload bytes of both
+    bool benchmarkTwoPassGrounding(const TwoPassOptions& twoPass, size_t maxTasks = 50);
+
+    // Tiling mode for gui_grounding (off by default): one request per tile, all in flight at once, with the
+    // boxes merged back into screenshot coordinates
+    void setTiling(const TilingOptions& tiling);
+
+    // Run the grounding questions about elongated screenshots in the test set on the whole screen and tiled:
+    // accuracy, mean latency per question and payload bytes
+    bool benchmarkTiling(const TilingOptions& tiling, size_t maxTasks = 50);
+
+    // Send the grounding test set once per in-flight window, the same prepared request bodies each time:
+    // wall time, requests per second and speedup over the first window, plus rate-limited replies
+    bool benchmarkInFlightWindows(const std::vector<int>& windows, size_t maxTasks = 50);
+
+    // Crop mode for gui_referring (off by default)
+    void setReferringCrop(const ReferringCropOptions& crop);
+
+    // Run the referring test set with the whole screen and with the crop: payload bytes, image tokens and
+    // accuracy against a "ground_truth" description when present (agreement with the full-screen answers otherwise)
+    bool benchmarkReferringCrop(const ReferringCropOptions& crop, size_t maxTasks = 50);
+
+    // Run the grounding test set once per kernel: resize time/fidelity plus grounding accuracy.
+    // Accuracy is measured against a "ground_truth" box in the task data when present, and as
+    // agreement with the first kernel's answers otherwise.
+    bool benchmarkResizeKernels(const std::vector<ResizeKernel>& kernels, size_t maxTasks = 50);
+
+    // Run the grounding test set once per byte budget (0 = fixed JPEG quality 90 baseline) and report
+    // payload bytes saved against grounding accuracy
+    bool benchmarkByteBudgets(const std::vector<int>& byteBudgets, size_t maxTasks = 50);
+
+    // Offline benchmarks of the image pipeline on the grounding test set images, and on the raw screencap
+    // dumps in test\raw when there are any (no requests), results in the log; run by "IntentFlow.exe
+    // /benchmark". False when a check fails, e.g. a header probe that disagrees with a full decode.
+    bool benchmarkImagePipeline(size_t maxTasks = 50);
     
 private:
+    // Outcome of one pass over the grounding test set with a given set of preprocessing options
+    struct GroundingPass {
+        std::vector<std::string> answers;
+        int answered = 0;
+        int withTruth = 0;
+        int hits = 0;               // Predicted box center inside the "ground_truth" box
+        int agreed = 0;             // Predicted box center inside the baseline pass's box
+        uint64_t payloadBytes = 0;  // Base64 payload bytes sent
+        int64_t imageTokens = 0;    // Estimated image tokens of those payloads
+        double elapsedMs = 0.0;     // Preparation and requests, all questions
+    };
+
+    // Loads up to maxTasks tasks of a type and their image paths
+    bool loadBenchmarkTasks(TaskKind kind, size_t maxTasks, Json::Value& tasks, std::vector<std::string>& imagePaths);
+    GroundingPass runGroundingPass(const ImagePreprocessOptions& options, const Json::Value& tasks,
+        const std::vector<std::string>& imagePaths, const GroundingPass* baseline, const TilingOptions* tiling = nullptr);
+
+    // One task file of a run; answers are written back into tasks, which keeps the source order
+    struct TaskBatch {
+        TaskKind kind = TaskKind::Grounding;
+        std::string imageBasePath;
+        Json::Value tasks;
+    };
+
+    // Tasks, as (batch, index) pairs, that share one prepared image payload
+    struct ImageGroup {
+        std::string imagePath;
+        ImagePreprocessOptions options;
+        std::vector<std::pair<size_t, Json::ArrayIndex>> tasks;
+    };
+
+    // Groups tasks by screenshot and preprocessing options, within and across batches, in order of first use
+    std::vector<ImageGroup> groupTasksByImage(const std::vector<TaskBatch>& batches) const;
+
+    // Prepares each distinct image once on the preprocessing pool and submits all of its questions, keeping about
+    // two request windows of questions pending. Each batch is saved as soon as its last task is answered, and
+    // every one is before this returns; false if a result file could not be written.
+    bool runTaskBatches(std::vector<TaskBatch>& batches);
+
     // Data loading functions
     bool loadTaskData(const std::string& filePath, Json::Value& root);
     bool parseJsonLines(const std::string& content, Json::Value& root);
     
     // Task processing functions
-    bool processGUITasks(const std::string& taskType, 
+    bool processGUITasks(TaskKind kind,
                         const std::string& imagePath, 
                         const std::string& jsonDataPath,
                         Json::Value& tasks);
     
-    std::string processGUITask(const std::string& taskType,
-                              const std::string& imagePath,
+    // Tasks are asked through the QwenAPI request engine without blocking: done receives the answer (empty when
+    // there is none) on a transport thread, or right away when nothing could be sent. imageContext is prepared
+    // ahead of time on the QwenAPI preprocessing pool and kept alive until done has run. The TaskKind overload
+    // picks the instantiation for a task whose type is only known at run time.
+    typedef std::shared_ptr<const ImageContext> SharedImageContext;
+    typedef std::function<void(const std::string& answer)> AnswerCallback;
+    void submitGUITask(TaskKind kind,
+                       SharedImageContext imageContext,
+                       const std::string& question,
+                       const std::string& questionId,
+                       AnswerCallback done);
+    template <TaskKind Kind>
+    void submitGUITask(SharedImageContext imageContext,
+                       const std::string& question,
+                       const std::string& questionId,
+                       AnswerCallback done);
+
+    // Blocking form for the benchmarks: submits, then runs follow-up work until the answer is in
+    template <TaskKind Kind>
+    std::string processGUITask(const ImageContext& imageContext,
                               const std::string& question,
                               const std::string& questionId);
     
-    // Result saving functions
-    bool saveResults(const std::string& outputPath, const Json::Value& results);
+    // One request for several questions of a packable task type about imageContext; an empty answer
+    // means the item could not be parsed from the reply
+    typedef std::function<void(const std::vector<std::string>& answers)> PackedAnswerCallback;
+    template <TaskKind Kind>
+    void submitPackedTasks(SharedImageContext imageContext,
+                           const std::vector<std::string>& questions,
+                           const std::vector<std::string>& questionIds,
+                           PackedAnswerCallback done);
+    void logPackingStatistics() const;
+
+    // Second pass of two-pass mode: asks the question again on a crop around the box in coarseAnswer and
+    // passes on the refined answer, or coarseAnswer when there is nothing to refine. The crop is prepared
+    // from a follow-up, as that can wait for a preprocessing slot.
+    template <TaskKind Kind>
+    void submitRefinement(SharedImageContext coarseContext, const std::string& question,
+                          const std::string& questionId, const std::string& coarseAnswer, const TwoPassOptions& twoPass,
+                          AnswerCallback done);
+    const TwoPassOptions* twoPassFor(TaskKind kind) const;
+
+    // Options for each tile of a screenshot; false when it is not elongated enough to tile
+    bool tileOptionsFor(const std::string& imagePath, const TilingOptions& tiling,
+                        std::vector<ImagePreprocessOptions>& tileOptions) const;
+
+    // Asks a grounding question on every tile concurrently and merges the boxes, dropping the duplicates
+    // found in the overlaps; the blocking form is for the benchmarks
+    void submitTiledTask(std::shared_ptr<const std::vector<ImageContext>> tiles, const std::string& question,
+                         const std::string& questionId, AnswerCallback done);
+    std::string processTiledTask(const std::vector<ImageContext>& tiles, const std::string& question,
+                                 const std::string& questionId);
+    std::string mergeTileAnswers(const std::vector<ImageContext>& tiles, const std::vector<std::string>& answers,
+                                 const std::string& questionId);
+
+    // Work a transport callback must not do itself (it may block: preparing a crop, saving a result file) is
+    // posted here and run by the thread waiting in runFollowUpsUntil, until finished() holds with nothing
+    // left to run. finished() is called under taskLoopMutex_, which also guards what it reads.
+    void postFollowUp(std::function<void()> work);
+    void runFollowUpsUntil(const std::function<bool()>& finished);
+
+    // Preprocessing options for a task type as configured (kernel, policy, adaptive sizing); crops and tiles
+    // start from these
+    ImagePreprocessOptions baseOptionsFor(TaskKind kind) const;
+    // Options for the whole screenshot: the base options, capped to the coarse budget in two-pass mode
+    ImagePreprocessOptions preprocessOptionsFor(TaskKind kind) const;
+
+    // Resolves a task type name from the public interface; logs and returns false for an unknown one
+    static bool knownTaskType(const std::string& taskType, TaskKind& kind);
+
+    // Clamps overlap to [0, 0.9] (an overlap near 1 would step one pixel per tile); logs and returns false
+    // for an aspect threshold below 1, which would tile every screenshot
+    static bool validTiling(TilingOptions& tiling);
+
+    // Options for a crop around the box in a referring question; false when the question has no box
+    // or the image size cannot be read
+    bool referringCropOptionsFor(const std::string& imagePath, const std::string& question,
+                                 const ReferringCropOptions& crop, ImagePreprocessOptions& options) const;
+
+    // Test data and result locations
+    static std::string taskBasePath(TaskKind kind);
+    static std::string taskDataPath(TaskKind kind);
+    static std::string resultPathFor(TaskKind kind);
+    bool saveResults(TaskKind kind, const Json::Value& results);
     
-    // Prompt building functions
-    std::string buildPromptForGrounding(const std::string& question);
-    std::string buildPromptForReferring(const std::string& question);
-    std::string buildPromptForVQA(const std::string& question);
+    // Prompt building functions, from the task type's fixed prompt text in TaskTraits
+    template <TaskKind Kind>
+    std::string buildPrompt(const std::string& question, const ImageContext& imageContext);
+    template <TaskKind Kind>
+    std::string buildPackedPrompt(const std::vector<std::string>& questions, const ImageContext& imageContext);
     
-    // Result parsing functions
-    std::string parseResultForGrounding(const std::string& response);
+    // Result parsing functions; parseResult is specialized per task type
+    template <TaskKind Kind>
+    std::string parseResult(const std::string& response, const ImageContext& imageContext);
+    std::string parseResultForGrounding(const std::string& response, const ImageContext& imageContext);
     std::string parseResultForReferring(const std::string& response);
-    std::string parseResultForVQA(const std::string& response);
+    std::string parseResultForVQA(const std::string& response, const ImageContext& imageContext);
+
+    // Maps the first [x1,y1,x2,y2] box in an answer text back to original image coordinates
+    std::string scaleBoxInText(const std::string& text, const ImageContext& imageContext);
     
-    // Function to scale coordinates from 960x960 back to original image size
-    std::string scaleCoordinatesInAnswer(const std::string& coordinates);
+    // Function to scale coordinates from the model canvas back to original image size
+    std::string scaleCoordinatesInAnswer(const std::string& coordinates, const ImageContext& imageContext);
     
     // Qwen API instance
     QwenAPI qwenAPI_;
+
+    // Per task type resize kernel overrides
+    std::map<TaskKind, ResizeKernel> resizeKernels_;
+    std::map<TaskKind, DecodeMode> decodeModes_;
+    std::map<TaskKind, ResizePolicy> resizePolicies_;
+    std::map<TaskKind, AdaptiveResolution> adaptiveResolutions_;
+
+    int questionsPerCall_ = 0;
+    ReferringCropOptions referringCrop_;
+    TilingOptions tiling_;
+    std::map<TaskKind, TwoPassOptions> twoPass_;
+    PackingStatistics packingStats_;
+    TwoPassStatistics twoPassStats_;
+    mutable std::mutex statsMutex_;     // Both statistics are updated from transport threads
+
+    std::mutex taskLoopMutex_;
+    std::condition_variable taskLoopChanged_;
+    std::deque<std::function<void()>> followUps_;
 };
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "pch.h"
+#include "HttpConnectionPool.h"
+#include <iostream>
+#include <algorithm>
+
+HttpConnectionPool::Lease::Lease(HttpConnectionPool* pool, std::unique_ptr<Connection> connection)
+	: pool_(pool), connection_(std::move(connection)) {
+}
+
+HttpConnectionPool::Lease::~Lease() {
+	release();
+}
+
+HttpConnectionPool::Lease::Lease(Lease&& other)
+	: pool_(other.pool_), connection_(std::move(other.connection_)), healthy_(other.healthy_) {
+	other.pool_ = nullptr;
+}
+
+HttpConnectionPool::Lease& HttpConnectionPool::Lease::operator=(Lease&& other) {
+	if (this != &other) {
+		release();
+		pool_ = other.pool_;
+		connection_ = std::move(other.connection_);
+		healthy_ = other.healthy_;
+		other.pool_ = nullptr;
+	}
+	return *this;
+}
+
+void HttpConnectionPool::Lease::release() {
+	if (pool_ && connection_) {
+		pool_->release(std::move(connection_), healthy_);
+	}
+	pool_ = nullptr;
+}
+
+bool HttpConnectionPool::Lease::recordRequest() {
+	if (!pool_ || !connection_) {
+		return false;
+	}
+	// A request reuses its connection unless WinHTTP had to connect for it
+	bool reused = !connection_->connected;
+	connection_->connected = false;
+	connection_->requests++;
+
+	std::lock_guard<std::mutex> lock(pool_->mutex_);
+	pool_->stats_.requests++;
+	if (reused) {
+		pool_->stats_.reused++;
+	}
+	return reused;
+}
+
+HttpConnectionPool::HttpConnectionPool(const std::wstring& host, INTERNET_PORT port, bool secure, const Options& options)
+	: host_(host), port_(port), secure_(secure), options_(options) {
+	options_.size = (std::max)(1, options_.size);
+}
+
+HttpConnectionPool::~HttpConnectionPool() {
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (auto& connection : idle_) {
+		close(*connection);
+	}
+	idle_.clear();
+}
+
+void CALLBACK HttpConnectionPool::statusCallback(HINTERNET, DWORD_PTR context, DWORD status, LPVOID, DWORD) {
+	if (status == WINHTTP_CALLBACK_STATUS_CONNECTED_TO_SERVER && context) {
+		reinterpret_cast<Connection*>(context)->connected = true;
+	}
+}
+
+std::unique_ptr<HttpConnectionPool::Connection> HttpConnectionPool::open() {
+	std::unique_ptr<Connection> connection(new Connection());
+	connection->session = WinHttpOpen(L"QwenAPI Client/1.0",
+		WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+		WINHTTP_NO_PROXY_NAME,
+		WINHTTP_NO_PROXY_BYPASS,
+		0);
+	if (!connection->session) {
+		std::wcout << L"[HttpConnectionPool] Failed to create WinHTTP session: " << GetLastError() << std::endl;
+		return nullptr;
+	}
+
+	// One socket per session: the next request on this connection waits for the socket the last one left
+	// open instead of WinHTTP opening another
+	DWORD maxConnections = 1;
+	WinHttpSetOption(connection->session, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &maxConnections, sizeof(maxConnections));
+	WinHttpSetStatusCallback(connection->session, &HttpConnectionPool::statusCallback,
+		WINHTTP_CALLBACK_FLAG_CONNECTED_TO_SERVER, 0);
+
+	connection->connect = WinHttpConnect(connection->session, host_.c_str(), port_, 0);
+	if (!connection->connect) {
+		std::wcout << L"[HttpConnectionPool] Failed to connect to " << host_ << L": " << GetLastError() << std::endl;
+		close(*connection);
+		return nullptr;
+	}
+	connection->lastUsed = std::chrono::steady_clock::now();
+	return connection;
+}
+
+void HttpConnectionPool::close(Connection& connection) {
+	if (connection.connect) WinHttpCloseHandle(connection.connect);
+	if (connection.session) WinHttpCloseHandle(connection.session);
+	connection.connect = nullptr;
+	connection.session = nullptr;
+}
+
+void HttpConnectionPool::closeExpiredLocked() {
+	auto cutoff = std::chrono::steady_clock::now() - std::chrono::seconds(options_.idleTimeoutSeconds);
+	// Least recently used first, so the expired ones are a prefix
+	auto firstLive = std::find_if(idle_.begin(), idle_.end(),
+		[cutoff](const std::unique_ptr<Connection>& connection) { return connection->lastUsed >= cutoff; });
+	for (auto it = idle_.begin(); it != firstLive; ++it) {
+		close(**it);
+		stats_.expired++;
+	}
+	idle_.erase(idle_.begin(), firstLive);
+}
+
+HttpConnectionPool::Lease HttpConnectionPool::acquire() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	closeExpiredLocked();
+	if (idle_.empty() && leased_ >= options_.size) {
+		stats_.waits++;
+		released_.wait(lock, [this]() { return !idle_.empty() || leased_ < options_.size; });
+		closeExpiredLocked();
+	}
+
+	if (!idle_.empty()) {
+		// Most recently used: the likeliest to still have its socket open
+		std::unique_ptr<Connection> connection = std::move(idle_.back());
+		idle_.pop_back();
+		leased_++;
+		return Lease(this, std::move(connection));
+	}
+
+	// Open outside the lock; the slot is taken so concurrent callers cannot overshoot the size
+	leased_++;
+	lock.unlock();
+	std::unique_ptr<Connection> connection = open();
+	lock.lock();
+	if (!connection) {
+		leased_--;
+		lock.unlock();
+		released_.notify_one();
+		return Lease();
+	}
+	stats_.opened++;
+	return Lease(this, std::move(connection));
+}
+
+void HttpConnectionPool::release(std::unique_ptr<Connection> connection, bool healthy) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		leased_--;
+		if (healthy) {
+			connection->lastUsed = std::chrono::steady_clock::now();
+			idle_.push_back(std::move(connection));
+		}
+		else {
+			close(*connection);
+			stats_.discarded++;
+		}
+	}
+	released_.notify_one();
+}
+
+HttpConnectionPool::Statistics HttpConnectionPool::getStatistics() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void HttpConnectionPool::logStatistics() const {
+	Statistics stats = getStatistics();
+	std::wcout << L"[HttpConnectionPool] " << host_ << L" requests: " << stats.requests << L", on a reused connection: " << stats.reused
+		<< L" (" << (stats.requests ? stats.reused * 100 / stats.requests : 0) << L"%), connections opened: " << stats.opened
+		<< L", expired: " << stats.expired << L", discarded: " << stats.discarded << L", waits for a free connection: "
+		<< stats.waits << std::endl;
+}
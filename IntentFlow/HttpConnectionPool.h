@@ -0,0 +1,107 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <windows.h>
+#include <winhttp.h>
+
+// Warm WinHTTP connections to one HTTP(S) endpoint, used by WinHttpTransport for each host it talks to.
+// A connection is a WinHTTP session limited to one socket per server, plus its connect handle. A request
+// that leases it goes out on the socket, and the TLS session, that the previous request left open, so only
+// the first request on a connection pays for DNS, TCP and the TLS handshake. Connections idle for longer
+// than the server is likely to keep the socket open are closed instead of reused.
+class HttpConnectionPool {
+public:
+    struct Options {
+        int size = 4;                   // Connections open at once; acquire() waits while all are leased
+        int idleTimeoutSeconds = 50;    // Idle connections older than this are closed (servers often drop them at 60 s)
+    };
+
+    struct Statistics {
+        uint64_t requests = 0;          // Requests sent over pooled connections
+        uint64_t reused = 0;            // ... that went out on a socket an earlier request had opened
+        uint64_t opened = 0;            // Connections created
+        uint64_t expired = 0;           // ... closed after sitting idle past the timeout
+        uint64_t discarded = 0;         // ... closed after a transport error
+        uint64_t waits = 0;             // acquire() calls that had to wait for a free connection
+    };
+
+    struct Connection {
+        HINTERNET session = nullptr;
+        HINTERNET connect = nullptr;
+        uint64_t requests = 0;
+        bool connected = false;         // Set by the status callback when WinHTTP opens a new socket
+        std::chrono::steady_clock::time_point lastUsed;
+    };
+
+    // A connection leased for one request; back in the pool when the lease ends
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(HttpConnectionPool* pool, std::unique_ptr<Connection> connection);
+        ~Lease();
+
+        Lease(Lease&& other);
+        Lease& operator=(Lease&& other);
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        bool valid() const { return connection_ != nullptr; }
+        HINTERNET connect() const { return connection_ ? connection_->connect : nullptr; }
+
+        // dwContext for WinHttpSendRequest, so the status callback can tell this connection opened a socket
+        DWORD_PTR context() const { return reinterpret_cast<DWORD_PTR>(connection_.get()); }
+
+        // After WinHttpReceiveResponse: counts the request and returns whether it went out on a socket an
+        // earlier request had opened
+        bool recordRequest();
+
+        // Close the connection instead of returning it (after a send/receive error)
+        void discard() { healthy_ = false; }
+
+    private:
+        void release();
+
+        HttpConnectionPool* pool_ = nullptr;
+        std::unique_ptr<Connection> connection_;
+        bool healthy_ = true;
+    };
+
+    HttpConnectionPool(const std::wstring& host, INTERNET_PORT port, bool secure, const Options& options);
+    ~HttpConnectionPool();
+
+    HttpConnectionPool(const HttpConnectionPool&) = delete;
+    HttpConnectionPool& operator=(const HttpConnectionPool&) = delete;
+
+    // Most recently used idle connection, a new one while below the pool size, or the next one released.
+    // Not valid if WinHTTP could not open a connection.
+    Lease acquire();
+
+    const Options& options() const { return options_; }
+    DWORD requestFlags() const { return secure_ ? WINHTTP_FLAG_SECURE : 0; }   // For WinHttpOpenRequest
+    Statistics getStatistics() const;
+    void logStatistics() const;
+
+private:
+    std::unique_ptr<Connection> open();
+    static void close(Connection& connection);
+    static void CALLBACK statusCallback(HINTERNET handle, DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLength);
+    void release(std::unique_ptr<Connection> connection, bool healthy);
+    void closeExpiredLocked();
+
+    std::wstring host_;
+    INTERNET_PORT port_;
+    bool secure_;
+    Options options_;
+
+    std::vector<std::unique_ptr<Connection>> idle_;    // Least recently used first
+    int leased_ = 0;
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    Statistics stats_;
+};
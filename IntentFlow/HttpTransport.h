@@ -0,0 +1,149 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <utility>
+#include <cstdint>
+#include <cstdlib>
+
+// Parts of an http:// or https:// URL
+struct HttpUrl {
+    bool secure = true;
+    std::string host;
+    int port = 443;
+    std::string path = "/";     // Path and query
+
+    // False for anything but http/https with a host
+    static bool parse(const std::string& url, HttpUrl& parsed) {
+        size_t schemeEnd = url.find("://");
+        if (schemeEnd == std::string::npos) {
+            return false;
+        }
+        std::string scheme = url.substr(0, schemeEnd);
+        if (scheme == "https") {
+            parsed.secure = true;
+            parsed.port = 443;
+        }
+        else if (scheme == "http") {
+            parsed.secure = false;
+            parsed.port = 80;
+        }
+        else {
+            return false;
+        }
+
+        size_t hostStart = schemeEnd + 3;
+        size_t pathStart = url.find('/', hostStart);
+        std::string authority = url.substr(hostStart, pathStart == std::string::npos ? std::string::npos : pathStart - hostStart);
+        parsed.path = pathStart == std::string::npos ? "/" : url.substr(pathStart);
+
+        size_t colon = authority.rfind(':');
+        if (colon != std::string::npos && authority.find(']', colon) == std::string::npos) {
+            int port = std::atoi(authority.c_str() + colon + 1);
+            if (port <= 0 || port > 65535) {
+                return false;
+            }
+            parsed.port = port;
+            authority.resize(colon);
+        }
+        parsed.host = authority;
+        return !parsed.host.empty();
+    }
+};
+
+struct HttpRequest {
+    std::string method = "POST";
+    std::string url;
+    std::vector<std::pair<std::string, std::string>> headers;
+    const std::string* body = nullptr;  // Sent as is, not copied; must outlive send()
+    int timeoutSeconds = 30;            // Connect and each send/receive, 0 = the backend's defaults
+};
+
+struct HttpResponse {
+    bool completed = false;         // A response arrived (any status); false on a transport error
+    int statusCode = 0;
+    std::string body;
+    std::string errorMessage;       // Set when not completed
+    bool connectionReused = false;  // Sent on a connection an earlier request had opened (no TCP/TLS handshake)
+};
+
+// HTTP client used by QwenAPI: the request engine sends through sendAsync, the blocking calls through send().
+// The platform backend (WinHTTP on Windows, libcurl elsewhere) keeps keep-alive connections per host for
+// each; another implementation can be injected, e.g. one that talks to a local mock server or replays
+// recorded responses.
+class HttpTransport {
+public:
+    struct Options {
+        int connections = 4;            // Connections kept per host (requests in flight at once)
+        int idleTimeoutSeconds = 50;    // Idle connections older than this are reopened rather than reused
+    };
+
+    struct Statistics {
+        uint64_t requests = 0;          // Requests that got a response
+        uint64_t reused = 0;            // ... sent on a connection an earlier request had opened
+        uint64_t opened = 0;            // Connections opened
+        uint64_t failed = 0;            // Requests that ended in a transport error
+        uint64_t waits = 0;             // Requests that had to wait for a free connection
+    };
+
+    // Receives the response of an asynchronous request, on a thread of the transport
+    typedef std::function<void(HttpResponse&)> Completion;
+
+    virtual ~HttpTransport() = default;
+
+    // Thread safe; blocks until the response has been read or the request failed
+    virtual HttpResponse send(const HttpRequest& request) = 0;
+
+    // Starts the request and returns at once; done runs when send() would have returned. request.body and
+    // the transport must stay alive until then. The backends multiplex all requests in flight on one event
+    // thread (curl) or the WinHTTP callback pool; this fallback, for simple transports such as test doubles,
+    // spends a thread per request.
+    virtual void sendAsync(const HttpRequest& request, Completion done) {
+        std::thread([this, request, done]() {
+            HttpResponse response = send(request);
+            done(response);
+        }).detach();
+    }
+
+    // Opens up to count connections to url's host (0 = Options::connections) ahead of the first request, on
+    // the asynchronous path the request engine sends through. Returns the connections warmed; 0 when the
+    // transport does not keep connections.
+    virtual int prewarm(const std::string& /*url*/, int /*count*/) { return 0; }
+
+    virtual Statistics getStatistics() const { return Statistics(); }
+    virtual void logStatistics() const {}
+
+    // The platform backend; defined in WinHttpTransport.cpp or CurlTransport.cpp, whichever is built
+    static std::shared_ptr<HttpTransport> createDefault(const Options& options);
+
+protected:
+    // count HEAD requests to url through sendAsync at once, so each opens its own connection in the cache
+    // later asynchronous requests are sent from; blocks until all have finished and returns those that
+    // got a response. Any status will do (usually 405): only the handshakes matter.
+    int prewarmAsync(const std::string& url, int count) {
+        HttpRequest request;
+        request.method = "HEAD";
+        request.url = url;
+        std::mutex mutex;
+        std::condition_variable finished;
+        int pending = count;
+        int warmed = 0;
+        for (int i = 0; i < count; ++i) {
+            sendAsync(request, [&](HttpResponse& response) {
+                // Notify under the lock: the waiting frame owns the condition variable
+                std::lock_guard<std::mutex> lock(mutex);
+                warmed += response.completed ? 1 : 0;
+                if (--pending == 0) {
+                    finished.notify_all();
+                }
+            });
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [&]() { return pending == 0; });
+        return warmed;
+    }
+};
@@ -0,0 +1,322 @@
+#include "pch.h"
+#include "ImageCache.h"
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <windows.h>
+
+namespace {
+	const char* kEntryExtension = ".b64";
+	const char* kEntryMagic = "IFC4";
+
+	uint64_t rotl64(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+	uint64_t fmix64(uint64_t k) {
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdull;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ull;
+		k ^= k >> 33;
+		return k;
+	}
+
+	std::string toHex(uint64_t value) {
+		std::ostringstream oss;
+		oss << std::hex << std::setw(16) << std::setfill('0') << value;
+		return oss.str();
+	}
+
+	uint64_t fileTimeToUInt64(const FILETIME& ft) {
+		return (static_cast<uint64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime;
+	}
+}
+
+ImageCache::ImageCache(const Config& config) : config_(config) {
+}
+
+void ImageCache::configure(const Config& config) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	config_ = config;
+	indexLoaded_ = false;
+	lru_.clear();
+	index_.clear();
+	stats_.bytesOnDisk = 0;
+	stats_.entries = 0;
+}
+
+// Word-at-a-time 64-bit hash; fast enough that hashing a screenshot costs far less than decoding it
+uint64_t ImageCache::hashBytes(const void* data, size_t size, uint64_t seed) {
+	const uint64_t kMul = 0x9E3779B97F4A7C15ull;
+	const unsigned char* p = static_cast<const unsigned char*>(data);
+	uint64_t h = seed ^ (static_cast<uint64_t>(size) * kMul);
+
+	size_t blocks = size / 8;
+	for (size_t i = 0; i < blocks; ++i) {
+		uint64_t k;
+		memcpy(&k, p + i * 8, 8);
+		k *= 0x87c37b91114253d5ull;
+		k = rotl64(k, 31);
+		k *= 0x4cf5ad432745937full;
+		h ^= k;
+		h = rotl64(h, 27) * 5 + 0x52dce729;
+	}
+
+	uint64_t tail = 0;
+	size_t remaining = size & 7;
+	if (remaining) {
+		memcpy(&tail, p + blocks * 8, remaining);
+		h ^= fmix64(tail);
+	}
+
+	return fmix64(h);
+}
+
+std::string ImageCache::makeKey(const std::string& fileBytes, const ImagePreprocessOptions& options) {
+	return makeKey(reinterpret_cast<const unsigned char*>(fileBytes.data()), fileBytes.size(), options);
+}
+
+std::string ImageCache::makeKey(const unsigned char* data, size_t size, const ImagePreprocessOptions& options) {
+	std::string params = options.toString();
+	return toHex(hashBytes(data, size)) +
+		toHex(hashBytes(params.data(), params.size(), 0x1F0C)); // Second half ties the entry to the parameters
+}
+
+std::string ImageCache::entryPath(const std::string& key) const {
+	return config_.directory + "\\" + key + kEntryExtension;
+}
+
+void ImageCache::loadIndexLocked() {
+	if (indexLoaded_) {
+		return;
+	}
+	indexLoaded_ = true;
+
+	if (!CreateDirectoryA(config_.directory.c_str(), nullptr) && GetLastError() != ERROR_ALREADY_EXISTS) {
+		std::wcout << L"[ImageCache] Failed to create cache directory, disabling cache" << std::endl;
+		config_.enabled = false;
+		return;
+	}
+
+	// Rebuild the LRU order from the entry files' last write times
+	struct Found {
+		std::string key;
+		uint64_t size;
+		uint64_t lastWrite;
+	};
+	std::vector<Found> found;
+
+	WIN32_FIND_DATAA findData;
+	std::string pattern = config_.directory + "\\*" + kEntryExtension;
+	HANDLE hFind = FindFirstFileA(pattern.c_str(), &findData);
+	if (hFind != INVALID_HANDLE_VALUE) {
+		do {
+			if (findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+			std::string fileName = findData.cFileName;
+			Found entry;
+			entry.key = fileName.substr(0, fileName.size() - strlen(kEntryExtension));
+			entry.size = (static_cast<uint64_t>(findData.nFileSizeHigh) << 32) | findData.nFileSizeLow;
+			entry.lastWrite = fileTimeToUInt64(findData.ftLastWriteTime);
+			found.push_back(entry);
+		} while (FindNextFileA(hFind, &findData));
+		FindClose(hFind);
+	}
+
+	std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.lastWrite > b.lastWrite; });
+	for (const auto& entry : found) {
+		lru_.push_back(entry.key);
+		IndexEntry indexEntry;
+		indexEntry.size = entry.size;
+		indexEntry.lruPos = std::prev(lru_.end());
+		index_[entry.key] = indexEntry;
+		stats_.bytesOnDisk += entry.size;
+	}
+	stats_.entries = index_.size();
+
+	std::wcout << L"[ImageCache] Loaded " << stats_.entries << L" entries, " << stats_.bytesOnDisk << L" bytes" << std::endl;
+	evictLocked();
+}
+
+void ImageCache::touchLocked(const std::string& key) {
+	auto it = index_.find(key);
+	if (it == index_.end()) {
+		return;
+	}
+	lru_.splice(lru_.begin(), lru_, it->second.lruPos);
+
+	// Persist the access so the LRU order survives restarts
+	HANDLE hFile = CreateFileA(entryPath(key).c_str(), FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE,
+		nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile != INVALID_HANDLE_VALUE) {
+		FILETIME now;
+		GetSystemTimeAsFileTime(&now);
+		SetFileTime(hFile, nullptr, nullptr, &now);
+		CloseHandle(hFile);
+	}
+}
+
+void ImageCache::evictLocked() {
+	while (!lru_.empty() && (stats_.bytesOnDisk > config_.maxBytes || index_.size() > config_.maxEntries)) {
+		std::string victim = lru_.back();
+		lru_.pop_back();
+
+		auto it = index_.find(victim);
+		if (it != index_.end()) {
+			stats_.bytesOnDisk -= (std::min)(stats_.bytesOnDisk, it->second.size);
+			index_.erase(it);
+		}
+		DeleteFileA(entryPath(victim).c_str());
+		stats_.evictions++;
+	}
+	stats_.entries = index_.size();
+}
+
+bool ImageCache::lookup(const std::string& key, ImageContext& context) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		loadIndexLocked();
+		if (!config_.enabled || index_.find(key) == index_.end()) {
+			stats_.misses++;
+			return false;
+		}
+	}
+
+	std::ifstream file(entryPath(key), std::ios::binary);
+	std::string magic;
+	int scaled = 0;
+	ImageContext cached;
+	if (file.is_open()) {
+		ImageTransform& t = cached.transform;
+		file >> magic >> scaled >> cached.mimeType >> t.originalWidth >> t.originalHeight >> t.canvasWidth >> t.canvasHeight
+			>> t.contentWidth >> t.contentHeight >> t.offsetX >> t.offsetY >> t.sourceX >> t.sourceY >> t.sourceWidth >> t.sourceHeight;
+		file.get(); // Header newline
+	}
+
+	bool valid = file.good() && magic == kEntryMagic && scaled == 1 && cached.transform.isValid() &&
+		cached.transform.canvasWidth > 0 && cached.transform.canvasHeight > 0;
+	if (valid) {
+		// Read the payload straight into a pre-sized string
+		std::streamoff payloadStart = file.tellg();
+		file.seekg(0, std::ios::end);
+		std::streamoff payloadSize = file.tellg() - payloadStart;
+		file.seekg(payloadStart, std::ios::beg);
+		valid = payloadSize > 0;
+		if (valid) {
+			cached.base64Payload.resize(static_cast<size_t>(payloadSize));
+			file.read(&cached.base64Payload[0], payloadSize);
+			valid = file.gcount() == payloadSize;
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (!valid) {
+		// Corrupt or vanished entry: drop it and treat as a miss
+		auto it = index_.find(key);
+		if (it != index_.end()) {
+			stats_.bytesOnDisk -= (std::min)(stats_.bytesOnDisk, it->second.size);
+			lru_.erase(it->second.lruPos);
+			index_.erase(it);
+			stats_.entries = index_.size();
+		}
+		DeleteFileA(entryPath(key).c_str());
+		stats_.misses++;
+		return false;
+	}
+
+	context.scaled = true;
+	context.transform = cached.transform;
+	context.mimeType = cached.mimeType;
+	context.base64Payload = std::move(cached.base64Payload);
+
+	touchLocked(key);
+	stats_.hits++;
+	return true;
+}
+
+void ImageCache::store(const std::string& key, const ImageContext& context) {
+	// Only resized payloads are cached; the raw-file fallback is not worth keeping
+	if (!context.scaled || context.base64Payload.empty()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		loadIndexLocked();
+		if (!config_.enabled || index_.find(key) != index_.end()) {
+			return;
+		}
+	}
+
+	// Write to a temporary file first so readers never see a partial entry
+	std::string finalPath = entryPath(key);
+	std::string tempPath = config_.directory + "\\" + key + ".tmp" + std::to_string(GetCurrentThreadId());
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) {
+			return;
+		}
+		const ImageTransform& t = context.transform;
+		file << kEntryMagic << " 1 " << context.mimeType << " " << t.originalWidth << " " << t.originalHeight << " " << t.canvasWidth << " " << t.canvasHeight
+			<< " " << t.contentWidth << " " << t.contentHeight << " " << t.offsetX << " " << t.offsetY
+			<< " " << t.sourceX << " " << t.sourceY << " " << t.sourceWidth << " " << t.sourceHeight << "\n";
+		file.write(context.base64Payload.data(), context.base64Payload.size());
+		if (!file.good()) {
+			file.close();
+			DeleteFileA(tempPath.c_str());
+			return;
+		}
+	}
+
+	if (!MoveFileExA(tempPath.c_str(), finalPath.c_str(), MOVEFILE_REPLACE_EXISTING)) {
+		DeleteFileA(tempPath.c_str());
+		return;
+	}
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	uint64_t size = context.base64Payload.size();
+	if (GetFileAttributesExA(finalPath.c_str(), GetFileExInfoStandard, &attributes)) {
+		size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (index_.find(key) != index_.end()) {
+		return; // Another thread stored the same entry meanwhile
+	}
+	lru_.push_front(key);
+	IndexEntry indexEntry;
+	indexEntry.size = size;
+	indexEntry.lruPos = lru_.begin();
+	index_[key] = indexEntry;
+	stats_.bytesOnDisk += size;
+	stats_.stores++;
+	evictLocked();
+}
+
+void ImageCache::recordTiming(bool hit, double elapsedMs) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	if (hit) {
+		stats_.hitMs += elapsedMs;
+	}
+	else {
+		stats_.missMs += elapsedMs;
+	}
+}
+
+ImageCache::Statistics ImageCache::getStatistics() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void ImageCache::logStatistics() const {
+	Statistics stats = getStatistics();
+	double avgHitMs = stats.hits ? stats.hitMs / stats.hits : 0.0;
+	double avgMissMs = stats.misses ? stats.missMs / stats.misses : 0.0;
+	std::wcout << L"[ImageCache] Hits: " << stats.hits << L", misses: " << stats.misses
+		<< L", stores: " << stats.stores << L", evictions: " << stats.evictions
+		<< L", entries: " << stats.entries << L", bytes on disk: " << stats.bytesOnDisk
+		<< L", avg hit: " << avgHitMs << L" ms, avg miss: " << avgMissMs << L" ms" << std::endl;
+}
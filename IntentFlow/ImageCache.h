@@ -0,0 +1,68 @@
+#pragma once
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "ImageContext.h"
+
+// Content-addressed on-disk cache of preprocessed image payloads.
+// Entries are keyed by a hash of the source file bytes plus the preprocessing options, so an
+// unchanged screenshot is resized and encoded only once across runs. The cache is size-bounded
+// and evicts least recently used entries.
+class ImageCache {
+public:
+    struct Config {
+        bool enabled = true;
+        std::string directory = "D:\\Git_ZPY\\IntentFlow\\image_cache";
+        uint64_t maxBytes = 512ull * 1024 * 1024;   // Total payload bytes kept on disk
+        size_t maxEntries = 4096;
+    };
+
+    struct Statistics {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t stores = 0;
+        uint64_t evictions = 0;
+        uint64_t bytesOnDisk = 0;
+        size_t entries = 0;
+        double hitMs = 0.0;         // Total time spent serving hits (hash + read)
+        double missMs = 0.0;        // Total time spent on misses (hash + decode + resize + encode)
+    };
+
+    explicit ImageCache(const Config& config = Config());
+
+    void configure(const Config& config);
+    bool isEnabled() const { return config_.enabled; }
+
+    // Cache key for the given source bytes and preprocessing options
+    static std::string makeKey(const std::string& fileBytes, const ImagePreprocessOptions& options);
+    static std::string makeKey(const unsigned char* data, size_t size, const ImagePreprocessOptions& options);
+    static uint64_t hashBytes(const void* data, size_t size, uint64_t seed = 0);
+
+    // On hit fills the size, scale factors and payload of the context
+    bool lookup(const std::string& key, ImageContext& context);
+    void store(const std::string& key, const ImageContext& context);
+    void recordTiming(bool hit, double elapsedMs);
+
+    Statistics getStatistics() const;
+    void logStatistics() const;
+
+private:
+    struct IndexEntry {
+        uint64_t size = 0;
+        std::list<std::string>::iterator lruPos;
+    };
+
+    Config config_;
+    mutable std::mutex mutex_;
+    bool indexLoaded_ = false;
+    std::list<std::string> lru_;                            // Front is most recently used
+    std::unordered_map<std::string, IndexEntry> index_;
+    Statistics stats_;
+
+    std::string entryPath(const std::string& key) const;
+    void loadIndexLocked();
+    void touchLocked(const std::string& key);
+    void evictLocked();
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <string>
+#include "ResizePolicy.h"
+
+// How the source image is decoded before resizing
+enum class DecodeMode {
+    Full,       // Always decode at full resolution
+    Reduced     // JPEG sources at least 2x the target are decoded at 1/2, 1/4 or 1/8 scale in the DCT domain
+};
+
+// Filter used to resize the screenshot to the target size.
+// Values match cv::InterpolationFlags for the kernels OpenCV provides.
+enum class ResizeKernel {
+    Nearest = 0,
+    Linear = 1,
+    Cubic = 2,
+    Area = 3,
+    Lanczos4 = 4,
+    AreaSIMD = 100  // Hand-vectorized area downscale for 8-bit RGB; other cases fall back to Area
+};
+
+// JPEG chroma subsampling. 4:2:0 is the libjpeg default; 4:4:4 keeps thin colored UI text sharp
+// at the cost of a larger payload.
+enum class ChromaSubsampling {
+    S444,
+    S422,
+    S420
+};
+
+// Preprocessing parameters that determine the encoded payload (also part of the image cache key)
+struct ImagePreprocessOptions {
+    ResizePolicy policy;            // Canvas geometry (stretch/letterbox/fit, target size)
+    ResizeKernel kernel = ResizeKernel::Lanczos4;   // Area/AreaSIMD are opt-in via setResizeKernel, see benchmarkResizeKernels
+    std::string codec = ".jpg";     // cv::imencode extension (fixed mode)
+    int quality = 90;               // JPEG/WebP quality; the upper bound of the search in budget mode
+    int byteBudget = 0;             // Base64 payload budget in bytes, 0 = fixed codec/quality (see ImageEncoder)
+    int minQuality = 40;            // Lowest quality the budget search may pick
+    ChromaSubsampling chroma = ChromaSubsampling::S420;    // JPEG only
+    DecodeMode decodeMode = DecodeMode::Full;     // Reduced is opt-in via setDecodeMode, see benchmarkDecodeModes
+
+    // Send only this region of the screenshot (original coordinates, empty = whole image)
+    ImageRegion crop;
+
+    // Draw the outline of this box (original coordinates, empty = none) on the image sent to the model
+    ImageRegion outline;
+
+    // Scale the policy's size per image by UI density (see ResizePolicy::adaptToDensity)
+    AdaptiveResolution adaptive;
+
+    // Compact textual form, e.g. "s960|i4|.jpg|q90|d0"
+    std::string toString() const {
+        return policy.toString() +
+            "|i" + std::to_string(static_cast<int>(kernel)) + "|" + codec + "|q" + std::to_string(quality) +
+            "|d" + std::to_string(static_cast<int>(decodeMode)) +
+            (byteBudget > 0 ? "|b" + std::to_string(byteBudget) + "-" + std::to_string(minQuality) : std::string()) +
+            (chroma != ChromaSubsampling::S420 ? "|c" + std::to_string(static_cast<int>(chroma)) : std::string()) +
+            (crop.isEmpty() ? std::string() : "|r" + regionToString(crop)) +
+            (outline.isEmpty() ? std::string() : "|o" + regionToString(outline)) +
+            (adaptive.enabled ? "|a" + adaptive.toString() : std::string());
+    }
+
+    static std::string regionToString(const ImageRegion& region) {
+        return std::to_string(region.x) + "," + std::to_string(region.y) + "," + std::to_string(region.width) + "," +
+            std::to_string(region.height);
+    }
+};
+
+// Per-task image state.
+// Built once per question by QwenAPI::prepareImageContext (a single decode) and passed down to
+// question rewriting, the API request and answer rescaling, instead of each stage re-reading the file.
+struct ImageContext {
+    std::string imagePath;
+
+    // True when the image was decoded and resized; false means the raw file bytes are sent
+    // and coordinates pass through unchanged
+    bool scaled = false;
+
+    // Placement on the canvas sent to the model (planned by ImagePreprocessOptions::policy)
+    ImageTransform transform;
+
+    // Base64 encoded payload, ready to go into the request body, and its data-URI MIME type
+    std::string base64Payload;
+    std::string mimeType = "image/jpeg";
+
+    // Pixel bounds sent along with the image (0 = not sent) and the image tokens the model will spend on it
+    int minPixels = 0;
+    int maxPixels = 0;
+    int estimatedTokens = 0;
+
+    // The box from ImagePreprocessOptions::outline is drawn on the image
+    bool outlined = false;
+
+    // Original image coordinates -> coordinates on the image sent to the model
+    int toTargetX(int x) const { return scaled ? transform.toCanvasX(x) : x; }
+    int toTargetY(int y) const { return scaled ? transform.toCanvasY(y) : y; }
+
+    // Model coordinates -> original image coordinates
+    int toOriginalX(int x) const { return scaled ? transform.toOriginalX(x) : x; }
+    int toOriginalY(int y) const { return scaled ? transform.toOriginalY(y) : y; }
+};
@@ -0,0 +1,269 @@
+#include "pch.h"
+#include "ImageEncoder.h"
+#include "ImagePreprocessor.h"
+#include "BufferPool.h"
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#ifdef INTENTFLOW_TURBOJPEG
+#include <turbojpeg.h>
+#pragma comment(lib, "turbojpeg.lib")
+#endif
+
+namespace {
+	const int kSampleBands = 4;
+	const int kQualityStep = 5;     // Step down when the full encode overshoots the sampled estimate
+
+#ifdef INTENTFLOW_TURBOJPEG
+	// Compressor handle and output buffer owned by one thread and reused for every encode on it
+	struct TurboCompressor {
+		tjhandle handle = nullptr;
+		std::vector<unsigned char> buffer;
+
+		TurboCompressor() : handle(tjInitCompress()) {}
+		~TurboCompressor() {
+			if (handle) {
+				tjDestroy(handle);
+			}
+		}
+	};
+
+	TurboCompressor& threadCompressor() {
+		thread_local TurboCompressor compressor;
+		return compressor;
+	}
+
+	int toTurboSubsampling(ChromaSubsampling chroma) {
+		switch (chroma) {
+		case ChromaSubsampling::S444: return TJSAMP_444;
+		case ChromaSubsampling::S422: return TJSAMP_422;
+		default: return TJSAMP_420;
+		}
+	}
+#endif
+}
+
+bool ImageEncoder::encode(const cv::Mat& image, const ImagePreprocessOptions& options, EncodedImage& encoded) {
+	// Reset without releasing the byte buffer, which may be a pooled one
+	encoded.bytes.clear();
+	encoded.codec.clear();
+	encoded.quality = 0;
+	encoded.attempts = 0;
+	if (image.empty()) {
+		return false;
+	}
+
+	if (options.byteBudget > 0) {
+		return encodeWithinBudget(image, options, encoded);
+	}
+
+	encoded.codec = options.codec;
+	encoded.quality = options.codec == ".png" ? 0 : options.quality;
+	encoded.attempts = 1;
+	return encodeWith(image, options.codec, options.quality, encoded.bytes, options.chroma);
+}
+
+bool ImageEncoder::encodeWith(const cv::Mat& image, const std::string& codec, int quality, std::vector<uchar>& bytes,
+	ChromaSubsampling chroma) {
+	if (codec == ".jpg" || codec == ".jpeg") {
+		return encodeJpeg(image, quality, chroma, bytes);
+	}
+
+	std::vector<int> params;
+	if (codec == ".webp") {
+		params.push_back(cv::IMWRITE_WEBP_QUALITY);
+		params.push_back(quality);
+	}
+	return cv::imencode(codec, image, bytes, params);
+}
+
+bool ImageEncoder::encodeJpeg(const cv::Mat& image, int quality, ChromaSubsampling chroma, std::vector<uchar>& bytes) {
+#ifdef INTENTFLOW_TURBOJPEG
+	if (image.type() == CV_8UC3) {
+		TurboCompressor& compressor = threadCompressor();
+		if (compressor.handle) {
+			int subsampling = toTurboSubsampling(chroma);
+			unsigned long capacity = tjBufSize(image.cols, image.rows, subsampling);
+			if (compressor.buffer.size() < capacity) {
+				compressor.buffer.resize(capacity);
+			}
+
+			// Compress straight from the BGR rows (the stride covers ROIs); NOREALLOC keeps our buffer
+			unsigned char* output = compressor.buffer.data();
+			unsigned long size = capacity;
+			if (tjCompress2(compressor.handle, image.data, image.cols, static_cast<int>(image.step), image.rows, TJPF_BGR,
+				&output, &size, subsampling, quality, TJFLAG_NOREALLOC) == 0) {
+				bytes.assign(output, output + size);
+				return true;
+			}
+			std::wcout << L"[ImageEncoder] TurboJPEG compression failed, falling back to cv::imencode" << std::endl;
+		}
+	}
+#endif
+	return encodeJpegOpenCV(image, quality, chroma, bytes);
+}
+
+bool ImageEncoder::encodeJpegOpenCV(const cv::Mat& image, int quality, ChromaSubsampling chroma, std::vector<uchar>& bytes) {
+	int samplingFactor = chroma == ChromaSubsampling::S444 ? cv::IMWRITE_JPEG_SAMPLING_FACTOR_444 :
+		chroma == ChromaSubsampling::S422 ? cv::IMWRITE_JPEG_SAMPLING_FACTOR_422 : cv::IMWRITE_JPEG_SAMPLING_FACTOR_420;
+	std::vector<int> params = { cv::IMWRITE_JPEG_QUALITY, quality, cv::IMWRITE_JPEG_SAMPLING_FACTOR, samplingFactor };
+	return cv::imencode(".jpg", image, bytes, params);
+}
+
+bool ImageEncoder::isTurboJpegAvailable() {
+#ifdef INTENTFLOW_TURBOJPEG
+	return threadCompressor().handle != nullptr;
+#else
+	return false;
+#endif
+}
+
+bool ImageEncoder::isCodecAvailable(const std::string& codec) {
+	static const bool webpAvailable = cv::haveImageWriter(".webp");
+	return codec == ".webp" ? webpAvailable : (codec == ".jpg" || codec == ".jpeg" || codec == ".png");
+}
+
+const char* ImageEncoder::mimeType(const std::string& codec) {
+	if (codec == ".png") return "image/png";
+	if (codec == ".webp") return "image/webp";
+	if (codec == ".bmp") return "image/bmp";
+	return "image/jpeg";
+}
+
+const cv::Mat& ImageEncoder::sampleBands(const cv::Mat& image, cv::Mat& sample) {
+	// Bands are multiples of 16 rows so JPEG/WebP blocks line up with the full-image encode
+	int bandRows = (image.rows / (kSampleBands * 4)) / 16 * 16;
+	if (bandRows < 16) {
+		return image;
+	}
+
+	cv::Mat bands[kSampleBands];
+	for (int i = 0; i < kSampleBands; ++i) {
+		int top = (image.rows - bandRows) * i / (kSampleBands - 1) / 16 * 16;
+		bands[i] = image.rowRange(top, top + bandRows);
+	}
+	cv::vconcat(bands, kSampleBands, sample);
+	return sample;
+}
+
+bool ImageEncoder::encodeWithinBudget(const cv::Mat& image, const ImagePreprocessOptions& options, EncodedImage& encoded) {
+	// The budget is on the base64 payload that goes on the wire
+	const size_t rawBudget = static_cast<size_t>(options.byteBudget) / 4 * 3;
+	// Candidates are encoded into this thread's pooled scratch buffer; the winner is swapped into encoded
+	BufferPool::Buffers& buffers = BufferPool::local();
+	const cv::Mat& sample = sampleBands(image, buffers.encodeSample);
+	const double sampleScale = (double)image.rows / sample.rows;
+	std::vector<uchar>& bytes = buffers.encodeScratch;
+
+	auto estimate = [&](const std::string& codec, int quality) -> double {
+		encoded.attempts++;
+		if (!encodeWith(sample, codec, quality, bytes, options.chroma)) {
+			return -1.0;
+		}
+		return bytes.size() * sampleScale;
+	};
+
+	// 1. Lossless: flat UI screenshots are often smaller as PNG than as high-quality JPEG
+	double pngEstimate = estimate(".png", 0);
+	if (pngEstimate >= 0.0 && pngEstimate <= rawBudget) {
+		encoded.attempts++;
+		if (encodeWith(image, ".png", 0, bytes) && bytes.size() <= rawBudget) {
+			encoded.bytes.swap(bytes);
+			encoded.codec = ".png";
+			encoded.quality = 0;
+			return true;
+		}
+	}
+
+	// 2. Lossy: highest quality in [minQuality, quality] whose sampled size fits
+	const std::string codec = isCodecAvailable(".webp") ? ".webp" : ".jpg";
+	int low = options.minQuality, high = options.quality, best = options.minQuality;
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		double size = estimate(codec, mid);
+		if (size >= 0.0 && size <= rawBudget) {
+			best = mid;
+			low = mid + 1;
+		}
+		else {
+			high = mid - 1;
+		}
+	}
+
+	// 3. Confirm on the full image, stepping down if the sample was optimistic
+	for (int quality = best; ; quality -= kQualityStep) {
+		if (quality < options.minQuality) {
+			quality = options.minQuality;
+		}
+		encoded.attempts++;
+		if (!encodeWith(image, codec, quality, bytes, options.chroma)) {
+			return false;
+		}
+		if (bytes.size() <= rawBudget || quality == options.minQuality) {
+			if (bytes.size() > rawBudget) {
+				std::wcout << L"[ImageEncoder] Byte budget " << options.byteBudget << L" not reachable, sending "
+					<< bytes.size() << L" bytes at minimum quality" << std::endl;
+			}
+			encoded.bytes.swap(bytes);
+			encoded.codec = codec;
+			encoded.quality = quality;
+			return true;
+		}
+	}
+}
+
+ImageEncoder::JpegBenchmarkResult ImageEncoder::benchmarkJpeg(const std::vector<std::string>& imagePaths,
+	const ImagePreprocessOptions& options, int iterations) {
+	JpegBenchmarkResult bench;
+	bench.turboAvailable = isTurboJpegAvailable();
+	iterations = (std::max)(iterations, 1);
+
+	std::vector<uchar> bytes;
+	double imencodeTotal = 0.0, turboTotal = 0.0;
+	for (const auto& imagePath : imagePaths) {
+		ImagePreprocessor::DecodeInfo info;
+		cv::Mat image = ImagePreprocessor::decode(imagePath, options, info);
+		if (image.empty()) {
+			continue;
+		}
+		cv::Mat resized = ImagePreprocessor::resize(image, options.policy.plan(info.originalWidth, info.originalHeight), options.kernel);
+		bench.imageCount++;
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; ++i) {
+			encodeJpegOpenCV(resized, options.quality, options.chroma, bytes);
+		}
+		auto t1 = std::chrono::high_resolution_clock::now();
+		imencodeTotal += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		bench.imencodeBytes += bytes.size();
+
+		if (bench.turboAvailable) {
+			t0 = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; ++i) {
+				encodeJpeg(resized, options.quality, options.chroma, bytes);
+			}
+			t1 = std::chrono::high_resolution_clock::now();
+			turboTotal += std::chrono::duration<double, std::milli>(t1 - t0).count();
+			bench.turboBytes += bytes.size();
+		}
+	}
+
+	if (bench.imageCount > 0) {
+		bench.imencodeMs = imencodeTotal / (bench.imageCount * iterations);
+		bench.turboMs = turboTotal / (bench.imageCount * iterations);
+	}
+
+	std::wcout << L"[ImageEncoder] JPEG benchmark over " << bench.imageCount << L" images - imencode: " << bench.imencodeMs
+		<< L" ms, " << bench.imencodeBytes << L" bytes";
+	if (bench.turboAvailable) {
+		std::wcout << L"; TurboJPEG: " << bench.turboMs << L" ms, " << bench.turboBytes << L" bytes";
+	}
+	else {
+		std::wcout << L"; TurboJPEG not built in (define INTENTFLOW_TURBOJPEG)";
+	}
+	std::wcout << std::endl;
+	return bench;
+}
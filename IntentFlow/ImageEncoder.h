@@ -0,0 +1,62 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <opencv2/core.hpp>
+#include "ImageContext.h"
+
+// Compressed image bytes ready for base64, with the codec that produced them
+struct EncodedImage {
+    std::vector<uchar> bytes;
+    std::string codec;          // cv::imencode extension: ".jpg", ".webp" or ".png"
+    int quality = 0;            // 0 for PNG
+    int attempts = 0;           // Encodes run, including size-estimation samples
+};
+
+// Encode stage of the image pipeline used by QwenAPI::scaleImage.
+// JPEG goes through libjpeg-turbo when built with INTENTFLOW_TURBOJPEG (turbojpeg.h/turbojpeg.lib on the
+// include and library paths): one compressor handle and output buffer per thread, compressing straight
+// from the BGR rows. Without it, cv::imencode is used.
+// With ImagePreprocessOptions::byteBudget set, picks codec and quality so the base64 payload fits the budget:
+// PNG first when the screenshot is flat enough to fit losslessly, otherwise the highest WebP (or JPEG)
+// quality that fits. Candidate sizes are estimated on a quarter-height sample of the image so the search
+// costs roughly one full encode.
+class ImageEncoder {
+public:
+    // Encode latency of cv::imencode vs the TurboJPEG path over the same resized images
+    struct JpegBenchmarkResult {
+        int imageCount = 0;
+        bool turboAvailable = false;
+        double imencodeMs = 0.0;    // Mean per encode
+        double turboMs = 0.0;
+        uint64_t imencodeBytes = 0; // Total output over one pass
+        uint64_t turboBytes = 0;
+    };
+
+    static bool encode(const cv::Mat& image, const ImagePreprocessOptions& options, EncodedImage& encoded);
+
+    // Single encode with a fixed codec and quality (ignored for PNG)
+    static bool encodeWith(const cv::Mat& image, const std::string& codec, int quality, std::vector<uchar>& bytes,
+        ChromaSubsampling chroma = ChromaSubsampling::S420);
+
+    // JPEG through the per-thread TurboJPEG compressor when available, cv::imencode otherwise
+    static bool encodeJpeg(const cv::Mat& image, int quality, ChromaSubsampling chroma, std::vector<uchar>& bytes);
+    static bool encodeJpegOpenCV(const cv::Mat& image, int quality, ChromaSubsampling chroma, std::vector<uchar>& bytes);
+    static bool isTurboJpegAvailable();
+
+    // Decode and resize each image with the options, then time both JPEG paths on the result
+    static JpegBenchmarkResult benchmarkJpeg(const std::vector<std::string>& imagePaths,
+        const ImagePreprocessOptions& options = ImagePreprocessOptions(), int iterations = 20);
+
+    static bool isCodecAvailable(const std::string& codec);
+
+    // Data-URI MIME type for a cv::imencode extension, e.g. ".webp" -> "image/webp"
+    static const char* mimeType(const std::string& codec);
+
+private:
+    static bool encodeWithinBudget(const cv::Mat& image, const ImagePreprocessOptions& options, EncodedImage& encoded);
+
+    // Evenly spaced horizontal bands covering about a quarter of the rows, copied into sample
+    // (or image itself when it is too short to sample)
+    static const cv::Mat& sampleBands(const cv::Mat& image, cv::Mat& sample);
+};
@@ -0,0 +1,523 @@
+#include "pch.h"
+#include "ImagePreprocessor.h"
+#include "ImageProbe.h"
+#include "RawFramebuffer.h"
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define IMAGEPREPROCESSOR_SSE2 1
+#endif
+
+namespace {
+	// Source taps of every destination index along one axis, with the cv::INTER_AREA weights
+	struct AreaTaps {
+		std::vector<int> offsets;       // First tap of each destination index (dstSize + 1 entries)
+		std::vector<int> indices;       // Source index of each tap
+		std::vector<float> weights;     // Weight of each tap; the taps of one destination index sum to 1
+	};
+
+	AreaTaps computeAreaTaps(int srcSize, int dstSize) {
+		AreaTaps taps;
+		const double scale = (double)srcSize / dstSize;
+		taps.offsets.reserve(dstSize + 1);
+
+		for (int d = 0; d < dstSize; ++d) {
+			taps.offsets.push_back(static_cast<int>(taps.indices.size()));
+
+			double fs1 = d * scale;
+			double fs2 = fs1 + scale;
+			double cellWidth = (std::min)(scale, srcSize - fs1);
+			int s1 = cvCeil(fs1);
+			int s2 = (std::min)(cvFloor(fs2), srcSize - 1);
+			s1 = (std::min)(s1, s2);
+
+			// Partially covered first pixel, fully covered run, partially covered last pixel
+			if (s1 - fs1 > 1e-3) {
+				taps.indices.push_back(s1 - 1);
+				taps.weights.push_back(static_cast<float>((s1 - fs1) / cellWidth));
+			}
+			for (int s = s1; s < s2; ++s) {
+				taps.indices.push_back(s);
+				taps.weights.push_back(static_cast<float>(1.0 / cellWidth));
+			}
+			if (fs2 - s2 > 1e-3) {
+				taps.indices.push_back(s2);
+				taps.weights.push_back(static_cast<float>((std::min)((std::min)(fs2 - s2, 1.0), cellWidth) / cellWidth));
+			}
+		}
+		taps.offsets.push_back(static_cast<int>(taps.indices.size()));
+		return taps;
+	}
+
+	// Taps of the last geometry seen along one axis
+	struct CachedTaps {
+		int srcSize = 0;
+		int dstSize = 0;
+		AreaTaps taps;
+
+		const AreaTaps& get(int src, int dst) {
+			if (src != srcSize || dst != dstSize) {
+				taps = computeAreaTaps(src, dst);
+				srcSize = src;
+				dstSize = dst;
+			}
+			return taps;
+		}
+	};
+
+	// sum[i] += weight * row[i] over one 8-bit source row
+	void accumulateRow(const uchar* row, float weight, float* sum, int length) {
+		int i = 0;
+#ifdef IMAGEPREPROCESSOR_SSE2
+		const __m128i zero = _mm_setzero_si128();
+		const __m128 w = _mm_set1_ps(weight);
+		for (; i + 16 <= length; i += 16) {
+			__m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+			__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			__m128 f0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero));
+			__m128 f1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero));
+			__m128 f2 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero));
+			__m128 f3 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero));
+			_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(f0, w)));
+			_mm_storeu_ps(sum + i + 4, _mm_add_ps(_mm_loadu_ps(sum + i + 4), _mm_mul_ps(f1, w)));
+			_mm_storeu_ps(sum + i + 8, _mm_add_ps(_mm_loadu_ps(sum + i + 8), _mm_mul_ps(f2, w)));
+			_mm_storeu_ps(sum + i + 12, _mm_add_ps(_mm_loadu_ps(sum + i + 12), _mm_mul_ps(f3, w)));
+		}
+#endif
+		for (; i < length; ++i) {
+			sum[i] += weight * row[i];
+		}
+	}
+
+	// Horizontal pass: collapse the vertically accumulated row into destination pixels.
+	// sum must have one float of padding past the last pixel (the SSE path loads 4 floats per 3-channel pixel).
+	void collapseRow(const float* sum, const AreaTaps& xTaps, uchar* out, int dstWidth) {
+		for (int dx = 0; dx < dstWidth; ++dx) {
+			const int begin = xTaps.offsets[dx];
+			const int end = xTaps.offsets[dx + 1];
+#ifdef IMAGEPREPROCESSOR_SSE2
+			__m128 acc = _mm_setzero_ps();
+			for (int t = begin; t < end; ++t) {
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(sum + xTaps.indices[t] * 3), _mm_set1_ps(xTaps.weights[t])));
+			}
+			// Round to nearest like cv::saturate_cast, then saturate down to bytes
+			__m128i v = _mm_cvtps_epi32(acc);
+			v = _mm_packs_epi32(v, v);
+			v = _mm_packus_epi16(v, v);
+			int packed = _mm_cvtsi128_si32(v);
+			std::memcpy(out + dx * 3, &packed, 3);
+#else
+			float b = 0.0f, g = 0.0f, r = 0.0f;
+			for (int t = begin; t < end; ++t) {
+				const float* p = sum + xTaps.indices[t] * 3;
+				b += p[0] * xTaps.weights[t];
+				g += p[1] * xTaps.weights[t];
+				r += p[2] * xTaps.weights[t];
+			}
+			out[dx * 3] = cv::saturate_cast<uchar>(b);
+			out[dx * 3 + 1] = cv::saturate_cast<uchar>(g);
+			out[dx * 3 + 2] = cv::saturate_cast<uchar>(r);
+#endif
+		}
+	}
+
+	// The transform's source region on image, which may be a reduced decode of the original
+	cv::Mat sourceOf(const cv::Mat& image, const ImageTransform& transform) {
+		if (!transform.isCropped()) {
+			return image;
+		}
+		const double fx = (double)image.cols / transform.originalWidth;
+		const double fy = (double)image.rows / transform.originalHeight;
+		cv::Rect region((int)std::lround(transform.sourceX * fx), (int)std::lround(transform.sourceY * fy),
+			(std::max)(1, (int)std::lround(transform.sourceWidth * fx)), (std::max)(1, (int)std::lround(transform.sourceHeight * fy)));
+		region &= cv::Rect(0, 0, image.cols, image.rows);
+		return region.area() > 0 ? image(region) : image;
+	}
+}
+
+bool ImagePreprocessor::readFile(const std::string& imagePath, std::vector<uchar>& bytes) {
+	std::ifstream file(imagePath, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return false;
+	}
+	std::streamoff size = file.tellg();
+	if (size <= 0) {
+		return false;
+	}
+	// resize() keeps the capacity, so a pooled buffer only reallocates for a larger file
+	bytes.resize(static_cast<size_t>(size));
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(bytes.data()), size);
+	return file.gcount() == size;
+}
+
+cv::Mat ImagePreprocessor::decode(const std::string& imagePath, const ImagePreprocessOptions& options, DecodeInfo& info) {
+	std::vector<uchar> fileBytes;
+	cv::Mat image;
+	info = DecodeInfo();
+	if (readFile(imagePath, fileBytes)) {
+		decode(fileBytes, options, image, info);
+	}
+	return image;
+}
+
+bool ImagePreprocessor::decode(const std::vector<uchar>& fileBytes, const ImagePreprocessOptions& options, cv::Mat& image,
+	DecodeInfo& info) {
+	info = DecodeInfo();
+	// A Mat left wrapping an earlier dump points into bytes that may be gone; never decode into it
+	if (image.data && !image.u) {
+		image.release();
+	}
+	if (fileBytes.empty()) {
+		return false;
+	}
+
+	// Raw framebuffer: no decode at all, the pixels are used where they lie
+	RawFramebuffer::Header raw;
+	if (RawFramebuffer::parseHeader(fileBytes.data(), fileBytes.size(), raw)) {
+		info.originalWidth = raw.width;
+		info.originalHeight = raw.height;
+		if (raw.format == RawFramebuffer::PixelFormat::RGB_565) {
+			// Packed channels cannot be resized; unpack into the caller's Mat
+			cv::Mat packed;
+			RawFramebuffer::wrap(fileBytes, packed, raw);
+			cv::cvtColor(packed, image, cv::COLOR_BGR5652BGR);
+			return !image.empty();
+		}
+		RawFramebuffer::wrap(fileBytes, image, raw);
+		info.wrapped = true;
+		info.colorConversion = RawFramebuffer::toBGRConversion(raw.format);
+		return true;
+	}
+
+	int flags = cv::IMREAD_COLOR;
+	if (options.decodeMode == DecodeMode::Reduced) {
+		// The header tells us the full size without decoding, so the reduction can be chosen up front
+		ImageProbe::ProbeResult probed = ImageProbe::probe(fileBytes.data(), fileBytes.size());
+		if (probed.success && probed.format == ImageProbe::Format::JPEG) {
+			// A crop is resized at its own scale, so size the whole image at that scale. With an adaptive size
+			// the densest outcome is assumed, as the density is only known after decoding.
+			ImageTransform planned = options.policy.plan(probed.width, probed.height, options.crop);
+			if (options.adaptive.enabled && planned.isValid()) {
+				planned = options.policy.adaptToDensity(options.adaptive.denseDensity, options.adaptive, planned.sourceWidth,
+					planned.sourceHeight).plan(probed.width, probed.height, options.crop);
+			}
+			int neededWidth = (int)std::lround(probed.width * planned.scaleX());
+			int neededHeight = (int)std::lround(probed.height * planned.scaleY());
+			int factor = chooseReduceFactor(probed.width, probed.height, neededWidth, neededHeight);
+			if (factor > 1) {
+				flags = factor == 8 ? cv::IMREAD_REDUCED_COLOR_8 :
+					factor == 4 ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_2;
+				info.reduceFactor = factor;
+				info.originalWidth = probed.width;
+				info.originalHeight = probed.height;
+			}
+		}
+	}
+
+	// Decoding into the caller's Mat reuses its data when the size and type are unchanged
+	cv::imdecode(fileBytes, flags, &image);
+	if (image.empty()) {
+		return false;
+	}
+
+	if (info.reduceFactor > 1) {
+		// libjpeg rounds the scaled size up; anything else means the probe disagreed with the decoder
+		bool consistent = std::abs(image.cols * info.reduceFactor - info.originalWidth) < info.reduceFactor &&
+			std::abs(image.rows * info.reduceFactor - info.originalHeight) < info.reduceFactor;
+		if (!consistent) {
+			std::wcout << L"[ImagePreprocessor] Reduced decode size mismatch, decoding at full resolution" << std::endl;
+			info = DecodeInfo();
+			cv::imdecode(fileBytes, cv::IMREAD_COLOR, &image);
+			if (image.empty()) {
+				return false;
+			}
+		}
+	}
+
+	if (info.reduceFactor == 1) {
+		info.originalWidth = image.cols;
+		info.originalHeight = image.rows;
+	}
+	return true;
+}
+
+cv::Mat ImagePreprocessor::resize(const cv::Mat& image, const ImagePreprocessOptions& options) {
+	return resize(image, options.policy.plan(image.cols, image.rows), options.kernel);
+}
+
+cv::Mat ImagePreprocessor::resize(const cv::Mat& image, const ImageTransform& transform, ResizeKernel kernel) {
+	cv::Mat resizedImage, canvas;
+	return resize(image, transform, kernel, resizedImage, canvas);
+}
+
+cv::Mat& ImagePreprocessor::resize(const cv::Mat& image, const ImageTransform& transform, ResizeKernel kernel,
+	cv::Mat& resized, cv::Mat& canvas) {
+	// The transform may describe the full-resolution original while image is a reduced decode,
+	// so the source region is scaled to the decoded size; after that only the content size matters
+	cv::Mat source = sourceOf(image, transform);
+
+	if (kernel != ResizeKernel::AreaSIMD ||
+		!areaDownscale(source, resized, transform.contentWidth, transform.contentHeight)) {
+		int interpolation = kernel == ResizeKernel::AreaSIMD ? cv::INTER_AREA : static_cast<int>(kernel);
+		cv::resize(source, resized, cv::Size(transform.contentWidth, transform.contentHeight), 0, 0, interpolation);
+	}
+
+	if (!transform.isPadded()) {
+		return resized;
+	}
+
+	cv::copyMakeBorder(resized, canvas, transform.offsetY, transform.canvasHeight - transform.contentHeight - transform.offsetY,
+		transform.offsetX, transform.canvasWidth - transform.contentWidth - transform.offsetX, cv::BORDER_CONSTANT, cv::Scalar::all(0));
+	return canvas;
+}
+
+double ImagePreprocessor::edgeDensity(const cv::Mat& image, const ImageTransform& transform) {
+	cv::Mat source = sourceOf(image, transform);
+	if (source.empty()) {
+		return 0.0;
+	}
+
+	// Edges on a small grayscale thumbnail: text and icons produce many, flat backgrounds none
+	thread_local cv::Mat thumbnail, gray, edges;
+	const double scale = (std::min)(1.0, (double)kDensityThumbnailSize / (std::max)(source.cols, source.rows));
+	cv::resize(source, thumbnail, cv::Size((std::max)(1, (int)std::lround(source.cols * scale)),
+		(std::max)(1, (int)std::lround(source.rows * scale))), 0, 0, cv::INTER_AREA);
+	if (thumbnail.channels() == 3 || thumbnail.channels() == 4) {
+		// Channel order does not matter for edges, so raw RGBA dumps need no conversion first
+		cv::cvtColor(thumbnail, gray, thumbnail.channels() == 4 ? cv::COLOR_BGRA2GRAY : cv::COLOR_BGR2GRAY);
+	}
+	else {
+		gray = thumbnail;
+	}
+	cv::Canny(gray, edges, 50, 150);
+	return (double)cv::countNonZero(edges) / edges.total();
+}
+
+cv::Mat& ImagePreprocessor::finishColor(cv::Mat& image, const DecodeInfo& info, cv::Mat& converted) {
+	if (info.colorConversion < 0) {
+		return image;
+	}
+	cv::cvtColor(image, converted, info.colorConversion);
+	return converted;
+}
+
+void ImagePreprocessor::drawOutline(cv::Mat& image, const ImageTransform& transform, const ImageRegion& box) {
+	if (box.isEmpty() || image.empty()) {
+		return;
+	}
+	// Thick enough to survive JPEG at the canvas size, drawn just outside the box so its content stays untouched
+	const int thickness = (std::max)(2, (std::max)(image.cols, image.rows) / 240);
+	cv::Point topLeft(transform.toCanvasX(box.x) - thickness, transform.toCanvasY(box.y) - thickness);
+	cv::Point bottomRight(transform.toCanvasX(box.x + box.width) + thickness, transform.toCanvasY(box.y + box.height) + thickness);
+	cv::rectangle(image, topLeft, bottomRight, cv::Scalar(0, 0, 255), thickness);
+}
+
+bool ImagePreprocessor::areaDownscale(const cv::Mat& image, cv::Mat& resized, int targetWidth, int targetHeight) {
+	if (image.type() != CV_8UC3 || targetWidth <= 0 || targetHeight <= 0 ||
+		targetWidth > image.cols || targetHeight > image.rows) {
+		return false;
+	}
+
+	// Screenshots of one device repeat the same geometry, so the taps are kept per thread until it changes
+	thread_local CachedTaps xCache, yCache;
+	const AreaTaps& xTaps = xCache.get(image.cols, targetWidth);
+	const AreaTaps& yTaps = yCache.get(image.rows, targetHeight);
+	const int rowLength = image.cols * 3;
+	resized.create(targetHeight, targetWidth, CV_8UC3);
+
+	// Vertical pass into a float row (the bulk of the work, vectorized), then the horizontal pass per output row
+	cv::parallel_for_(cv::Range(0, targetHeight), [&](const cv::Range& range) {
+		thread_local std::vector<float> rowSum;
+		if (rowSum.size() < static_cast<size_t>(rowLength) + 1) {
+			rowSum.resize(rowLength + 1);
+		}
+		rowSum[rowLength] = 0.0f;
+		for (int dy = range.start; dy < range.end; ++dy) {
+			std::fill(rowSum.begin(), rowSum.begin() + rowLength, 0.0f);
+			for (int t = yTaps.offsets[dy]; t < yTaps.offsets[dy + 1]; ++t) {
+				accumulateRow(image.ptr<uchar>(yTaps.indices[t]), yTaps.weights[t], rowSum.data(), rowLength);
+			}
+			collapseRow(rowSum.data(), xTaps, resized.ptr<uchar>(dy), targetWidth);
+		}
+	});
+	return true;
+}
+
+const wchar_t* ImagePreprocessor::kernelName(ResizeKernel kernel) {
+	switch (kernel) {
+	case ResizeKernel::Nearest: return L"Nearest";
+	case ResizeKernel::Linear: return L"Linear";
+	case ResizeKernel::Cubic: return L"Cubic";
+	case ResizeKernel::Area: return L"Area";
+	case ResizeKernel::Lanczos4: return L"Lanczos4";
+	case ResizeKernel::AreaSIMD: return L"AreaSIMD";
+	}
+	return L"Unknown";
+}
+
+int ImagePreprocessor::chooseReduceFactor(int width, int height, int targetWidth, int targetHeight) {
+	for (int factor = 8; factor >= 2; factor /= 2) {
+		if (width / factor >= targetWidth && height / factor >= targetHeight) {
+			return factor;
+		}
+	}
+	return 1;
+}
+
+double ImagePreprocessor::computeSSIM(const cv::Mat& a, const cv::Mat& b) {
+	const double C1 = 6.5025, C2 = 58.5225;  // (0.01*255)^2, (0.03*255)^2
+
+	cv::Mat I1, I2;
+	a.convertTo(I1, CV_32F);
+	b.convertTo(I2, CV_32F);
+
+	cv::Mat I1_2 = I1.mul(I1);
+	cv::Mat I2_2 = I2.mul(I2);
+	cv::Mat I1_I2 = I1.mul(I2);
+
+	cv::Mat mu1, mu2;
+	cv::GaussianBlur(I1, mu1, cv::Size(11, 11), 1.5);
+	cv::GaussianBlur(I2, mu2, cv::Size(11, 11), 1.5);
+
+	cv::Mat mu1_2 = mu1.mul(mu1);
+	cv::Mat mu2_2 = mu2.mul(mu2);
+	cv::Mat mu1_mu2 = mu1.mul(mu2);
+
+	cv::Mat sigma1_2, sigma2_2, sigma12;
+	cv::GaussianBlur(I1_2, sigma1_2, cv::Size(11, 11), 1.5);
+	sigma1_2 -= mu1_2;
+	cv::GaussianBlur(I2_2, sigma2_2, cv::Size(11, 11), 1.5);
+	sigma2_2 -= mu2_2;
+	cv::GaussianBlur(I1_I2, sigma12, cv::Size(11, 11), 1.5);
+	sigma12 -= mu1_mu2;
+
+	cv::Mat t1 = 2 * mu1_mu2 + C1;
+	cv::Mat t2 = 2 * sigma12 + C2;
+	cv::Mat t3 = t1.mul(t2);
+
+	t1 = mu1_2 + mu2_2 + C1;
+	t2 = sigma1_2 + sigma2_2 + C2;
+	t1 = t1.mul(t2);
+
+	cv::Mat ssimMap;
+	cv::divide(t3, t1, ssimMap);
+	cv::Scalar channelMeans = cv::mean(ssimMap);
+
+	double sum = 0.0;
+	for (int c = 0; c < a.channels(); ++c) {
+		sum += channelMeans[c];
+	}
+	return sum / a.channels();
+}
+
+ImagePreprocessor::DecodeBenchmarkResult ImagePreprocessor::benchmarkDecodeModes(const std::vector<std::string>& imagePaths,
+	const ImagePreprocessOptions& options) {
+	DecodeBenchmarkResult bench;
+	ImagePreprocessOptions fullOptions = options;
+	fullOptions.decodeMode = DecodeMode::Full;
+	ImagePreprocessOptions reducedOptions = options;
+	reducedOptions.decodeMode = DecodeMode::Reduced;
+
+	double psnrSum = 0.0, ssimSum = 0.0;
+	for (const auto& imagePath : imagePaths) {
+		DecodeInfo fullInfo, reducedInfo;
+
+		auto t0 = std::chrono::high_resolution_clock::now();
+		cv::Mat fullImage = decode(imagePath, fullOptions, fullInfo);
+		cv::Mat fullResized = fullImage.empty() ? cv::Mat() : resize(fullImage, fullOptions);
+		auto t1 = std::chrono::high_resolution_clock::now();
+		cv::Mat reducedImage = decode(imagePath, reducedOptions, reducedInfo);
+		cv::Mat reducedResized = reducedImage.empty() ? cv::Mat() : resize(reducedImage, reducedOptions);
+		auto t2 = std::chrono::high_resolution_clock::now();
+
+		if (fullResized.empty() || reducedResized.empty()) {
+			continue;
+		}
+
+		bench.imageCount++;
+		bench.fullMs += std::chrono::duration<double, std::milli>(t1 - t0).count();
+		bench.reducedMs += std::chrono::duration<double, std::milli>(t2 - t1).count();
+
+		if (reducedInfo.reduceFactor > 1) {
+			bench.reducedCount++;
+			psnrSum += cv::PSNR(fullResized, reducedResized);
+			ssimSum += computeSSIM(fullResized, reducedResized);
+		}
+	}
+
+	if (bench.reducedCount > 0) {
+		bench.meanPSNR = psnrSum / bench.reducedCount;
+		bench.meanSSIM = ssimSum / bench.reducedCount;
+	}
+
+	std::wcout << L"[ImagePreprocessor] Decode benchmark over " << bench.imageCount << L" images ("
+		<< bench.reducedCount << L" reduced) - full: " << bench.fullMs << L" ms, reduced: " << bench.reducedMs
+		<< L" ms, PSNR: " << bench.meanPSNR << L" dB, SSIM: " << bench.meanSSIM << std::endl;
+	return bench;
+}
+
+std::vector<ImagePreprocessor::ResizeBenchmarkResult> ImagePreprocessor::benchmarkResizeKernels(const std::vector<std::string>& imagePaths,
+	const std::vector<ResizeKernel>& kernels, ResizeKernel reference, const ImagePreprocessOptions& options, int iterations) {
+	std::vector<ResizeBenchmarkResult> results(kernels.size());
+	std::vector<double> psnrSums(kernels.size(), 0.0), ssimSums(kernels.size(), 0.0);
+	for (size_t k = 0; k < kernels.size(); ++k) {
+		results[k].kernel = kernels[k];
+	}
+
+	ImagePreprocessOptions kernelOptions = options;
+	iterations = (std::max)(iterations, 1);
+	for (const auto& imagePath : imagePaths) {
+		// Decode once so only the resize is timed; every kernel sees the same input
+		DecodeInfo info;
+		cv::Mat image = decode(imagePath, options, info);
+		if (image.empty()) {
+			continue;
+		}
+
+		kernelOptions.kernel = reference;
+		cv::Mat referenceImage = resize(image, kernelOptions);
+
+		for (size_t k = 0; k < kernels.size(); ++k) {
+			kernelOptions.kernel = kernels[k];
+			cv::Mat resizedImage;
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < iterations; ++i) {
+				resizedImage = resize(image, kernelOptions);
+			}
+			results[k].resizeMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count() / iterations;
+			results[k].imageCount++;
+
+			cv::Mat difference;
+			cv::absdiff(resizedImage, referenceImage, difference);
+			double maxDiff = 0.0;
+			cv::minMaxLoc(difference.reshape(1), nullptr, &maxDiff);
+			results[k].maxAbsDiff = (std::max)(results[k].maxAbsDiff, static_cast<int>(maxDiff));
+			// Identical output has infinite PSNR; cap it so the mean stays meaningful
+			psnrSums[k] += maxDiff == 0.0 ? 100.0 : cv::PSNR(resizedImage, referenceImage);
+			ssimSums[k] += computeSSIM(resizedImage, referenceImage);
+		}
+	}
+
+	for (size_t k = 0; k < kernels.size(); ++k) {
+		ResizeBenchmarkResult& result = results[k];
+		if (result.imageCount > 0) {
+			result.meanPSNR = psnrSums[k] / result.imageCount;
+			result.meanSSIM = ssimSums[k] / result.imageCount;
+		}
+		std::wcout << L"[ImagePreprocessor] Resize " << kernelName(result.kernel) << L" over " << result.imageCount
+			<< L" images: " << result.resizeMs << L" ms, vs " << kernelName(reference) << L" PSNR: " << result.meanPSNR
+			<< L" dB, SSIM: " << result.meanSSIM << L", max diff: " << result.maxAbsDiff << std::endl;
+	}
+	return results;
+}
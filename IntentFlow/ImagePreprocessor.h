@@ -0,0 +1,92 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include "ImageContext.h"
+
+// Decode and resize stages of the image pipeline used by QwenAPI::scaleImage
+class ImagePreprocessor {
+public:
+    struct DecodeInfo {
+        int originalWidth = 0;      // Full-resolution size, even when a reduced decode was used
+        int originalHeight = 0;
+        int reduceFactor = 1;       // 1, 2, 4 or 8
+        bool wrapped = false;       // image points into the file bytes (raw framebuffer dump)
+        int colorConversion = -1;   // cv::cvtColor code still needed to get BGR (see finishColor), -1 = none
+    };
+
+    // Result of comparing the full and reduced decode paths over a set of images
+    struct DecodeBenchmarkResult {
+        int imageCount = 0;
+        int reducedCount = 0;       // Images where the reduced path actually used a reduced decode
+        double fullMs = 0.0;        // Total decode+resize time, full decode
+        double reducedMs = 0.0;     // Total decode+resize time, reduced decode
+        double meanPSNR = 0.0;      // Reduced output vs full output, over images that differ in path
+        double meanSSIM = 0.0;
+    };
+
+    // Resize time and output fidelity of one kernel over a set of images
+    struct ResizeBenchmarkResult {
+        ResizeKernel kernel = ResizeKernel::Area;
+        int imageCount = 0;
+        double resizeMs = 0.0;      // Total resize time (decode excluded)
+        double meanPSNR = 0.0;      // Against the reference kernel's output
+        double meanSSIM = 0.0;
+        int maxAbsDiff = 0;         // Largest per-channel difference from the reference output
+    };
+
+    // Read a whole file (ANSI path) into bytes, reusing its capacity
+    static bool readFile(const std::string& imagePath, std::vector<uchar>& bytes);
+
+    // Decode an image (ANSI path), picking a reduced-resolution JPEG decode when the options allow it
+    static cv::Mat decode(const std::string& imagePath, const ImagePreprocessOptions& options, DecodeInfo& info);
+
+    // Same, from the file's bytes. Decodes into image, reusing its data when the size and type match.
+    // A raw framebuffer dump is wrapped instead of decoded (see RawFramebuffer): image then shares the
+    // bytes and stays in the dump's channel order until finishColor.
+    static bool decode(const std::vector<uchar>& fileBytes, const ImagePreprocessOptions& options, cv::Mat& image,
+        DecodeInfo& info);
+
+    // Resize to the canvas planned by the options' policy for this image, with the selected kernel
+    static cv::Mat resize(const cv::Mat& image, const ImagePreprocessOptions& options);
+
+    // Resize to the transform's content size and pad to its canvas
+    static cv::Mat resize(const cv::Mat& image, const ImageTransform& transform, ResizeKernel kernel);
+
+    // Same, into caller-owned Mats (see BufferPool); returns whichever of resized or canvas holds the result
+    static cv::Mat& resize(const cv::Mat& image, const ImageTransform& transform, ResizeKernel kernel,
+        cv::Mat& resized, cv::Mat& canvas);
+
+    // Share of edge pixels in the transform's source region, measured on a kDensityThumbnailSize thumbnail
+    // (sparse settings screens land around 0.02, dense text feeds above 0.1)
+    static double edgeDensity(const cv::Mat& image, const ImageTransform& transform);
+    static const int kDensityThumbnailSize = 256;
+
+    // Applies the DecodeInfo's pending color conversion after the resize, where the image is smallest;
+    // returns image itself when there is none
+    static cv::Mat& finishColor(cv::Mat& image, const DecodeInfo& info, cv::Mat& converted);
+
+    // Red outline around box (original coordinates) on an image laid out by transform
+    static void drawOutline(cv::Mat& image, const ImageTransform& transform, const ImageRegion& box);
+
+    // Area-average downscale of an 8-bit 3-channel image (same weights as cv::INTER_AREA), SSE2 vectorized.
+    // Returns false when the input is not CV_8UC3 or the target is larger than the source on either axis.
+    static bool areaDownscale(const cv::Mat& image, cv::Mat& resized, int targetWidth, int targetHeight);
+
+    static const wchar_t* kernelName(ResizeKernel kernel);
+
+    // Largest power-of-two reduction (up to 8) that keeps both sides at or above the target
+    static int chooseReduceFactor(int width, int height, int targetWidth, int targetHeight);
+
+    // Mean SSIM over all channels (8-bit images of equal size)
+    static double computeSSIM(const cv::Mat& a, const cv::Mat& b);
+
+    // Time decode+resize with DecodeMode::Full vs DecodeMode::Reduced and compare the outputs
+    static DecodeBenchmarkResult benchmarkDecodeModes(const std::vector<std::string>& imagePaths,
+        const ImagePreprocessOptions& options = ImagePreprocessOptions());
+
+    // Time each kernel on the same decoded images and compare its output with the reference kernel
+    static std::vector<ResizeBenchmarkResult> benchmarkResizeKernels(const std::vector<std::string>& imagePaths,
+        const std::vector<ResizeKernel>& kernels, ResizeKernel reference = ResizeKernel::Lanczos4,
+        const ImagePreprocessOptions& options = ImagePreprocessOptions(), int iterations = 5);
+};
@@ -0,0 +1,375 @@
+#include "pch.h"
+#include "ImageProbe.h"
+#include "RawFramebuffer.h"
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+namespace {
+	// Enough to cover PNG, BMP and WebP headers; JPEG is walked segment by segment instead
+	const size_t kHeaderBytes = 64;
+
+	uint32_t readBE16(const unsigned char* p) { return (uint32_t(p[0]) << 8) | p[1]; }
+	uint32_t readBE32(const unsigned char* p) { return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3]; }
+	uint32_t readLE16(const unsigned char* p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8); }
+	uint32_t readLE24(const unsigned char* p) { return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16); }
+	uint32_t readLE32(const unsigned char* p) { return readLE24(p) | (uint32_t(p[3]) << 24); }
+}
+
+ImageProbe::ProbeResult ImageProbe::probe(const std::string& imagePath) {
+	ProbeResult result;
+
+	std::ifstream file(imagePath, std::ios::binary);
+	if (!file.is_open()) {
+		return result;
+	}
+
+	unsigned char header[kHeaderBytes] = {};
+	file.read(reinterpret_cast<char*>(header), sizeof(header));
+	size_t size = static_cast<size_t>(file.gcount());
+	if (size < 4) {
+		return result;
+	}
+
+	if (header[0] == 0xFF && header[1] == 0xD8) {
+		// JPEG: SOFn can sit behind large APPn (EXIF, ICC) segments, so walk the markers on the stream
+		file.clear();
+		file.seekg(2, std::ios::beg);
+		probeJPEG(file, result);
+	}
+	else if (!probeHeader(header, size, result)) {
+		// A raw dump is only recognisable together with the file size
+		file.clear();
+		file.seekg(0, std::ios::end);
+		probeRaw(header, size, static_cast<size_t>(file.tellg()), result);
+	}
+
+	result.success = result.width > 0 && result.height > 0;
+	return result;
+}
+
+ImageProbe::ProbeResult ImageProbe::probe(const unsigned char* data, size_t size) {
+	ProbeResult result;
+	if (!data || size < 4) {
+		return result;
+	}
+
+	if (data[0] == 0xFF && data[1] == 0xD8) {
+		probeJPEG(data + 2, size - 2, result);
+	}
+	else if (!probeHeader(data, (std::min)(size, kHeaderBytes), result)) {
+		probeRaw(data, size, size, result);
+	}
+
+	result.success = result.width > 0 && result.height > 0;
+	return result;
+}
+
+bool ImageProbe::probeHeader(const unsigned char* header, size_t size, ProbeResult& result) {
+	if (header[0] == 0x89 && header[1] == 'P' && header[2] == 'N' && header[3] == 'G') {
+		return probePNG(header, size, result);
+	}
+	if (header[0] == 'B' && header[1] == 'M') {
+		return probeBMP(header, size, result);
+	}
+	if (size >= 12 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WEBP", 4) == 0) {
+		return probeWebP(header, size, result);
+	}
+	return false;
+}
+
+bool ImageProbe::probeRaw(const unsigned char* header, size_t size, size_t fileSize, ProbeResult& result) {
+	// parseHeader checks the header against the total size; only its first 12 bytes are read
+	RawFramebuffer::Header raw;
+	if (size < 12 || !RawFramebuffer::parseHeader(header, fileSize, raw)) {
+		return false;
+	}
+	result.format = Format::RawFramebuffer;
+	result.width = raw.width;
+	result.height = raw.height;
+	return true;
+}
+
+bool ImageProbe::probePNG(const unsigned char* data, size_t size, ProbeResult& result) {
+	// 8-byte signature, then the IHDR chunk: length(4) "IHDR"(4) width(4) height(4)
+	if (size < 24 || memcmp(data + 12, "IHDR", 4) != 0) {
+		return false;
+	}
+
+	result.format = Format::PNG;
+	result.width = static_cast<int>(readBE32(data + 16));
+	result.height = static_cast<int>(readBE32(data + 20));
+	return true;
+}
+
+bool ImageProbe::probeBMP(const unsigned char* data, size_t size, ProbeResult& result) {
+	// 14-byte file header followed by the DIB header, whose first field is its own size
+	if (size < 26) {
+		return false;
+	}
+
+	uint32_t dibSize = readLE32(data + 14);
+	result.format = Format::BMP;
+	if (dibSize == 12) {
+		// BITMAPCOREHEADER: 16-bit width and height
+		result.width = static_cast<int>(readLE16(data + 18));
+		result.height = static_cast<int>(readLE16(data + 20));
+	}
+	else {
+		// BITMAPINFOHEADER and later: signed 32-bit, negative height means top-down rows
+		int32_t w = static_cast<int32_t>(readLE32(data + 18));
+		int32_t h = static_cast<int32_t>(readLE32(data + 22));
+		result.width = w < 0 ? -w : w;
+		result.height = h < 0 ? -h : h;
+	}
+	return true;
+}
+
+bool ImageProbe::probeWebP(const unsigned char* data, size_t size, ProbeResult& result) {
+	if (size < 30) {
+		return false;
+	}
+
+	result.format = Format::WebP;
+	const unsigned char* chunk = data + 12;
+	if (memcmp(chunk, "VP8 ", 4) == 0) {
+		// Lossy: 3-byte frame tag, start code 9D 01 2A, then 14-bit width and height
+		if (data[23] != 0x9D || data[24] != 0x01 || data[25] != 0x2A) {
+			return false;
+		}
+		result.width = static_cast<int>(readLE16(data + 26) & 0x3FFF);
+		result.height = static_cast<int>(readLE16(data + 28) & 0x3FFF);
+		return true;
+	}
+	if (memcmp(chunk, "VP8L", 4) == 0) {
+		// Lossless: signature 0x2F, then width-1 and height-1 packed as two 14-bit fields
+		if (data[20] != 0x2F) {
+			return false;
+		}
+		uint32_t bits = readLE32(data + 21);
+		result.width = static_cast<int>((bits & 0x3FFF) + 1);
+		result.height = static_cast<int>(((bits >> 14) & 0x3FFF) + 1);
+		return true;
+	}
+	if (memcmp(chunk, "VP8X", 4) == 0) {
+		// Extended: flags(4), then 24-bit canvas width-1 and height-1
+		result.width = static_cast<int>(readLE24(data + 24) + 1);
+		result.height = static_cast<int>(readLE24(data + 27) + 1);
+		return true;
+	}
+	return false;
+}
+
+bool ImageProbe::probeJPEG(std::istream& file, ProbeResult& result) {
+	result.format = Format::JPEG;
+	int orientation = 1;
+	unsigned char marker[4];
+
+	while (file.read(reinterpret_cast<char*>(marker), 2)) {
+		if (marker[0] != 0xFF) {
+			return false;
+		}
+		// Skip fill bytes
+		while (marker[1] == 0xFF) {
+			if (!file.read(reinterpret_cast<char*>(marker + 1), 1)) return false;
+		}
+
+		unsigned char type = marker[1];
+		// Standalone markers without a length field
+		if (type == 0x01 || (type >= 0xD0 && type <= 0xD7)) {
+			continue;
+		}
+		if (type == 0xD9 || type == 0xDA) {
+			// EOI or start of scan before any SOF: malformed
+			return false;
+		}
+
+		if (!file.read(reinterpret_cast<char*>(marker + 2), 2)) return false;
+		uint32_t length = readBE16(marker + 2);
+		if (length < 2) return false;
+		uint32_t payload = length - 2;
+
+		bool isSOF = type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC;
+		if (isSOF) {
+			// precision(1) height(2) width(2)
+			unsigned char sof[5];
+			if (payload < sizeof(sof) || !file.read(reinterpret_cast<char*>(sof), sizeof(sof))) return false;
+			result.height = static_cast<int>(readBE16(sof + 1));
+			result.width = static_cast<int>(readBE16(sof + 3));
+
+			// cv::imread applies the EXIF orientation, so report the size it would decode to
+			if (orientation >= 5 && orientation <= 8) {
+				std::swap(result.width, result.height);
+			}
+			return true;
+		}
+
+		if (type == 0xE1 && payload >= 14) {
+			// APP1: look for the EXIF orientation tag before skipping
+			std::vector<unsigned char> app1(payload);
+			if (!file.read(reinterpret_cast<char*>(app1.data()), payload)) return false;
+			int exifOrientation = readExifOrientation(app1.data(), app1.size());
+			if (exifOrientation > 0) {
+				orientation = exifOrientation;
+			}
+			continue;
+		}
+
+		file.seekg(payload, std::ios::cur);
+	}
+	return false;
+}
+
+bool ImageProbe::probeJPEG(const unsigned char* data, size_t size, ProbeResult& result) {
+	// Same marker walk as the stream version, over bytes already in memory (APP1 is parsed in place)
+	result.format = Format::JPEG;
+	int orientation = 1;
+	size_t pos = 0;
+
+	while (pos + 2 <= size) {
+		if (data[pos] != 0xFF) {
+			return false;
+		}
+		pos++;
+		// Skip fill bytes
+		while (pos < size && data[pos] == 0xFF) {
+			pos++;
+		}
+		if (pos >= size) return false;
+
+		unsigned char type = data[pos++];
+		// Standalone markers without a length field
+		if (type == 0x01 || (type >= 0xD0 && type <= 0xD7)) {
+			continue;
+		}
+		if (type == 0xD9 || type == 0xDA) {
+			// EOI or start of scan before any SOF: malformed
+			return false;
+		}
+
+		if (pos + 2 > size) return false;
+		uint32_t length = readBE16(data + pos);
+		if (length < 2) return false;
+		uint32_t payload = length - 2;
+		pos += 2;
+		if (payload > size - pos) return false;
+
+		bool isSOF = type >= 0xC0 && type <= 0xCF && type != 0xC4 && type != 0xC8 && type != 0xCC;
+		if (isSOF) {
+			// precision(1) height(2) width(2)
+			if (payload < 5) return false;
+			result.height = static_cast<int>(readBE16(data + pos + 1));
+			result.width = static_cast<int>(readBE16(data + pos + 3));
+
+			// cv::imdecode applies the EXIF orientation, so report the size it would decode to
+			if (orientation >= 5 && orientation <= 8) {
+				std::swap(result.width, result.height);
+			}
+			return true;
+		}
+
+		if (type == 0xE1 && payload >= 14) {
+			// APP1: look for the EXIF orientation tag
+			int exifOrientation = readExifOrientation(data + pos, payload);
+			if (exifOrientation > 0) {
+				orientation = exifOrientation;
+			}
+		}
+		pos += payload;
+	}
+	return false;
+}
+
+int ImageProbe::readExifOrientation(const unsigned char* data, size_t size) {
+	if (size < 14 || memcmp(data, "Exif\0\0", 6) != 0) {
+		return 0;
+	}
+
+	const unsigned char* tiff = data + 6;
+	size_t tiffSize = size - 6;
+	bool littleEndian = tiff[0] == 'I' && tiff[1] == 'I';
+	if (!littleEndian && !(tiff[0] == 'M' && tiff[1] == 'M')) {
+		return 0;
+	}
+
+	auto read16 = [&](size_t offset) { return littleEndian ? readLE16(tiff + offset) : readBE16(tiff + offset); };
+	auto read32 = [&](size_t offset) { return littleEndian ? readLE32(tiff + offset) : readBE32(tiff + offset); };
+
+	size_t ifd = read32(4);
+	if (ifd + 2 > tiffSize) {
+		return 0;
+	}
+
+	uint32_t entryCount = read16(ifd);
+	for (uint32_t i = 0; i < entryCount; ++i) {
+		size_t entry = ifd + 2 + i * 12;
+		if (entry + 12 > tiffSize) {
+			break;
+		}
+		if (read16(entry) == 0x0112) {
+			return static_cast<int>(read16(entry + 8));
+		}
+	}
+	return 0;
+}
+
+ImageProbe::BenchmarkResult ImageProbe::benchmark(const std::vector<std::string>& imagePaths, int iterations) {
+	BenchmarkResult bench;
+	bench.imageCount = static_cast<int>(imagePaths.size());
+	bench.iterations = iterations;
+
+	for (int iter = 0; iter < iterations; ++iter) {
+		for (const auto& imagePath : imagePaths) {
+			auto probeStart = std::chrono::high_resolution_clock::now();
+			ProbeResult probed = probe(imagePath);
+			auto probeEnd = std::chrono::high_resolution_clock::now();
+
+			cv::Mat image = cv::imread(imagePath, cv::IMREAD_COLOR);
+			auto decodeEnd = std::chrono::high_resolution_clock::now();
+
+			bench.probeMs += std::chrono::duration<double, std::milli>(probeEnd - probeStart).count();
+			bench.decodeMs += std::chrono::duration<double, std::milli>(decodeEnd - probeEnd).count();
+
+			if (iter > 0) {
+				continue;
+			}
+			if (!probed.success) {
+				bench.probeFailures++;
+			}
+			else if (!image.empty() && (probed.width != image.cols || probed.height != image.rows)) {
+				bench.mismatches++;
+			}
+		}
+	}
+
+	std::wcout << L"[ImageProbe] Benchmark over " << bench.imageCount << L" images x " << iterations
+		<< L" iterations - probe: " << bench.probeMs << L" ms, imread: " << bench.decodeMs
+		<< L" ms, probe failures: " << bench.probeFailures << L", mismatches: " << bench.mismatches << std::endl;
+	return bench;
+}
+
+const wchar_t* ImageProbe::formatName(Format format) {
+	switch (format) {
+	case Format::PNG: return L"PNG";
+	case Format::JPEG: return L"JPEG";
+	case Format::BMP: return L"BMP";
+	case Format::WebP: return L"WebP";
+	case Format::RawFramebuffer: return L"Raw";
+	default: return L"Unknown";
+	}
+}
+
+const char* ImageProbe::mimeType(Format format) {
+	switch (format) {
+	case Format::PNG: return "image/png";
+	case Format::BMP: return "image/bmp";
+	case Format::WebP: return "image/webp";
+	default: return "image/jpeg";
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <istream>
+#include <vector>
+
+// Header-only image dimension probe.
+// Reads just enough of the file (PNG IHDR, JPEG SOFn, BMP info header, WebP VP8/VP8L/VP8X, raw framebuffer header)
+// to report width and height without decoding any pixel data.
+class ImageProbe {
+public:
+    enum class Format {
+        Unknown,
+        PNG,
+        JPEG,
+        BMP,
+        WebP,
+        RawFramebuffer  // screencap dump, recognised by its size matching its header (see RawFramebuffer)
+    };
+
+    struct ProbeResult {
+        bool success = false;
+        Format format = Format::Unknown;
+        int width = 0;
+        int height = 0;
+    };
+
+    // Micro-benchmark result comparing the header probe against a full cv::imread
+    struct BenchmarkResult {
+        int imageCount = 0;
+        int iterations = 0;
+        double probeMs = 0.0;       // Total time spent in probe()
+        double decodeMs = 0.0;      // Total time spent in cv::imread
+        int probeFailures = 0;      // Images the probe could not handle (would fall back to OpenCV)
+        int mismatches = 0;         // Images where probe and decode disagree on the size
+    };
+
+    // Probe dimensions from the file header only. Fails for unknown or truncated formats.
+    static ProbeResult probe(const std::string& imagePath);
+
+    // Same, from file bytes already in memory
+    static ProbeResult probe(const unsigned char* data, size_t size);
+
+    // Time probe() against cv::imread over the given images
+    static BenchmarkResult benchmark(const std::vector<std::string>& imagePaths, int iterations = 1);
+
+    static const wchar_t* formatName(Format format);
+
+    // Data-URI MIME type; unknown formats are assumed to be JPEG
+    static const char* mimeType(Format format);
+
+private:
+    // PNG, BMP or WebP from the first bytes of the file
+    static bool probeHeader(const unsigned char* header, size_t size, ProbeResult& result);
+    static bool probePNG(const unsigned char* data, size_t size, ProbeResult& result);
+    static bool probeBMP(const unsigned char* data, size_t size, ProbeResult& result);
+    static bool probeWebP(const unsigned char* data, size_t size, ProbeResult& result);
+    static bool probeRaw(const unsigned char* header, size_t size, size_t fileSize, ProbeResult& result);
+    static bool probeJPEG(std::istream& file, ProbeResult& result);
+    static bool probeJPEG(const unsigned char* data, size_t size, ProbeResult& result);
+    static int readExifOrientation(const unsigned char* data, size_t size);
+};
@@ -6,6 +6,7 @@
 #include "framework.h"
 #include "IntentFlow.h"
 #include "IntentFlowDlg.h"
+#include "Base64.h"
 
 #ifdef _DEBUG
 #define new DEBUG_NEW
@@ -61,6 +62,25 @@ BOOL CIntentFlowApp::InitInstance()
 
 	AfxEnableControlContainer();
 
+#ifdef _DEBUG
+	// Debug builds check every SIMD base64 encoder this CPU supports against the reference encoder
+	if (!Base64::verify())
+	{
+		AfxMessageBox(_T("Base64 self-check failed: a SIMD encoder does not match the reference encoder."), MB_ICONERROR);
+	}
+#endif
+
+	// "IntentFlow.exe /benchmark" runs the offline image pipeline benchmarks on the test set instead of
+	// opening the dialog; the numbers go to the processor log
+	if (CString(m_lpCmdLine).Find(_T("/benchmark")) >= 0)
+	{
+		GUITaskProcessor processor;
+		bool passed = processor.benchmarkImagePipeline();
+		AfxMessageBox(passed ? _T("Image pipeline benchmark passed. See gui_task_processor.log for the results.")
+			: _T("Image pipeline benchmark failed! See gui_task_processor.log."), passed ? MB_ICONINFORMATION : MB_ICONERROR);
+		return FALSE;
+	}
+
 	// 创建 shell 管理器，以防对话框包含
 	// 任何 shell 树视图控件或 shell 列表视图控件。
 	CShellManager *pShellManager = new CShellManager;
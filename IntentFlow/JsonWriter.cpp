@@ -0,0 +1,253 @@
+#include "pch.h"
+#include "JsonWriter.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define JSONWRITER_SSE2 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+	// Two-character escapes JSON defines; other control characters become \u00XX
+	char shortEscape(unsigned char c) {
+		switch (c) {
+		case '"': return '"';
+		case '\\': return '\\';
+		case '\n': return 'n';
+		case '\r': return 'r';
+		case '\t': return 't';
+		case '\b': return 'b';
+		case '\f': return 'f';
+		default: return 0;
+		}
+	}
+
+	bool needsEscape(unsigned char c) {
+		return c < 0x20 || c == '"' || c == '\\';
+	}
+
+	int lowestBit(unsigned mask) {
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<int>(index);
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+
+	// Offset of the first character needing an escape at or after from, or size if none
+	size_t findEscape(const unsigned char* text, size_t from, size_t size) {
+		size_t i = from;
+#ifdef JSONWRITER_SSE2
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i backslash = _mm_set1_epi8('\\');
+		const __m128i control = _mm_set1_epi8(0x1F);
+		for (; i + 16 <= size; i += 16) {
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+			// Unsigned c <= 0x1F as max(c, 0x1F) == 0x1F; bytes of UTF-8 sequences are never flagged
+			__m128i flagged = _mm_or_si128(_mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(flagged));
+			if (mask) {
+				return i + lowestBit(mask);
+			}
+		}
+#endif
+		for (; i < size; ++i) {
+			if (needsEscape(text[i])) {
+				return i;
+			}
+		}
+		return size;
+	}
+}
+
+JsonWriter::JsonWriter() : out_(nullptr) {
+}
+
+JsonWriter::JsonWriter(std::string& out) : out_(&out) {
+}
+
+template <typename Append>
+void JsonWriter::escapeRuns(const char* text, size_t size, Append append) {
+	static const char kHex[] = "0123456789abcdef";
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+	size_t clean = 0;
+	for (size_t i = findEscape(bytes, 0, size); ; i = findEscape(bytes, i + 1, size)) {
+		// Copy the run that needs nothing in one go
+		if (i > clean) {
+			append(text + clean, i - clean);
+		}
+		if (i == size) {
+			break;
+		}
+		char escaped[6] = { '\\', shortEscape(bytes[i]) };
+		if (escaped[1]) {
+			append(escaped, 2);
+		}
+		else {
+			escaped[1] = 'u';
+			escaped[2] = '0';
+			escaped[3] = '0';
+			escaped[4] = kHex[bytes[i] >> 4];
+			escaped[5] = kHex[bytes[i] & 0xF];
+			append(escaped, 6);
+		}
+		clean = i + 1;
+	}
+}
+
+size_t JsonWriter::escapedSize(const char* text, size_t size) {
+	const unsigned char* bytes = reinterpret_cast<const unsigned char*>(text);
+	size_t result = size;
+	for (size_t i = findEscape(bytes, 0, size); i < size; i = findEscape(bytes, i + 1, size)) {
+		result += shortEscape(bytes[i]) ? 1 : 5;
+	}
+	return result;
+}
+
+size_t JsonWriter::escape(const char* text, size_t size, char* out) {
+	char* start = out;
+	escapeRuns(text, size, [&out](const char* run, size_t length) {
+		memcpy(out, run, length);
+		out += length;
+	});
+	return static_cast<size_t>(out - start);
+}
+
+void JsonWriter::put(char c) {
+	if (out_) {
+		out_->push_back(c);
+	}
+	size_++;
+}
+
+void JsonWriter::put(const char* text, size_t size) {
+	if (out_) {
+		out_->append(text, size);
+	}
+	size_ += size;
+}
+
+void JsonWriter::putEscaped(const char* text, size_t size) {
+	if (!out_) {
+		size_ += escapedSize(text, size);
+		return;
+	}
+	// Appends stay within the capacity reserved from the counting pass
+	std::string& out = *out_;
+	size_t start = out.size();
+	escapeRuns(text, size, [&out](const char* run, size_t length) { out.append(run, length); });
+	size_ += out.size() - start;
+}
+
+void JsonWriter::separate() {
+	if (afterKey_) {
+		afterKey_ = false;
+		return;
+	}
+	if (!needsComma_.empty()) {
+		if (needsComma_.back()) {
+			put(',');
+		}
+		needsComma_.back() = true;
+	}
+}
+
+JsonWriter& JsonWriter::beginObject() {
+	separate();
+	put('{');
+	needsComma_.push_back(false);
+	return *this;
+}
+
+JsonWriter& JsonWriter::endObject() {
+	needsComma_.pop_back();
+	put('}');
+	return *this;
+}
+
+JsonWriter& JsonWriter::beginArray() {
+	separate();
+	put('[');
+	needsComma_.push_back(false);
+	return *this;
+}
+
+JsonWriter& JsonWriter::endArray() {
+	needsComma_.pop_back();
+	put(']');
+	return *this;
+}
+
+JsonWriter& JsonWriter::key(const char* name) {
+	separate();
+	put('"');
+	putEscaped(name, strlen(name));
+	put("\":", 2);
+	afterKey_ = true;
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(const char* text, size_t size) {
+	separate();
+	put('"');
+	putEscaped(text, size);
+	put('"');
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(int number) {
+	separate();
+	char buffer[16];
+	int length = snprintf(buffer, sizeof(buffer), "%d", number);
+	put(buffer, static_cast<size_t>(length));
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(double number) {
+	separate();
+	// Shortest form that reads back as the same parameter value (0.7, not 0.69999999999999996)
+	char buffer[32];
+	int length = snprintf(buffer, sizeof(buffer), "%.15g", number);
+	put(buffer, static_cast<size_t>(length));
+	return *this;
+}
+
+JsonWriter& JsonWriter::value(bool flag) {
+	separate();
+	if (flag) {
+		put("true", 4);
+	}
+	else {
+		put("false", 5);
+	}
+	return *this;
+}
+
+JsonWriter& JsonWriter::beginString() {
+	separate();
+	put('"');
+	return *this;
+}
+
+JsonWriter& JsonWriter::stringPart(const char* text, size_t size, bool trusted) {
+	if (trusted) {
+		put(text, size);
+	}
+	else {
+		putEscaped(text, size);
+	}
+	return *this;
+}
+
+JsonWriter& JsonWriter::endString() {
+	put('"');
+	return *this;
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <string>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Streaming JSON writer for request bodies.
+// The same sequence of calls is run twice: first on a counting writer (no output) to get the exact
+// body size, then on a writer appending to a string reserved to that size, so the body is built in one
+// allocation with no reallocation or shifting. Strings are escaped in a single pass that scans 16 bytes
+// at a time (SSE2) for the characters JSON requires escaping: '"', '\\' and all control characters.
+class JsonWriter {
+public:
+    // Counting writer: only size() is tracked
+    JsonWriter();
+    // Appending writer
+    explicit JsonWriter(std::string& out);
+
+    JsonWriter& beginObject();
+    JsonWriter& endObject();
+    JsonWriter& beginArray();
+    JsonWriter& endArray();
+
+    // Member name inside an object; the next value call writes its value
+    JsonWriter& key(const char* name);
+
+    JsonWriter& value(const char* text, size_t size);
+    JsonWriter& value(const char* text) { return value(text, strlen(text)); }
+    JsonWriter& value(const std::string& text) { return value(text.data(), text.size()); }
+    JsonWriter& value(int number);
+    JsonWriter& value(double number);
+    JsonWriter& value(bool flag);
+
+    // A string value written in pieces, e.g. a data URI around a large base64 payload. Pieces marked
+    // trusted are copied without the escape scan (base64, fixed ASCII).
+    JsonWriter& beginString();
+    JsonWriter& stringPart(const char* text, size_t size, bool trusted = false);
+    JsonWriter& stringPart(const std::string& text, bool trusted = false) { return stringPart(text.data(), text.size(), trusted); }
+    JsonWriter& endString();
+
+    // Characters written (or that would have been written) so far
+    size_t size() const { return size_; }
+
+    // Length of text once escaped, without quotes
+    static size_t escapedSize(const char* text, size_t size);
+    // Escape text into out, which must hold escapedSize(text, size) chars; returns the chars written
+    static size_t escape(const char* text, size_t size, char* out);
+
+private:
+    std::string* out_;
+    size_t size_ = 0;
+    // One entry per open object or array: whether its next element needs a comma first
+    std::vector<bool> needsComma_;
+    bool afterKey_ = false;
+
+    void separate();
+    void put(char c);
+    void put(const char* text, size_t size);
+    void putEscaped(const char* text, size_t size);
+    // Calls append with each unescaped run and each escape sequence of text, in order
+    template <typename Append>
+    static void escapeRuns(const char* text, size_t size, Append append);
+};
@@ -11,13 +11,45 @@
 #include <locale>
 
 #include <opencv2/opencv.hpp>
+#include "ImagePreprocessor.h"
+#include "Base64.h"
+#include "ImageEncoder.h"
+#include "ImageProbe.h"
+#include "BufferPool.h"
+#include "RawFramebuffer.h"
+#include "JsonWriter.h"
+
+namespace {
+    // Fields of a resized image that follow from the options rather than the pixels: mapping mode, token
+    // estimate, optional pixel bounds and the outline flag (recomputed on cache hits, not stored)
+    void applyRequestOptions(ImageContext& context, const ImagePreprocessOptions& options) {
+        const ResizePolicy& policy = options.policy;
+        context.transform.mode = policy.mode;
+        context.estimatedTokens = policy.estimateTokens(context.transform);
+        if (policy.sendPixelBounds) {
+            context.minPixels = policy.minPixels();
+            context.maxPixels = policy.maxPixels();
+        }
+        context.outlined = !options.outline.isEmpty();
+    }
 
+    // Content-adaptive sizing against what the fixed policy would have spent, over all images scaled
+    std::atomic<uint64_t> adaptiveImages(0);
+    std::atomic<uint64_t> adaptiveTokens(0);
+    std::atomic<uint64_t> fixedPolicyTokens(0);
+}
 
-QwenAPI::QwenAPI(const APIConfig& config) : config_(config) {
+QwenAPI::QwenAPI(const APIConfig& config, std::shared_ptr<HttpTransport> transport) : config_(config) {
 	// Validate API key
 	if (!validateApiKey(config_.apiKey)) {
 		throw std::invalid_argument("Invalid API key format");
 	}
+	if (transport) {
+		setTransport(std::move(transport));
+	}
+	if (config_.prewarmConnections) {
+		prewarm_ = std::async(std::launch::async, [this]() { return prewarmConnections(); });
+	}
 }
 
 QwenAPI::APIResponse QwenAPI::sendImageQuery(const std::string& imagePath, const std::string& prompt) {
@@ -27,191 +59,536 @@ QwenAPI::APIResponse QwenAPI::sendImageQuery(const std::string& imagePath, const
 
 QwenAPI::APIResponse QwenAPI::sendImageQuery(const std::vector<std::string>& imagePaths, const std::string& prompt) {
     std::wcout << L"[sendImageQuery] Processing " << imagePaths.size() << L" images" << std::endl;
-    
-    return executeWithRetry([&]() -> APIResponse {
-        // 图片转换为Base64编码
-        std::vector<std::string> base64Images;
-        for (const auto& imagePath : imagePaths) {
-            // 使用更安全的转换函数
-            std::wstring wideImagePath = ANSIToUnicodeSafe(imagePath);
-            
-            std::wcout << L"[sendImageQuery] Processing image: " << wideImagePath << std::endl;
-            std::string base64Image = encodeImageToBase64(imagePath);
-            if (base64Image.empty()) {
-                std::wcout << L"[sendImageQuery] Failed to encode image: " << wideImagePath << std::endl;
-                return APIResponse{ false, "", "Failed to encode image: " + imagePath, -1 };
-            }
-            std::wcout << L"[sendImageQuery] Successfully encoded image. Size: " << base64Image.length() << std::endl;
-            base64Images.push_back(base64Image);
-        }
 
-        // 构造请求体
-        std::wcout << L"[sendImageQuery] Constructing request body with " << base64Images.size() << L" images" << std::endl;
-        std::string requestBody = constructRequestBody(base64Images, prompt);
-        if (requestBody.empty()) {
-            std::wcout << L"[sendImageQuery] Failed to construct request body" << std::endl;
-            return APIResponse{ false, "", "Failed to construct request body", -1 };
+    // 图片转换为Base64编码（只编码一次，重试时复用）；多张图片在预处理线程池上并行编码
+    std::vector<std::future<ImageContext>> pending;
+    pending.reserve(imagePaths.size());
+    for (const auto& imagePath : imagePaths) {
+        pending.push_back(prepareImageContextAsync(imagePath));
+    }
+
+    std::vector<ImageContext> contexts;
+    contexts.reserve(imagePaths.size());
+    for (size_t i = 0; i < pending.size(); ++i) {
+        contexts.push_back(pending[i].get());
+        if (contexts.back().base64Payload.empty()) {
+            std::wcout << L"[sendImageQuery] Failed to encode image: " << ANSIToUnicodeSafe(imagePaths[i]) << std::endl;
+            return APIResponse{ false, "", "Failed to encode image: " + imagePaths[i], -1 };
         }
+        std::wcout << L"[sendImageQuery] Successfully encoded image. Size: " << contexts.back().base64Payload.length() << std::endl;
+    }
+
+    // 构造请求体
+    std::wcout << L"[sendImageQuery] Constructing request body with " << contexts.size() << L" images" << std::endl;
+    std::vector<RequestImage> images;
+    for (const auto& context : contexts) {
+        images.push_back(toRequestImage(context));
+    }
+    return sendRequestBody(buildRequestBody(images, prompt));
+}
+
+QwenAPI::APIResponse QwenAPI::sendImageQuery(const ImageContext& context, const std::string& prompt) {
+    std::wcout << L"[sendImageQuery] Using prepared image context: " << ANSIToUnicodeSafe(context.imagePath) << std::endl;
+    return sendRequestBody(buildRequestBody(context, prompt));
+}
+
+QwenAPI::SharedRequestBody QwenAPI::buildRequestBody(const ImageContext& context, const std::string& prompt) {
+    if (context.base64Payload.empty()) {
+        std::wcout << L"[buildRequestBody] Image context has no payload: " << ANSIToUnicodeSafe(context.imagePath) << std::endl;
+        return SharedRequestBody();
+    }
+    std::vector<RequestImage> images = { toRequestImage(context) };
+    return buildRequestBody(images, prompt);
+}
+
+QwenAPI::SharedRequestBody QwenAPI::buildRequestBody(const std::vector<RequestImage>& images, const std::string& prompt) {
+    std::string requestBody = constructRequestBody(images, prompt);
+    if (requestBody.empty()) {
+        std::wcout << L"[buildRequestBody] Failed to construct request body" << std::endl;
+        return SharedRequestBody();
+    }
+
+    int imageTokens = 0;
+    for (const RequestImage& image : images) {
+        imageTokens += image.estimatedTokens;
+    }
+    std::wcout << L"[buildRequestBody] Estimated image tokens: " << imageTokens << std::endl;
+    return std::make_shared<const std::string>(std::move(requestBody));
+}
 
+QwenAPI::RequestImage QwenAPI::toRequestImage(const ImageContext& context) {
+    RequestImage image;
+    image.base64Payload = &context.base64Payload;
+    image.mimeType = context.mimeType;
+    image.minPixels = context.minPixels;
+    image.maxPixels = context.maxPixels;
+    image.estimatedTokens = context.estimatedTokens;
+    return image;
+}
+
+QwenAPI::APIResponse QwenAPI::sendRequestBody(const SharedRequestBody& requestBody) {
+    if (!requestBody) {
+        return APIResponse{ false, "", "Failed to construct request body", -1 };
+    }
+
+    // The body is immutable; every attempt sends the same buffer
+    return executeWithRetry([this, requestBody]() -> APIResponse {
         // 发送HTTP请求
-        std::wcout << L"[sendImageQuery] Sending HTTP request" << std::endl;
-        return sendHttpRequest(requestBody);
+        std::wcout << L"[sendRequestBody] Sending HTTP request, body size: " << requestBody->size() << std::endl;
+        sendAttempts_++;
+        return sendHttpRequest(*requestBody);
     });
 }
 
-std::string QwenAPI::encodeImageToBase64(const std::string& imagePath) {
+QwenAPI::PayloadStatistics QwenAPI::getPayloadStatistics() const {
+    PayloadStatistics stats;
+    stats.requestsBuilt = requestsBuilt_.load();
+    stats.sendAttempts = sendAttempts_.load();
+    stats.bodyBytes = bodyBytes_.load();
+    stats.bytesCopied = bytesCopied_.load();
+    stats.imageTokens = imageTokens_.load();
+    return stats;
+}
+
+void QwenAPI::logPayloadStatistics() const {
+    PayloadStatistics stats = getPayloadStatistics();
+    std::wcout << L"[QwenAPI] Request bodies built: " << stats.requestsBuilt << L", send attempts: " << stats.sendAttempts
+        << L", body bytes: " << stats.bodyBytes << L", bytes copied: " << stats.bytesCopied
+        << L", copied per request: " << (stats.requestsBuilt ? stats.bytesCopied / stats.requestsBuilt : 0)
+        << L", image tokens per request: " << (stats.requestsBuilt ? stats.imageTokens / stats.requestsBuilt : 0) << std::endl;
+}
+
+std::shared_ptr<HttpTransport> QwenAPI::transport() {
+    std::lock_guard<std::mutex> lock(transportMutex_);
+    if (!transport_) {
+        HttpTransport::Options options;
+        options.connections = (std::max)(config_.connectionPoolSize, config_.maxInFlight);
+        options.idleTimeoutSeconds = config_.connectionIdleSeconds;
+        transport_ = HttpTransport::createDefault(options);
+        transportConnections_ = options.connections;
+    }
+    return transport_;
+}
+
+void QwenAPI::setTransport(std::shared_ptr<HttpTransport> transport) {
+    std::lock_guard<std::mutex> lock(transportMutex_);
+    transport_ = std::move(transport);
+    transportInjected_ = transport_ != nullptr;
+}
+
+void QwenAPI::setConnectionPool(int size, int idleSeconds) {
+    std::lock_guard<std::mutex> lock(transportMutex_);
+    config_.connectionPoolSize = size;
+    config_.connectionIdleSeconds = idleSeconds;
+    // Requests in flight keep the old transport alive; its connections close when the last one finishes
+    if (!transportInjected_) {
+        transport_.reset();
+    }
+}
+
+int QwenAPI::prewarmConnections(int count) {
+    return transport()->prewarm(config_.apiUrl, count);
+}
+
+HttpTransport::Statistics QwenAPI::getConnectionStatistics() {
+    return transport()->getStatistics();
+}
+
+void QwenAPI::logConnectionStatistics() {
+    transport()->logStatistics();
+    std::lock_guard<std::mutex> lock(requestEngineMutex_);
+    if (requestEngine_) {
+        requestEngine_->logStatistics();
+    }
+}
+
+RequestEngine& QwenAPI::requestEngine() {
+    std::lock_guard<std::mutex> lock(requestEngineMutex_);
+    if (!requestEngine_) {
+        requestEngine_.reset(new RequestEngine(config_.maxInFlight));
+        std::wcout << L"[QwenAPI] Request engine started with " << requestEngine_->maxInFlight() << L" requests in flight" << std::endl;
+    }
+    return *requestEngine_;
+}
+
+void QwenAPI::setMaxInFlight(int maxInFlight) {
+    // Both the engine and the transport size themselves from maxInFlight, so it only changes under both locks
+    std::lock(requestEngineMutex_, transportMutex_);
+    std::lock_guard<std::mutex> engineLock(requestEngineMutex_, std::adopt_lock);
+    std::lock_guard<std::mutex> transportLock(transportMutex_, std::adopt_lock);
+    config_.maxInFlight = maxInFlight;
+    if (requestEngine_) {
+        requestEngine_->setMaxInFlight(maxInFlight);
+    }
+    // A default transport with fewer connections than the window is recreated with enough of them;
+    // requests in flight keep the old one alive
+    if (!transportInjected_ && transport_ && maxInFlight > transportConnections_) {
+        transport_.reset();
+    }
+}
+
+int QwenAPI::getMaxInFlight() const {
+    std::lock_guard<std::mutex> lock(transportMutex_);
+    return config_.maxInFlight;
+}
+
+void QwenAPI::waitForSubmitted() {
+    RequestEngine* engine = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(requestEngineMutex_);
+        engine = requestEngine_.get();
+    }
+    if (engine) {
+        engine->waitIdle();
+    }
+}
+
+void QwenAPI::submitRequestBody(const SharedRequestBody& requestBody, ResponseCallback done) {
+    if (!requestBody) {
+        done(APIResponse{ false, "", "Failed to construct request body", -1 });
+        return;
+    }
+
+    std::wcout << L"[submitRequestBody] Queueing HTTP request, body size: " << requestBody->size() << std::endl;
+    sendAttempts_++;
+    // The engine asks the retry policy about every reply before completing; the reply parsed there is the
+    // one handed to done, so each reply is logged and parsed once
+    auto parsed = std::make_shared<APIResponse>();
+    requestEngine().submit(transport(), apiRequest(nullptr), requestBody,
+        [parsed, done](HttpResponse&) { done(*parsed); },
+        [this, parsed](const HttpResponse& response, int attempt) {
+            *parsed = processResponse(response);
+            int delayMs = retryDelayMs(*parsed, attempt);
+            if (delayMs >= 0) {
+                sendAttempts_++;
+            }
+            return delayMs;
+        });
+}
+
+std::future<QwenAPI::APIResponse> QwenAPI::submitRequestBody(const SharedRequestBody& requestBody) {
+    auto promise = std::make_shared<std::promise<APIResponse>>();
+    std::future<APIResponse> future = promise->get_future();
+    submitRequestBody(requestBody, [promise](const APIResponse& response) { promise->set_value(response); });
+    return future;
+}
+
+void QwenAPI::submitImageQuery(const ImageContext& context, const std::string& prompt, ResponseCallback done) {
+    submitRequestBody(buildRequestBody(context, prompt), std::move(done));
+}
+
+std::future<QwenAPI::APIResponse> QwenAPI::submitImageQuery(const ImageContext& context, const std::string& prompt) {
+    return submitRequestBody(buildRequestBody(context, prompt));
+}
+
+WorkerPool& QwenAPI::preprocessPool() {
+    std::lock_guard<std::mutex> lock(preprocessPoolMutex_);
+    if (!preprocessPool_) {
+        preprocessPool_.reset(new WorkerPool(static_cast<size_t>((std::max)(0, config_.preprocessThreads)),
+            static_cast<size_t>((std::max)(0, config_.preprocessQueueCapacity))));
+        std::wcout << L"[QwenAPI] Preprocessing pool started with " << preprocessPool_->threadCount() << L" threads, queue capacity "
+            << preprocessPool_->queueCapacity() << std::endl;
+    }
+    return *preprocessPool_;
+}
+
+std::future<ImageContext> QwenAPI::prepareImageContextAsync(const std::string& imagePath, const ImagePreprocessOptions& options) {
+    return preprocessPool().submit([imagePath, options]() -> ImageContext {
+        ImageContext context;
+        prepareImageContext(imagePath, context, options);
+        return context;
+    });
+}
+
+void QwenAPI::prepareImageContextAsync(const std::string& imagePath, const ImagePreprocessOptions& options, ContextCallback done) {
+    preprocessPool().submit([imagePath, options, done]() {
+        ImageContext context;
+        prepareImageContext(imagePath, context, options);
+        done(context);
+    });
+}
+
+void QwenAPI::setPreprocessThreads(int threadCount) {
+    std::unique_ptr<WorkerPool> oldPool;
+    {
+        std::lock_guard<std::mutex> lock(preprocessPoolMutex_);
+        config_.preprocessThreads = threadCount;
+        oldPool.swap(preprocessPool_);
+    }
+    // Destroying the old pool finishes its queued jobs first
+}
+
+size_t QwenAPI::preprocessThreadCount() {
+    return preprocessPool().threadCount();
+}
+
+void QwenAPI::logPreprocessStatistics() {
+    WorkerPool::Statistics stats = preprocessPool().getStatistics();
+    std::wcout << L"[QwenAPI] Preprocessing jobs: " << stats.completed << L"/" << stats.submitted
+        << L", max queue depth: " << stats.maxQueueDepth << L", worker busy time: " << stats.busyMs << L" ms" << std::endl;
+    BufferPool::logStatistics();
+    if (adaptiveImages > 0) {
+        std::wcout << L"[QwenAPI] Adaptive resolution: " << adaptiveImages << L" images, ~" << adaptiveTokens / adaptiveImages
+            << L" image tokens on average vs ~" << fixedPolicyTokens / adaptiveImages << L" with the fixed policy" << std::endl;
+    }
+}
+
+ImageCache& QwenAPI::imageCache() {
+    static ImageCache cache;
+    return cache;
+}
+
+bool QwenAPI::prepareImageContext(const std::string& imagePath, ImageContext& context, const ImagePreprocessOptions& options) {
+    // File bytes, decoded and resized images and encode buffers all come from this thread's pool
+    BufferPool::ImageScope allocationScope;
+    BufferPool::Buffers& buffers = BufferPool::local();
+    if (!ImagePreprocessor::readFile(imagePath, buffers.fileBytes)) {
+        context = ImageContext();
+        context.imagePath = imagePath;
+        std::wcout << L"[prepareImageContext] Failed to open file or file is empty: " << ANSIToUnicodeSafe(imagePath) << std::endl;
+        return false;
+    }
+    return prepareLoadedImage(buffers.fileBytes, imagePath, context, options);
+}
+
+bool QwenAPI::prepareImageContext(const std::vector<unsigned char>& imageBytes, const std::string& sourceName,
+    ImageContext& context, const ImagePreprocessOptions& options) {
+    BufferPool::ImageScope allocationScope;
+    return prepareLoadedImage(imageBytes, sourceName, context, options);
+}
+
+bool QwenAPI::prepareLoadedImage(const std::vector<unsigned char>& binaryData, const std::string& imagePath,
+    ImageContext& context, const ImagePreprocessOptions& options) {
+    context = ImageContext();
+    context.imagePath = imagePath;
+
     // 使用更安全的转换函数
     std::wstring wideImagePath = ANSIToUnicodeSafe(imagePath);
     
-    std::wcout << L"[encodeImageToBase64] Processing image: " << wideImagePath << std::endl;
+    std::wcout << L"[prepareImageContext] Processing image: " << wideImagePath << std::endl;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    auto elapsedMs = [&startTime]() {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - startTime).count();
+    };
+
+    // Serve the ready-to-send payload from the on-disk cache when the file and options are unchanged
+    ImageCache& cache = imageCache();
+    std::string cacheKey;
+    if (cache.isEnabled()) {
+        cacheKey = ImageCache::makeKey(binaryData.data(), binaryData.size(), options);
+        if (cache.lookup(cacheKey, context)) {
+            applyRequestOptions(context, options);
+            cache.recordTiming(true, elapsedMs());
+            std::wcout << L"[prepareImageContext] Cache hit, payload size: " << context.base64Payload.length() << std::endl;
+            return true;
+        }
+    }
     
     // Try to scale the image first
-    std::wcout << L"[encodeImageToBase64] Attempting to scale image" << std::endl;
-    std::string scaledImage = scaleImage(imagePath);
-    if (!scaledImage.empty()) {
-        std::wcout << L"[encodeImageToBase64] Successfully scaled image, returning scaled version. Size: " << scaledImage.length() << std::endl;
-        return scaledImage;  // Return scaled image if successful
+    std::wcout << L"[prepareImageContext] Attempting to scale image" << std::endl;
+    if (scaleImage(binaryData, imagePath, context, options)) {
+        applyRequestOptions(context, options);
+        if (!cacheKey.empty()) {
+            cache.store(cacheKey, context);
+            cache.recordTiming(false, elapsedMs());
+        }
+        std::wcout << L"[prepareImageContext] Successfully scaled image, returning scaled version. Size: " << context.base64Payload.length() << std::endl;
+        return true;
     }
     
     // Fall back to original method if scaling fails
-    std::wcout << L"[encodeImageToBase64] Scaling failed, falling back to original method" << std::endl;
-    std::ifstream file(imagePath, std::ios::binary);
-    if (!file.is_open()) {
-        std::wcout << L"[encodeImageToBase64] Failed to open file: " << wideImagePath << std::endl;
-        return "";
+    std::wcout << L"[prepareImageContext] Scaling failed, falling back to original method" << std::endl;
+    context.scaled = false;
+
+    // Raw pixels are not an image format the API accepts
+    RawFramebuffer::Header raw;
+    if (RawFramebuffer::parseHeader(binaryData.data(), binaryData.size(), raw)) {
+        std::wcout << L"[prepareImageContext] Raw framebuffer could not be scaled: " << wideImagePath << std::endl;
+        return false;
     }
 
-    std::ostringstream buffer;
-    buffer << file.rdbuf();
-    file.close();
+    // Send the file bytes as they are
+    std::wcout << L"[prepareImageContext] Encoding original image to base64. Size: " << binaryData.size() << std::endl;
+    context.base64Payload = Base64::encode(binaryData.data(), binaryData.size());
+    context.mimeType = ImageProbe::mimeType(ImageProbe::probe(binaryData.data(), binaryData.size()).format);
+    std::wcout << L"[prepareImageContext] Returning original image base64. Size: " << context.base64Payload.length() << std::endl;
+    return true;
+}
 
-    const std::string& binaryData = buffer.str();
-    if (binaryData.empty()) {
-        std::wcout << L"[encodeImageToBase64] File is empty: " << wideImagePath << std::endl;
-        return "";
+QwenAPI::RawIngestionBenchmark QwenAPI::benchmarkRawIngestion(const std::vector<std::string>& rawPaths,
+    const ImagePreprocessOptions& options, int iterations) {
+    RawIngestionBenchmark bench;
+    bench.iterations = (std::max)(iterations, 1);
+
+    std::vector<unsigned char> rawBytes, pngBytes;
+    double rawTotal = 0.0, pngTotal = 0.0;
+    for (const auto& rawPath : rawPaths) {
+        cv::Mat pixels, bgr;
+        RawFramebuffer::Header header;
+        std::ifstream file(rawPath, std::ios::binary);
+        if (!RawFramebuffer::read(file, rawBytes) || !RawFramebuffer::wrap(rawBytes, pixels, header)) {
+            std::wcout << L"[QwenAPI] Not a raw framebuffer dump: " << ANSIToUnicodeSafe(rawPath) << std::endl;
+            continue;
+        }
+
+        // The same frame as `screencap -p` would have produced it
+        int conversion = RawFramebuffer::toBGRConversion(header.format);
+        cv::cvtColor(pixels, bgr, conversion >= 0 ? conversion : cv::COLOR_BGR5652BGR);
+        if (!cv::imencode(".png", bgr, pngBytes)) {
+            continue;
+        }
+        bench.imageCount++;
+        bench.rawBytes += rawBytes.size();
+        bench.pngBytes += pngBytes.size();
+
+        ImageContext context;
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < bench.iterations; ++i) {
+            scaleImage(rawBytes, rawPath, context, options);
+        }
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (int i = 0; i < bench.iterations; ++i) {
+            scaleImage(pngBytes, rawPath, context, options);
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        rawTotal += std::chrono::duration<double, std::milli>(t1 - t0).count();
+        pngTotal += std::chrono::duration<double, std::milli>(t2 - t1).count();
+    }
+
+    if (bench.imageCount > 0) {
+        bench.rawMs = rawTotal / (bench.imageCount * bench.iterations);
+        bench.pngMs = pngTotal / (bench.imageCount * bench.iterations);
     }
+    std::wcout << L"[QwenAPI] Raw ingestion benchmark over " << bench.imageCount << L" frames - raw: " << bench.rawMs
+        << L" ms (" << bench.rawBytes << L" bytes captured), PNG: " << bench.pngMs << L" ms (" << bench.pngBytes
+        << L" bytes captured)" << std::endl;
+    return bench;
+}
 
-    // Use the new base64Encode function
-    std::wcout << L"[encodeImageToBase64] Encoding original image to base64. Size: " << binaryData.length() << std::endl;
-    std::string result = base64Encode(binaryData);
-    std::wcout << L"[encodeImageToBase64] Returning original image base64. Size: " << result.length() << std::endl;
-    return result;
+std::string QwenAPI::encodeImageToBase64(const std::string& imagePath) {
+    ImageContext context;
+    if (!prepareImageContext(imagePath, context)) {
+        return "";
+    }
+    return context.base64Payload;
 }
 
 // Add base64Encode helper function
 std::string QwenAPI::base64Encode(const std::string& data) {
-	// Base64 encoding table
-	static const char* base64_chars =
-		"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-		"abcdefghijklmnopqrstuvwxyz"
-		"0123456789+/";
-
-	std::string ret;
-	int i = 0;
-	int j = 0;
-	unsigned char char_array_3[3];
-	unsigned char char_array_4[4];
-
-	size_t bytes_len = data.size();
-	const unsigned char* bytes_to_encode = reinterpret_cast<const unsigned char*>(data.c_str());
-
-	while (bytes_len--) {
-		char_array_3[i++] = *(bytes_to_encode++);
-		if (i == 3) {
-			char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-			char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-			char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-			char_array_4[3] = char_array_3[2] & 0x3f;
-
-			for (i = 0; (i < 4); i++)
-				ret += base64_chars[char_array_4[i]];
-			i = 0;
-		}
-	}
-
-	if (i) {
-		for (j = i; j < 3; j++)
-			char_array_3[j] = '\0';
-
-		char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-		char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-		char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-		char_array_4[3] = char_array_3[2] & 0x3f;
-
-		for (j = 0; (j < i + 1); j++)
-			ret += base64_chars[char_array_4[j]];
+	// Vectorized encoder (AVX2/SSSE3 with scalar fallback), writes into a pre-sized string
+	return Base64::encode(data);
+}
 
-		while ((i++ < 3))
-			ret += '=';
-	}
+std::string QwenAPI::scaleImage(const std::string& imagePath) {
+    ImageContext context;
+    if (!scaleImage(imagePath, context)) {
+        return "";
+    }
+    return context.base64Payload;
+}
 
-	return ret;
+bool QwenAPI::scaleImage(const std::string& imagePath, ImageContext& context, const ImagePreprocessOptions& options) {
+    BufferPool::Buffers& buffers = BufferPool::local();
+    if (!ImagePreprocessor::readFile(imagePath, buffers.fileBytes)) {
+        std::wcout << L"[scaleImage] Failed to load image: " << ANSIToUnicodeSafe(imagePath) << std::endl;
+        return false;
+    }
+    return scaleImage(buffers.fileBytes, imagePath, context, options);
 }
 
-std::string QwenAPI::scaleImage(const std::string& imagePath) {
+bool QwenAPI::scaleImage(const std::vector<uchar>& fileBytes, const std::string& imagePath, ImageContext& context,
+    const ImagePreprocessOptions& options) {
     try {
-        // Convert imagePath to wide string for OpenCV
+        // Convert imagePath to wide string for logging
         std::wstring widePath = ANSIToUnicodeSafe(imagePath);
-        std::string utf8Path = UnicodeToUTF8(widePath);
         
         std::wcout << L"[scaleImage] Processing image: " << widePath << std::endl;
         
-        // Load the image
-        cv::Mat image = cv::imread(utf8Path, cv::IMREAD_COLOR);
-        if (image.empty()) {
+        // Intermediate images and encode buffers are reused across images on this thread
+        BufferPool::Buffers& buffers = BufferPool::local();
+        
+        // Decode the image (large JPEGs may be decoded at reduced resolution, see DecodeMode)
+        ImagePreprocessor::DecodeInfo decodeInfo;
+        cv::Mat& image = buffers.decoded;
+        if (!ImagePreprocessor::decode(fileBytes, options, image, decodeInfo)) {
             std::wcout << L"[scaleImage] Failed to load image: " << widePath << std::endl;
-            return "";
+            return false;
         }
         
-        // Get original dimensions
-        int originalWidth = image.cols;
-        int originalHeight = image.rows;
-        
-        std::wcout << L"[scaleImage] Original image size: " << originalWidth << L"x" << originalHeight << L" for image: " << widePath << std::endl;
-        
-        // Target dimensions (960x960) - fixed size, not maintaining aspect ratio
-        const int targetWidth = 960;
-        const int targetHeight = 960;
-        
-        std::wcout << L"[scaleImage] Target image size: " << targetWidth << L"x" << targetHeight << L" for image: " << widePath << std::endl;
+        // Get original dimensions (full resolution, independent of the decode reduction)
+        int originalWidth = decodeInfo.originalWidth;
+        int originalHeight = decodeInfo.originalHeight;
         
-        // Calculate scale factors for logging purposes
-        float scaleX = (float)targetWidth / originalWidth;
-        float scaleY = (float)targetHeight / originalHeight;
+        std::wcout << L"[scaleImage] Original image size: " << originalWidth << L"x" << originalHeight << L" for image: " << widePath
+            << (decodeInfo.wrapped ? L", raw framebuffer (no decode)" : L", decode reduction: 1/" + std::to_wstring(decodeInfo.reduceFactor)) << std::endl;
         
-        std::wcout << L"[scaleImage] Scale factors - X: " << scaleX << L", Y: " << scaleY << L" for image: " << widePath << std::endl;
+        // Canvas geometry comes from the resize policy, scaled by how busy the screen is in adaptive mode;
+        // the same transform maps coordinates both ways later
+        ResizePolicy policy = options.policy;
+        ImageTransform fixedTransform = options.policy.plan(originalWidth, originalHeight, options.crop);
+        if (options.adaptive.enabled && fixedTransform.isValid()) {
+            double density = ImagePreprocessor::edgeDensity(image, fixedTransform);
+            policy = options.policy.adaptToDensity(density, options.adaptive, fixedTransform.sourceWidth, fixedTransform.sourceHeight);
+            int tokens = options.policy.estimateTokens(policy.plan(originalWidth, originalHeight, options.crop));
+            int fixedTokens = options.policy.estimateTokens(fixedTransform);
+            adaptiveImages++;
+            adaptiveTokens += tokens;
+            fixedPolicyTokens += fixedTokens;
+            std::wcout << L"[scaleImage] UI density " << density << L" -> " << ANSIToUnicodeSafe(policy.toString()) << L", ~"
+                << tokens << L" tokens (fixed policy ~" << fixedTokens << L") for image: " << widePath << std::endl;
+        }
+        ImageTransform transform = policy.plan(originalWidth, originalHeight, options.crop);
+        if (!transform.isValid()) {
+            std::wcout << L"[scaleImage] Invalid resize plan for image: " << widePath << std::endl;
+            return false;
+        }
         
-        // Resize the image to exact dimensions using high quality interpolation
-        cv::Mat resizedImage;
-        cv::resize(image, resizedImage, cv::Size(targetWidth, targetHeight), 0, 0, cv::INTER_LANCZOS4);
+        std::wcout << L"[scaleImage] Target image size: " << transform.canvasWidth << L"x" << transform.canvasHeight
+            << L" (content " << transform.contentWidth << L"x" << transform.contentHeight << L" at " << transform.offsetX << L","
+            << transform.offsetY << L") for image: " << widePath << std::endl;
+        if (transform.isCropped()) {
+            std::wcout << L"[scaleImage] Source region: " << transform.sourceWidth << L"x" << transform.sourceHeight << L" at "
+                << transform.sourceX << L"," << transform.sourceY << L" for image: " << widePath << std::endl;
+        }
+        std::wcout << L"[scaleImage] Scale factors - X: " << transform.scaleX() << L", Y: " << transform.scaleY() << L" for image: " << widePath << std::endl;
         
-        // Encode the resized image as JPEG in memory
-        std::vector<uchar> buffer;
-        std::vector<int> params;
-        params.push_back(cv::IMWRITE_JPEG_QUALITY);
-        params.push_back(90); // JPEG quality
+        // Resize with the kernel selected in the options, padding to the canvas if the policy letterboxes
+        // Raw framebuffers are resized in their own channel order and only the small result is converted
+        cv::Mat& resizedImage = ImagePreprocessor::finishColor(
+            ImagePreprocessor::resize(image, transform, options.kernel, buffers.resized, buffers.canvas), decodeInfo, buffers.converted);
+        if (!options.outline.isEmpty()) {
+            ImagePreprocessor::drawOutline(resizedImage, transform, options.outline);
+        }
         
-        bool success = cv::imencode(".jpg", resizedImage, buffer, params);
-        if (!success) {
-            std::wcout << L"[scaleImage] Failed to encode image to JPEG for image: " << widePath << std::endl;
-            return "";
+        // Encode in memory: fixed codec/quality, or the best codec and quality that fit the byte budget
+        EncodedImage& encoded = buffers.encoded;
+        if (!ImageEncoder::encode(resizedImage, options, encoded)) {
+            std::wcout << L"[scaleImage] Failed to encode image for image: " << widePath << std::endl;
+            return false;
         }
+        std::wcout << L"[scaleImage] Encoded as " << ANSIToUnicodeSafe(encoded.codec) << L" quality " << encoded.quality
+            << L", " << encoded.bytes.size() << L" bytes after " << encoded.attempts << L" encodes" << std::endl;
         
-        // Convert the image data to Base64
-        std::string imageData(buffer.begin(), buffer.end());
-        std::string base64Result = base64Encode(imageData);
+        // Convert the image data to Base64 straight from the encode buffer into the payload; this string
+        // leaves with the context, so it is the one allocation per image that the pool cannot absorb
+        context.base64Payload.resize(Base64::encodedSize(encoded.bytes.size()));
+        Base64::encode(encoded.bytes.data(), encoded.bytes.size(), &context.base64Payload[0]);
         
-        std::wcout << L"[scaleImage] Successfully encoded image to base64, size: " << base64Result.length() << L" characters for image: " << widePath << std::endl;
+        std::wcout << L"[scaleImage] Successfully encoded image to base64, size: " << context.base64Payload.length() << L" characters for image: " << widePath << std::endl;
         
-        return base64Result;
+        context.scaled = true;
+        context.transform = transform;
+        context.mimeType = ImageEncoder::mimeType(encoded.codec);
+        return true;
     }
     catch (const std::exception& e) {
         std::wcout << L"[scaleImage] Exception occurred: " << ANSIToUnicodeSafe(std::string(e.what())) << std::endl;
-        return "";
+        return false;
     }
     catch (...) {
         std::wcout << L"[scaleImage] Unknown exception occurred" << std::endl;
-        return "";
+        return false;
     }
 }
 
@@ -220,196 +597,106 @@ bool QwenAPI::validateApiKey(const std::string& apiKey) {
 	return !apiKey.empty() && apiKey.length() > 30 && apiKey.substr(0, 3) == "sk-";
 }
 
-std::string QwenAPI::constructRequestBody(const std::vector<std::string>& base64Images, const std::string& prompt) {
+std::string QwenAPI::constructRequestBody(const std::vector<RequestImage>& images, const std::string& prompt) {
 	// Convert prompt to wide string then to UTF-8 to ensure proper handling of Chinese characters
 	std::wstring widePrompt = ANSIToUnicode(prompt);
 	std::string utf8Prompt = UnicodeToUTF8(widePrompt);
 
-	// Manually construct JSON request body without JsonCpp library
-	std::string escapedPrompt = utf8Prompt;
-
-	// Escape special characters in prompt for JSON in correct order
-	// First escape backslashes
-	size_t pos = 0;
-	while ((pos = escapedPrompt.find("\\", pos)) != std::string::npos) {
-		escapedPrompt.replace(pos, 1, "\\\\");
-		pos += 2;
-	}
-
-	// Then escape double quotes
-	pos = 0;
-	while ((pos = escapedPrompt.find("\"", pos)) != std::string::npos) {
-		escapedPrompt.replace(pos, 1, "\\\"");
-		pos += 2;
-	}
-
-	// Replace newlines with \n escape sequence
-	pos = 0;
-	while ((pos = escapedPrompt.find("\n", pos)) != std::string::npos) {
-		escapedPrompt.replace(pos, 1, "\\n");
-		pos += 2;
-	}
-
-	// Replace carriage returns with \r escape sequence
-	pos = 0;
-	while ((pos = escapedPrompt.find("\r", pos)) != std::string::npos) {
-		escapedPrompt.replace(pos, 1, "\\r");
-		pos += 2;
-	}
-
-	// Replace tabs with \t escape sequence
-	pos = 0;
-	while ((pos = escapedPrompt.find("\t", pos)) != std::string::npos) {
-		escapedPrompt.replace(pos, 1, "\\t");
-		pos += 2;
-	}
-
-	std::string body = "{";
+	static const char kDataPrefix[] = "data:";
+	static const char kBase64Marker[] = ";base64,";
+	const GenerationParameters& generation = config_.generation;
 
-	// Add model
-	body += "\"model\": \"qwen-vl-max\",";
-
-	// Add input object
-	body += "\"input\": {";
-
-	// Add messages array
-	body += "\"messages\": [";
-
-	// Add user message
-	body += "{";
-	body += "\"role\": \"user\",";
-	body += "\"content\": [";
-
-	// Add image content for each image
-	for (size_t i = 0; i < base64Images.size(); ++i) {
-		if (i > 0) body += ",";
-		body += "{";
-		body += "\"image\": \"data:image/jpeg;base64," + base64Images[i] + "\"";
-		body += "}";
+	size_t imageBytes = 0;
+	uint64_t imageTokens = 0;
+	for (const auto& image : images) {
+		imageBytes += image.base64Payload->size();
+		imageTokens += image.estimatedTokens;
 	}
 
-	// Add text content
-	if (!base64Images.empty()) body += ",";
-	body += "{";
-	body += "\"text\": \"" + escapedPrompt + "\"";
-	body += "}";
-
-	body += "]"; // Close content array
-	body += "}"; // Close message object
-
-	body += "]"; // Close messages array
-	body += "}"; // Close input object
-
-	// Add parameters
-	body += ",\"parameters\": {";
-	body += "\"max_tokens\": 1024";
-	body += "}";
-
-	body += "}"; // Close root object
+	// Run once counting to get the exact size, then again into a single allocation
+	auto write = [&](JsonWriter& json) {
+		json.beginObject();
+		json.key("model").value(config_.model);
+		json.key("input").beginObject();
+		json.key("messages").beginArray();
+		json.beginObject();
+		json.key("role").value("user");
+		json.key("content").beginArray();
+		for (const auto& image : images) {
+			json.beginObject();
+			// Base64 never needs escaping; only the MIME type goes through the scan
+			json.key("image").beginString()
+				.stringPart(kDataPrefix, sizeof(kDataPrefix) - 1, true)
+				.stringPart(image.mimeType)
+				.stringPart(kBase64Marker, sizeof(kBase64Marker) - 1, true)
+				.stringPart(*image.base64Payload, true)
+				.endString();
+			if (image.minPixels > 0 && image.maxPixels > 0) {
+				json.key("min_pixels").value(image.minPixels);
+				json.key("max_pixels").value(image.maxPixels);
+			}
+			json.endObject();
+		}
+		json.beginObject();
+		json.key("text").value(utf8Prompt);
+		json.endObject();
+		json.endArray();
+		json.endObject();
+		json.endArray();
+		json.endObject();
+		json.key("parameters").beginObject();
+		if (generation.maxTokens > 0) json.key("max_tokens").value(generation.maxTokens);
+		if (generation.temperature >= 0.0) json.key("temperature").value(generation.temperature);
+		if (generation.topP >= 0.0) json.key("top_p").value(generation.topP);
+		if (generation.seed >= 0) json.key("seed").value(generation.seed);
+		json.endObject();
+		json.endObject();
+	};
+
+	JsonWriter counter;
+	write(counter);
+
+	std::string body;
+	body.reserve(counter.size());
+	JsonWriter writer(body);
+	write(writer);
+
+	// The image payloads are the only large copies left: once into the body
+	requestsBuilt_++;
+	bodyBytes_ += body.size();
+	bytesCopied_ += imageBytes;
+	imageTokens_ += imageTokens;
 
 	return body;
 }
 
-QwenAPI::APIResponse QwenAPI::sendHttpRequest(const std::string& requestBody) {
-	HINTERNET hSession = nullptr;
-	HINTERNET hConnect = nullptr;
-	HINTERNET hRequest = nullptr;
-	APIResponse result;
-
-	do {
-		// Create session
-		hSession = WinHttpOpen(L"QwenAPI Client/1.0",
-			WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
-			WINHTTP_NO_PROXY_NAME,
-			WINHTTP_NO_PROXY_BYPASS,
-			0);
-		if (!hSession) {
-			result.errorMessage = "Failed to create WinHTTP session";
-			break;
-		}
-
-		// Connect to server
-		hConnect = WinHttpConnect(hSession, L"dashscope.aliyuncs.com", INTERNET_DEFAULT_HTTPS_PORT, 0);
-		if (!hConnect) {
-			result.errorMessage = "Failed to connect to server";
-			break;
-		}
-
-		// Create request
-		hRequest = WinHttpOpenRequest(hConnect, L"POST",
-			L"/api/v1/services/aigc/multimodal-generation/generation",
-			nullptr, WINHTTP_NO_REFERER,
-			WINHTTP_DEFAULT_ACCEPT_TYPES,
-			WINHTTP_FLAG_SECURE);
-		if (!hRequest) {
-			result.errorMessage = "Failed to create HTTP request";
-			break;
-		}
-
-		// Set request headers
-		std::wstring headers = L"Authorization: Bearer " + std::wstring(config_.apiKey.begin(), config_.apiKey.end()) +
-			L"\r\nContent-Type: application/json\r\nAccept: application/json\r\n";
-
-		// Convert headers to LPCWSTR
-		LPCWSTR pwszHeaders = headers.c_str();
-		DWORD dwHeadersLength = static_cast<DWORD>(headers.length());
-
-		// Send request with proper headers
-		if (!WinHttpSendRequest(hRequest, pwszHeaders, dwHeadersLength,
-			(LPVOID)requestBody.c_str(), static_cast<DWORD>(requestBody.length()),
-			static_cast<DWORD>(requestBody.length()), 0)) {
-			result.errorMessage = "Failed to send HTTP request: " + std::to_string(GetLastError());
-			WinHttpCloseHandle(hRequest);
-			WinHttpCloseHandle(hConnect);
-			return result;
-		}
-
-		// Receive response
-		if (!WinHttpReceiveResponse(hRequest, NULL)) {
-			result.errorMessage = "Failed to receive HTTP response: " + std::to_string(GetLastError());
-			WinHttpCloseHandle(hRequest);
-			WinHttpCloseHandle(hConnect);
-			return result;
-		}
-
-		// Get response status code
-		DWORD dwStatusCode = 0;
-		DWORD dwSize = sizeof(dwStatusCode);
-		WinHttpQueryHeaders(hRequest,
-			WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
-			WINHTTP_HEADER_NAME_BY_INDEX,
-			&dwStatusCode, &dwSize, WINHTTP_NO_HEADER_INDEX);
-
-		result.statusCode = static_cast<int>(dwStatusCode);
-
-		// Read response content
-		std::string responseBuffer;
-		DWORD dwDownloaded = 0;
-		std::vector<char> buffer(10240); // 10KB buffer
-
-		do {
-			if (!WinHttpReadData(hRequest, (LPVOID)buffer.data(), static_cast<DWORD>(buffer.size()), &dwDownloaded)) {
-				result.errorMessage = "Error reading HTTP data: " + std::to_string(GetLastError());
-				break;
-			}
-
-			if (dwDownloaded > 0) {
-				responseBuffer.append(buffer.data(), dwDownloaded);
-			}
-		} while (dwDownloaded > 0);
-
-		WinHttpCloseHandle(hRequest);
-		WinHttpCloseHandle(hConnect);
+HttpRequest QwenAPI::apiRequest(const std::string* requestBody) const {
+	HttpRequest request;
+	request.url = config_.apiUrl;
+	request.headers = {
+		{ "Authorization", "Bearer " + config_.apiKey },
+		{ "Content-Type", "application/json" },
+		{ "Accept", "application/json" }
+	};
+	request.body = requestBody;
+	request.timeoutSeconds = config_.timeoutSeconds;
+	return request;
+}
 
-		// Process response
-		return processResponse(responseBuffer, result.statusCode);
-	} while (false);
+QwenAPI::APIResponse QwenAPI::sendHttpRequest(const std::string& requestBody) {
+	return processResponse(transport()->send(apiRequest(&requestBody)));
+}
 
-	// Clean up handles in case of error
-	if (hRequest) WinHttpCloseHandle(hRequest);
-	if (hConnect) WinHttpCloseHandle(hConnect);
-	if (hSession) WinHttpCloseHandle(hSession);
+QwenAPI::APIResponse QwenAPI::processResponse(const HttpResponse& response) {
+	if (!response.completed) {
+		APIResponse result;
+		result.errorMessage = response.errorMessage;
+		return result;
+	}
 
+	// Process response
+	APIResponse result = processResponse(response.body, response.statusCode);
+	result.connectionReused = response.connectionReused;
 	return result;
 }
 
@@ -436,27 +723,34 @@ QwenAPI::APIResponse QwenAPI::executeWithRetry(const std::function<APIResponse()
 	for (int attempt = 0; attempt <= config_.maxRetries; ++attempt) {
 		lastResponse = operation();
 
-		// 如果成功或者达到最大重试次数，返回结果
-		if (lastResponse.success || attempt == config_.maxRetries) {
-			return lastResponse;
-		}
-
-		// 如果是某些错误，直接返回结果
-		if (lastResponse.statusCode == 401 || lastResponse.statusCode == 403) {
-			// 认证错误，直接返回结果
+		int delayMs = retryDelayMs(lastResponse, attempt);
+		if (delayMs < 0) {
 			return lastResponse;
 		}
 
-		// 等待一段时间，然后重试，指数退避
-		if (attempt < config_.maxRetries) {
-			int delayMs = (1 << attempt) * 1000; // 1秒, 2秒, 4秒...
-			std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
-		}
+		// 等待一段时间，然后重试
+		std::this_thread::sleep_for(std::chrono::milliseconds(delayMs));
 	}
 
 	return lastResponse;
 }
 
+int QwenAPI::retryDelayMs(const APIResponse& response, int attempt) const {
+	// 如果成功或者达到最大重试次数，返回结果
+	if (response.success || attempt >= config_.maxRetries) {
+		return -1;
+	}
+
+	// 如果是某些错误，直接返回结果
+	if (response.statusCode == 401 || response.statusCode == 403) {
+		// 认证错误，直接返回结果
+		return -1;
+	}
+
+	// 指数退避
+	return (1 << attempt) * 1000; // 1秒, 2秒, 4秒...
+}
+
 std::wstring QwenAPI::ANSIToUnicode(const std::string& str)
 {
 	if (str.empty()) return std::wstring();
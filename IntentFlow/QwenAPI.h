@@ -3,18 +3,43 @@
 #include <vector>
 #include <memory>
 #include <functional>
-#include <windows.h>
-#include <winhttp.h>
-#pragma comment(lib, "winhttp.lib")
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include "ImageContext.h"
+#include "ImageCache.h"
+#include "WorkerPool.h"
+#include "HttpTransport.h"
+#include "RequestEngine.h"
 
 // Qwen API communication module
 class QwenAPI {
 public:
+    // Sampling parameters sent in the request's "parameters" object; negative values are left out so the
+    // server default applies
+    struct GenerationParameters {
+        int maxTokens = 1024;
+        double temperature = -1.0;
+        double topP = -1.0;
+        int seed = -1;
+    };
+
     struct APIConfig {
         std::string apiKey;
+        std::string model = "qwen-vl-max";
+        GenerationParameters generation;
         std::string apiUrl = "https://dashscope.aliyuncs.com/api/v1/services/aigc/multimodal-generation/generation";
         int maxRetries = 3;
-        int timeoutSeconds = 30;
+        int timeoutSeconds = 30;            // Connect and each send/receive of a request
+        int preprocessThreads = 0;          // Image preprocessing workers, 0 = one per hardware thread
+        int preprocessQueueCapacity = 0;    // Jobs queued ahead of the workers, 0 = 2 * preprocessThreads
+        int connectionPoolSize = 4;         // Keep-alive connections per host (blocking requests in flight at once)
+        int connectionIdleSeconds = 50;     // Idle connections older than this are reopened rather than reused
+        bool prewarmConnections = false;    // Open and handshake the connections submitted requests go out on,
+                                            // in the background on construction
+        int maxInFlight = 8;                // Submitted requests in flight at once; the default transport keeps
+                                            // at least this many connections
     };
 
     struct APIResponse {
@@ -22,26 +47,118 @@ public:
         std::string content;
         std::string errorMessage;
         int statusCode = 0;
+        bool connectionReused = false;  // Sent over a connection an earlier request had opened (no TCP/TLS handshake)
         
         // Default constructor
         APIResponse() = default;
     };
 
+    // One image in a request body: the base64 payload plus optional per-image fields
+    struct RequestImage {
+        const std::string* base64Payload = nullptr;
+        std::string mimeType = "image/jpeg";
+        int minPixels = 0;          // Sent as min_pixels/max_pixels when both are set
+        int maxPixels = 0;
+        int estimatedTokens = 0;    // For accounting only
+    };
+
+    // Immutable request body, built once and shared by retries and duplicate sends
+    typedef std::shared_ptr<const std::string> SharedRequestBody;
+
+    // Copy accounting for request assembly
+    struct PayloadStatistics {
+        uint64_t requestsBuilt = 0;
+        uint64_t sendAttempts = 0;
+        uint64_t bodyBytes = 0;
+        uint64_t bytesCopied = 0;   // Image payload bytes copied while assembling bodies
+        uint64_t imageTokens = 0;   // Estimated image tokens over all bodies built
+    };
+
+    // Capture-to-payload latency of raw framebuffer dumps against the same frames as PNG
+    struct RawIngestionBenchmark {
+        int imageCount = 0;
+        int iterations = 0;
+        double rawMs = 0.0;         // Mean per frame: wrap, resize, convert, encode, base64
+        double pngMs = 0.0;         // Mean per frame: PNG decode, resize, encode, base64
+        uint64_t rawBytes = 0;      // Capture sizes over all frames (what has to come off the device)
+        uint64_t pngBytes = 0;
+    };
+
     // Constructors
     QwenAPI() = default; // Default constructor
-    explicit QwenAPI(const APIConfig& config);
+    explicit QwenAPI(const APIConfig& config, std::shared_ptr<HttpTransport> transport = nullptr);
 
     // Main interface functions
     APIResponse sendImageQuery(const std::string& imagePath, const std::string& prompt);
     APIResponse sendImageQuery(const std::vector<std::string>& imagePaths, const std::string& prompt);
+    APIResponse sendImageQuery(const ImageContext& context, const std::string& prompt);
+
+    // Build a request body once; send it (with retries) as many times as needed
+    SharedRequestBody buildRequestBody(const ImageContext& context, const std::string& prompt);
+    SharedRequestBody buildRequestBody(const std::vector<RequestImage>& images, const std::string& prompt);
+    APIResponse sendRequestBody(const SharedRequestBody& requestBody);
+
+    // Non-blocking counterparts: up to maxInFlight requests are in flight at once on a few transport
+    // threads, the rest wait in order. Retries follow the same policy as the blocking calls. The callback
+    // runs on a transport thread and must not block; the context is only read during the call.
+    typedef std::function<void(const APIResponse&)> ResponseCallback;
+    void submitImageQuery(const ImageContext& context, const std::string& prompt, ResponseCallback done);
+    std::future<APIResponse> submitImageQuery(const ImageContext& context, const std::string& prompt);
+    void submitRequestBody(const SharedRequestBody& requestBody, ResponseCallback done);
+    std::future<APIResponse> submitRequestBody(const SharedRequestBody& requestBody);
+    void setMaxInFlight(int maxInFlight);
+    int getMaxInFlight() const;
+    void waitForSubmitted();    // Blocks until every submitted request has completed
+
+    // Prepare an image context on the preprocessing pool, so decode/resize/encode overlaps with requests in flight
+    std::future<ImageContext> prepareImageContextAsync(const std::string& imagePath,
+        const ImagePreprocessOptions& options = ImagePreprocessOptions());
+    // Same, handing the context to done on the preprocessing thread (which may take it over); waits while the
+    // pool's queue is full, so not for transport callbacks
+    typedef std::function<void(ImageContext& context)> ContextCallback;
+    void prepareImageContextAsync(const std::string& imagePath, const ImagePreprocessOptions& options, ContextCallback done);
+    void setPreprocessThreads(int threadCount);  // Takes effect when the pool is next created
+    size_t preprocessThreadCount();
+    void logPreprocessStatistics();
+
+    PayloadStatistics getPayloadStatistics() const;
+    void logPayloadStatistics() const;
+
+    // HTTP client for all requests: the platform default (created on first use) unless one is injected,
+    // e.g. to target a local mock server together with an http:// apiUrl
+    void setTransport(std::shared_ptr<HttpTransport> transport);
+    void setApiUrl(const std::string& apiUrl) { config_.apiUrl = apiUrl; }
+    std::string getApiUrl() const { return config_.apiUrl; }
+    void setTimeout(int timeoutSeconds) { config_.timeoutSeconds = timeoutSeconds; }
+
+    // Keep-alive connections to the API host, shared by all requests
+    void setConnectionPool(int size, int idleSeconds);  // Takes effect when the default transport is next created
+    int prewarmConnections(int count = 0);              // 0 = all of the transport's; returns the connections warmed
+    HttpTransport::Statistics getConnectionStatistics();
+    void logConnectionStatistics();     // With the request engine's, once anything was submitted
     
     // Add API key setting method
     void setApiKey(const std::string& apiKey) { config_.apiKey = apiKey; }
     std::string getApiKey() const { return config_.apiKey; }
+    void setModel(const std::string& model) { config_.model = model; }
+    std::string getModel() const { return config_.model; }
+    void setGenerationParameters(const GenerationParameters& generation) { config_.generation = generation; }
 
     // Utility functions
+    static bool prepareImageContext(const std::string& imagePath, ImageContext& context,
+        const ImagePreprocessOptions& options = ImagePreprocessOptions());  // Decode once, fill size/scale/payload
+    // Same, for an image already in memory, e.g. a raw framebuffer read from a screencap pipe with
+    // RawFramebuffer::read; sourceName is only used for logging
+    static bool prepareImageContext(const std::vector<unsigned char>& imageBytes, const std::string& sourceName,
+        ImageContext& context, const ImagePreprocessOptions& options = ImagePreprocessOptions());
+    // Payload preparation from raw framebuffer dumps vs PNG encodes of the same frames (from memory, no cache)
+    static RawIngestionBenchmark benchmarkRawIngestion(const std::vector<std::string>& rawPaths,
+        const ImagePreprocessOptions& options = ImagePreprocessOptions(), int iterations = 10);
     static std::string encodeImageToBase64(const std::string& imagePath);
     static std::string scaleImage(const std::string& imagePath);
+    static bool scaleImage(const std::string& imagePath, ImageContext& context,
+        const ImagePreprocessOptions& options = ImagePreprocessOptions());
+    static ImageCache& imageCache();  // Shared on-disk payload cache used by prepareImageContext
     static std::string base64Encode(const std::string& data);
     static bool validateApiKey(const std::string& apiKey);
     
@@ -55,11 +172,45 @@ public:
 private:
     APIConfig config_;
 
+    // Payload copy counters (see PayloadStatistics)
+    std::atomic<uint64_t> requestsBuilt_{ 0 };
+    std::atomic<uint64_t> sendAttempts_{ 0 };
+    std::atomic<uint64_t> bodyBytes_{ 0 };
+    std::atomic<uint64_t> bytesCopied_{ 0 };
+    std::atomic<uint64_t> imageTokens_{ 0 };
+
+    // Preprocessing worker pool, created on first use
+    std::unique_ptr<WorkerPool> preprocessPool_;
+    std::mutex preprocessPoolMutex_;
+    WorkerPool& preprocessPool();
+
+    // HTTP transport; requests hold a reference so it can be replaced mid-flight
+    std::shared_ptr<HttpTransport> transport_;
+    bool transportInjected_ = false;    // setConnectionPool leaves an injected transport alone
+    int transportConnections_ = 0;      // Connections the default transport was created with
+    mutable std::mutex transportMutex_;  // Also guards config_.maxInFlight, which setMaxInFlight changes under both locks
+    std::shared_ptr<HttpTransport> transport();
+    std::future<int> prewarm_;      // Background pre-warm from the config; declared after the transport so it is joined first
+
+    // Request engine for submitted requests, created on first use; declared last so it drains, and its
+    // callbacks stop touching this object, before anything else is destroyed
+    std::mutex requestEngineMutex_;
+    std::unique_ptr<RequestEngine> requestEngine_;
+    RequestEngine& requestEngine();
+
     // Internal helper functions
-    std::string constructRequestBody(const std::vector<std::string>& base64Images, const std::string& prompt);
+    static bool prepareLoadedImage(const std::vector<unsigned char>& binaryData, const std::string& imagePath,
+        ImageContext& context, const ImagePreprocessOptions& options);
+    static bool scaleImage(const std::vector<unsigned char>& fileBytes, const std::string& imagePath, ImageContext& context,
+        const ImagePreprocessOptions& options);
+    std::string constructRequestBody(const std::vector<RequestImage>& images, const std::string& prompt);
+    static RequestImage toRequestImage(const ImageContext& context);
+    HttpRequest apiRequest(const std::string* requestBody) const;    // POST to apiUrl with the API headers
     APIResponse sendHttpRequest(const std::string& requestBody);
     APIResponse processResponse(const std::string& response, int statusCode);
+    APIResponse processResponse(const HttpResponse& response);     // Transport errors included
 
     // Retry mechanism
     APIResponse executeWithRetry(const std::function<APIResponse()>& operation);
+    int retryDelayMs(const APIResponse& response, int attempt) const;   // -1: no further attempt
 };
\ No newline at end of file
@@ -0,0 +1,94 @@
+#include "RawFramebuffer.h"
+#include <cstdint>
+
+#include <opencv2/imgproc.hpp>
+
+namespace {
+	const int kMaxSide = 16384;
+
+	uint32_t readLE32(const unsigned char* p) {
+		return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+	}
+}
+
+int RawFramebuffer::bytesPerPixel(PixelFormat format) {
+	switch (format) {
+	case PixelFormat::RGBA_8888:
+	case PixelFormat::RGBX_8888:
+	case PixelFormat::BGRA_8888:
+		return 4;
+	case PixelFormat::RGB_888: return 3;
+	case PixelFormat::RGB_565: return 2;
+	default: return 0;
+	}
+}
+
+bool RawFramebuffer::parseHeader(const unsigned char* data, size_t size, Header& header) {
+	header = Header();
+	if (!data || size < 12) {
+		return false;
+	}
+
+	uint32_t width = readLE32(data);
+	uint32_t height = readLE32(data + 4);
+	PixelFormat format = static_cast<PixelFormat>(readLE32(data + 8));
+	int pixelSize = bytesPerPixel(format);
+	if (width == 0 || height == 0 || width > kMaxSide || height > kMaxSide || pixelSize == 0) {
+		return false;
+	}
+
+	// The color space field is only there on newer devices; the total size tells which layout this is
+	size_t pixelBytes = (size_t)width * height * pixelSize;
+	if (size == 12 + pixelBytes) {
+		header.headerSize = 12;
+	}
+	else if (size == 16 + pixelBytes) {
+		header.headerSize = 16;
+	}
+	else {
+		return false;
+	}
+
+	header.width = static_cast<int>(width);
+	header.height = static_cast<int>(height);
+	header.format = format;
+	header.bytesPerPixel = pixelSize;
+	return true;
+}
+
+bool RawFramebuffer::read(std::istream& in, std::vector<unsigned char>& bytes) {
+	const size_t kChunk = 1 << 20;
+	size_t used = 0;
+	while (in) {
+		if (bytes.size() < used + kChunk) {
+			bytes.resize(used + kChunk);
+		}
+		in.read(reinterpret_cast<char*>(bytes.data() + used), kChunk);
+		used += static_cast<size_t>(in.gcount());
+	}
+	bytes.resize(used);
+
+	Header header;
+	return parseHeader(bytes.data(), bytes.size(), header);
+}
+
+bool RawFramebuffer::wrap(const std::vector<unsigned char>& bytes, cv::Mat& pixels, Header& header) {
+	if (!parseHeader(bytes.data(), bytes.size(), header)) {
+		return false;
+	}
+	int type = header.bytesPerPixel == 4 ? CV_8UC4 : (header.bytesPerPixel == 3 ? CV_8UC3 : CV_8UC2);
+	// Only read from; cv::Mat has no constructor taking const data
+	pixels = cv::Mat(header.height, header.width, type, const_cast<unsigned char*>(bytes.data()) + header.headerSize);
+	return true;
+}
+
+int RawFramebuffer::toBGRConversion(PixelFormat format) {
+	switch (format) {
+	case PixelFormat::RGBA_8888:
+	case PixelFormat::RGBX_8888:
+		return cv::COLOR_RGBA2BGR;
+	case PixelFormat::BGRA_8888: return cv::COLOR_BGRA2BGR;
+	case PixelFormat::RGB_888: return cv::COLOR_RGB2BGR;
+	default: return -1;
+	}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Raw framebuffer dumps as written by Android's `screencap` without -p (to a file, or to a pipe through
+// `adb exec-out screencap`): little-endian uint32 width, height and pixel format, plus a uint32 color space
+// since Android 9, then the unpadded rows. Wrapping the rows in a cv::Mat skips both the PNG encode on the
+// device and the decode here; the pipeline resizes straight out of the buffer the dump was read into.
+// No Win32 dependency, so dumps can be checked on Linux as well.
+class RawFramebuffer {
+public:
+    // HAL pixel formats screencap writes
+    enum class PixelFormat {
+        Unknown = 0,
+        RGBA_8888 = 1,
+        RGBX_8888 = 2,
+        RGB_888 = 3,
+        RGB_565 = 4,
+        BGRA_8888 = 5
+    };
+
+    struct Header {
+        int width = 0;
+        int height = 0;
+        PixelFormat format = PixelFormat::Unknown;
+        size_t headerSize = 0;      // 12, or 16 with the color space field
+        int bytesPerPixel = 0;
+
+        size_t pixelBytes() const { return (size_t)width * height * bytesPerPixel; }
+    };
+
+    // Header of a dump of exactly size bytes. False unless header and pixel data add up to size, which
+    // keeps PNG/JPEG/BMP/WebP files from being taken for dumps.
+    static bool parseHeader(const unsigned char* data, size_t size, Header& header);
+
+    // Reads a stream holding one dump (a file, or the pipe of one `adb exec-out screencap` run) to its end
+    // and checks it with parseHeader. Reuses the capacity of bytes.
+    static bool read(std::istream& in, std::vector<unsigned char>& bytes);
+
+    // cv::Mat over the pixels inside bytes without copying: CV_8UC4, CV_8UC3, or CV_8UC2 for RGB_565.
+    // Valid as long as bytes is neither freed nor resized.
+    static bool wrap(const std::vector<unsigned char>& bytes, cv::Mat& pixels, Header& header);
+
+    // cv::cvtColor code that turns a (resized) wrapped image into BGR; -1 for RGB_565, which has to be
+    // converted before resizing since its channels are packed
+    static int toBGRConversion(PixelFormat format);
+
+    static int bytesPerPixel(PixelFormat format);
+};
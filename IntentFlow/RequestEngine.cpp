@@ -0,0 +1,140 @@
+#include "RequestEngine.h"
+#include <iostream>
+#include <algorithm>
+
+RequestEngine::RequestEngine(int maxInFlight) : maxInFlight_((std::max)(1, maxInFlight)) {
+	dispatcher_ = std::thread(&RequestEngine::dispatchLoop, this);
+}
+
+RequestEngine::~RequestEngine() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_all();
+	// The dispatcher only exits once every job has delivered its completion
+	dispatcher_.join();
+}
+
+void RequestEngine::submit(std::shared_ptr<HttpTransport> transport, const HttpRequest& request,
+	std::shared_ptr<const std::string> body, HttpTransport::Completion done, RetryPolicy retry) {
+	std::unique_ptr<Job> job(new Job());
+	job->transport = std::move(transport);
+	job->request = request;
+	job->body = std::move(body);
+	job->request.body = job->body.get();
+	job->done = std::move(done);
+	job->retry = std::move(retry);
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		queue_.push_back(std::move(job));
+		stats_.submitted++;
+		stats_.maxQueueDepth = (std::max)(stats_.maxQueueDepth, queue_.size());
+	}
+	wake_.notify_one();
+}
+
+void RequestEngine::dispatchLoop() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	for (;;) {
+		// Jobs are destroyed here rather than on the transport thread that completed them: the last reference
+		// to a replaced transport may go with them, and a transport cannot be destroyed from its own thread
+		if (!retired_.empty()) {
+			std::vector<std::unique_ptr<Job>> retired;
+			retired.swap(retired_);
+			lock.unlock();
+			retired.clear();
+			lock.lock();
+			continue;
+		}
+
+		// Retries whose backoff has passed go ahead of the queue: they were submitted first
+		auto now = std::chrono::steady_clock::now();
+		auto nextRetry = std::chrono::steady_clock::time_point::max();
+		for (size_t i = 0; i < delayed_.size();) {
+			if (delayed_[i]->readyAt <= now) {
+				queue_.push_front(std::move(delayed_[i]));
+				delayed_.erase(delayed_.begin() + i);
+			}
+			else {
+				nextRetry = (std::min)(nextRetry, delayed_[i]->readyAt);
+				++i;
+			}
+		}
+
+		if (!queue_.empty() && static_cast<int>(running_.size()) < maxInFlight_) {
+			Job* job = queue_.front().get();
+			running_[job] = std::move(queue_.front());
+			queue_.pop_front();
+			stats_.maxInFlight = (std::max)(stats_.maxInFlight, static_cast<int>(running_.size()));
+			lock.unlock();
+			job->transport->sendAsync(job->request, [this, job](HttpResponse& response) { onResponse(job, response); });
+			lock.lock();
+			continue;
+		}
+
+		if (stopping_ && idleLocked()) {
+			break;
+		}
+		if (nextRetry != std::chrono::steady_clock::time_point::max()) {
+			wake_.wait_until(lock, nextRetry);
+		}
+		else {
+			wake_.wait(lock);
+		}
+	}
+}
+
+void RequestEngine::onResponse(Job* job, HttpResponse& response) {
+	int delayMs = job->retry ? job->retry(response, job->attempt) : -1;
+	if (delayMs >= 0) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		std::unique_ptr<Job> owned = std::move(running_[job]);
+		running_.erase(job);
+		owned->attempt++;
+		owned->readyAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(delayMs);
+		delayed_.push_back(std::move(owned));
+		stats_.retries++;
+		wake_.notify_one();
+		return;
+	}
+
+	job->done(response);
+
+	// Notify under the lock: waitIdle() or the destructor may return as soon as the job is gone
+	std::lock_guard<std::mutex> lock(mutex_);
+	retired_.push_back(std::move(running_[job]));
+	running_.erase(job);
+	stats_.completed++;
+	wake_.notify_one();
+	idle_.notify_all();
+}
+
+void RequestEngine::waitIdle() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	idle_.wait(lock, [this]() { return idleLocked(); });
+}
+
+void RequestEngine::setMaxInFlight(int maxInFlight) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		maxInFlight_ = (std::max)(1, maxInFlight);
+	}
+	wake_.notify_one();
+}
+
+int RequestEngine::maxInFlight() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return maxInFlight_;
+}
+
+RequestEngine::Statistics RequestEngine::getStatistics() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
+
+void RequestEngine::logStatistics() const {
+	Statistics stats = getStatistics();
+	std::wcout << L"[RequestEngine] Requests: " << stats.completed << L"/" << stats.submitted << L", retries: " << stats.retries
+		<< L", max in flight: " << stats.maxInFlight << L" of " << maxInFlight() << L", max queue depth: " << stats.maxQueueDepth << std::endl;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include "HttpTransport.h"
+#include <deque>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+// Keeps up to maxInFlight asynchronous requests in flight and queues the rest, so a batch costs about
+// requests / maxInFlight round trips instead of one per request. One dispatcher thread starts requests as
+// slots free up and holds retries until their backoff has passed; the transport multiplexes the requests
+// in flight, and completions run on its threads.
+class RequestEngine {
+public:
+    struct Statistics {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;     // Completions delivered, after any retries
+        uint64_t retries = 0;
+        int maxInFlight = 0;        // Most requests in flight at once
+        size_t maxQueueDepth = 0;   // Most requests waiting for a slot
+    };
+
+    // Given the response of an attempt (0 = the first), the delay in ms before the next attempt, or a
+    // negative value to deliver this response
+    typedef std::function<int(const HttpResponse& response, int attempt)> RetryPolicy;
+
+    explicit RequestEngine(int maxInFlight);
+    ~RequestEngine();   // Waits for everything submitted, retries included, to complete
+
+    RequestEngine(const RequestEngine&) = delete;
+    RequestEngine& operator=(const RequestEngine&) = delete;
+
+    // Queues request for transport, which is kept alive until the last attempt finishes. request.body is
+    // replaced by body, shared by all attempts.
+    void submit(std::shared_ptr<HttpTransport> transport, const HttpRequest& request,
+                std::shared_ptr<const std::string> body, HttpTransport::Completion done,
+                RetryPolicy retry = RetryPolicy());
+
+    // Blocks until nothing is queued, waiting out a backoff or in flight
+    void waitIdle();
+
+    void setMaxInFlight(int maxInFlight);   // Applies as slots free up
+    int maxInFlight() const;
+    Statistics getStatistics() const;
+    void logStatistics() const;
+
+private:
+    struct Job {
+        std::shared_ptr<HttpTransport> transport;
+        HttpRequest request;
+        std::shared_ptr<const std::string> body;
+        HttpTransport::Completion done;
+        RetryPolicy retry;
+        int attempt = 0;
+        std::chrono::steady_clock::time_point readyAt;
+    };
+
+    void dispatchLoop();
+    void onResponse(Job* job, HttpResponse& response);
+    bool idleLocked() const { return queue_.empty() && delayed_.empty() && running_.empty(); }
+
+    std::deque<std::unique_ptr<Job>> queue_;            // Waiting for a slot, in submission order
+    std::vector<std::unique_ptr<Job>> delayed_;         // Retries waiting out their backoff
+    std::map<Job*, std::unique_ptr<Job>> running_;      // In flight
+    std::vector<std::unique_ptr<Job>> retired_;         // Released on the dispatcher thread, never a transport's own
+    int maxInFlight_;
+    bool stopping_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    Statistics stats_;
+    std::thread dispatcher_;    // Last, so it starts after everything it uses
+};
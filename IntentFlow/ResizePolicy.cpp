@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "ResizePolicy.h"
+#include <cmath>
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+	int clampInt(int value, int low, int high) {
+		return value < low ? low : (value > high ? high : value);
+	}
+
+	// Long side to targetSize, short side scaled by the same factor (at least 1 pixel)
+	void fitLongSide(int width, int height, int targetSize, int& fitWidth, int& fitHeight) {
+		if (width >= height) {
+			fitWidth = targetSize;
+			fitHeight = (int)std::lround((double)height * targetSize / width);
+		}
+		else {
+			fitHeight = targetSize;
+			fitWidth = (int)std::lround((double)width * targetSize / height);
+		}
+		if (fitWidth < 1) fitWidth = 1;
+		if (fitHeight < 1) fitHeight = 1;
+	}
+
+	// Original Stretch mapping: float factor, truncated toward zero
+	int truncatedScale(int value, int to, int from) {
+		return static_cast<int>(value * ((float)to / from));
+	}
+}
+
+int ImageTransform::toCanvasX(int x) const {
+	if (mode == ResizeMode::Stretch) {
+		return offsetX + truncatedScale(x - sourceX, contentWidth, sourceWidth);
+	}
+	return offsetX + (int)std::lround((x - sourceX) * scaleX());
+}
+
+int ImageTransform::toCanvasY(int y) const {
+	if (mode == ResizeMode::Stretch) {
+		return offsetY + truncatedScale(y - sourceY, contentHeight, sourceHeight);
+	}
+	return offsetY + (int)std::lround((y - sourceY) * scaleY());
+}
+
+int ImageTransform::toOriginalX(int x) const {
+	if (mode == ResizeMode::Stretch) {
+		return sourceX + truncatedScale(x - offsetX, sourceWidth, contentWidth);
+	}
+	return clampInt(sourceX + (int)std::lround((x - offsetX) / scaleX()), 0, originalWidth);
+}
+
+int ImageTransform::toOriginalY(int y) const {
+	if (mode == ResizeMode::Stretch) {
+		return sourceY + truncatedScale(y - offsetY, sourceHeight, contentHeight);
+	}
+	return clampInt(sourceY + (int)std::lround((y - offsetY) / scaleY()), 0, originalHeight);
+}
+
+ImageTransform ResizePolicy::plan(int originalWidth, int originalHeight, const ImageRegion& region) const {
+	ImageTransform transform;
+	if (originalWidth <= 0 || originalHeight <= 0 || targetSize <= 0) {
+		return transform;
+	}
+
+	transform.mode = mode;
+	transform.originalWidth = originalWidth;
+	transform.originalHeight = originalHeight;
+	transform.sourceWidth = originalWidth;
+	transform.sourceHeight = originalHeight;
+	if (!region.isEmpty()) {
+		transform.sourceX = clampInt(region.x, 0, originalWidth - 1);
+		transform.sourceY = clampInt(region.y, 0, originalHeight - 1);
+		transform.sourceWidth = clampInt(region.width, 1, originalWidth - transform.sourceX);
+		transform.sourceHeight = clampInt(region.height, 1, originalHeight - transform.sourceY);
+	}
+	const int sourceWidth = transform.sourceWidth;
+	const int sourceHeight = transform.sourceHeight;
+
+	switch (mode) {
+	case ResizeMode::Stretch:
+		transform.contentWidth = targetSize;
+		transform.contentHeight = targetSize;
+		break;
+	case ResizeMode::Letterbox:
+	case ResizeMode::Fit:
+		fitLongSide(sourceWidth, sourceHeight, targetSize, transform.contentWidth, transform.contentHeight);
+		break;
+	case ResizeMode::PatchGrid:
+		// Pick the size the server would pick, so it has nothing left to resize
+		snapToPatchGrid(sourceWidth, sourceHeight, patchSize, minPixels(), maxPixels(),
+			transform.contentWidth, transform.contentHeight);
+		break;
+	}
+
+	if (mode == ResizeMode::Letterbox) {
+		// Center the content on a square canvas
+		transform.canvasWidth = targetSize;
+		transform.canvasHeight = targetSize;
+		transform.offsetX = (targetSize - transform.contentWidth) / 2;
+		transform.offsetY = (targetSize - transform.contentHeight) / 2;
+	}
+	else {
+		transform.canvasWidth = transform.contentWidth;
+		transform.canvasHeight = transform.contentHeight;
+	}
+	return transform;
+}
+
+std::string AdaptiveResolution::toString() const {
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.3g-%.3g-%d-%d", sparseDensity, denseDensity, minTokens, maxTokens);
+	return buffer;
+}
+
+ResizePolicy ResizePolicy::adaptToDensity(double density, const AdaptiveResolution& adaptive, int sourceWidth, int sourceHeight) const {
+	ResizePolicy adapted = *this;
+	if (sourceWidth <= 0 || sourceHeight <= 0 || patchSize <= 0) {
+		return adapted;
+	}
+
+	// Linear in density between the two thresholds
+	double t = adaptive.denseDensity > adaptive.sparseDensity ?
+		(density - adaptive.sparseDensity) / (adaptive.denseDensity - adaptive.sparseDensity) : 1.0;
+	t = (std::max)(0.0, (std::min)(1.0, t));
+	int tokens = (int)std::lround(adaptive.minTokens + t * (adaptive.maxTokens - adaptive.minTokens));
+	tokens = (std::max)(1, (std::min)(tokens, maxTokens));
+
+	if (mode == ResizeMode::PatchGrid) {
+		adapted.maxTokens = tokens;
+		adapted.minTokens = (std::min)(minTokens, tokens);
+		return adapted;
+	}
+
+	// Stretch and Letterbox send a square canvas, Fit the source's aspect ratio; neither upscales
+	const double pixels = (double)tokens * patchSize * patchSize;
+	const int longSide = (std::max)(sourceWidth, sourceHeight);
+	int size = mode == ResizeMode::Fit ?
+		(int)std::lround(longSide * std::sqrt(pixels / ((double)sourceWidth * sourceHeight))) :
+		(int)std::lround(std::sqrt(pixels));
+	adapted.targetSize = (std::max)(patchSize, (std::min)(size, longSide));
+	return adapted;
+}
+
+int ResizePolicy::estimateTokens(const ImageTransform& transform) const {
+	if (transform.canvasWidth <= 0 || transform.canvasHeight <= 0 || patchSize <= 0) {
+		return 0;
+	}
+	int gridWidth = 0, gridHeight = 0;
+	snapToPatchGrid(transform.canvasWidth, transform.canvasHeight, patchSize, minPixels(), maxPixels(), gridWidth, gridHeight);
+	return (gridWidth / patchSize) * (gridHeight / patchSize);
+}
+
+void ResizePolicy::snapToPatchGrid(int width, int height, int patchSize, int minPixels, int maxPixels,
+	int& gridWidth, int& gridHeight) {
+	const double patch = patchSize;
+	gridWidth = (std::max)(patchSize, (int)std::lround(width / patch) * patchSize);
+	gridHeight = (std::max)(patchSize, (int)std::lround(height / patch) * patchSize);
+
+	if ((double)gridWidth * gridHeight > maxPixels) {
+		double beta = std::sqrt((double)width * height / maxPixels);
+		gridWidth = (std::max)(patchSize, (int)std::floor(width / beta / patch) * patchSize);
+		gridHeight = (std::max)(patchSize, (int)std::floor(height / beta / patch) * patchSize);
+	}
+	else if ((double)gridWidth * gridHeight < minPixels) {
+		double beta = std::sqrt((double)minPixels / ((double)width * height));
+		gridWidth = (int)std::ceil(width * beta / patch) * patchSize;
+		gridHeight = (int)std::ceil(height * beta / patch) * patchSize;
+	}
+}
+
+std::string ResizePolicy::toString() const {
+	switch (mode) {
+	case ResizeMode::Letterbox: return "l" + std::to_string(targetSize);
+	case ResizeMode::Fit: return "f" + std::to_string(targetSize);
+	case ResizeMode::PatchGrid:
+		return "p" + std::to_string(patchSize) + "-" + std::to_string(minTokens) + "-" + std::to_string(maxTokens);
+	default: return "s" + std::to_string(targetSize);
+	}
+}
+
+std::string ResizePolicy::describeForPrompt(const ImageTransform& transform) {
+	std::string size = std::to_string(transform.canvasWidth) + "x" + std::to_string(transform.canvasHeight);
+	std::string description = transform.isCropped() ?
+		"The input image is a region of the screen, resized to " + size + " pixels for processing" :
+		"The input image has been resized to " + size + " pixels for processing";
+	if (transform.isPadded()) {
+		description += " (aspect ratio kept, screenshot placed at offset " + std::to_string(transform.offsetX) + "," +
+			std::to_string(transform.offsetY) + " with size " + std::to_string(transform.contentWidth) + "x" +
+			std::to_string(transform.contentHeight) + ", the rest is black padding)";
+	}
+	return description + ". ";
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <string>
+
+// How a screenshot is fitted onto the canvas sent to the model
+enum class ResizeMode {
+    Stretch,    // Scale each axis independently to targetSize x targetSize (aspect ratio not kept)
+    Letterbox,  // Keep aspect ratio with the long side at targetSize, pad to a targetSize x targetSize canvas
+    Fit,        // Keep aspect ratio with the long side at targetSize, no padding (smallest payload)
+    PatchGrid   // Keep aspect ratio, both sides multiples of patchSize, token count within [minTokens, maxTokens]
+};
+
+// Rectangle in original image coordinates; empty means the whole image
+struct ImageRegion {
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    bool isEmpty() const { return width <= 0 || height <= 0; }
+};
+
+// Placement of one image on the model canvas.
+// Forward (original -> canvas) and inverse (canvas -> original) use the same content size and offsets
+// that the resize actually produced, so a round trip is exact up to rounding to whole pixels.
+struct ImageTransform {
+    int originalWidth = 0;
+    int originalHeight = 0;
+
+    // Part of the original that is resized onto the canvas (the whole image unless cropped)
+    int sourceX = 0;
+    int sourceY = 0;
+    int sourceWidth = 0;
+    int sourceHeight = 0;
+
+    // Image sent to the model
+    int canvasWidth = 0;
+    int canvasHeight = 0;
+
+    // Resized screenshot inside the canvas; the rest is padding
+    int contentWidth = 0;
+    int contentHeight = 0;
+    int offsetX = 0;
+    int offsetY = 0;
+
+    // Policy that planned it. Stretch keeps the original float mapping, truncated and unclamped, so the
+    // default policy maps coordinates exactly as before; the other modes round to the nearest pixel.
+    ResizeMode mode = ResizeMode::Stretch;
+
+    bool isValid() const {
+        return originalWidth > 0 && originalHeight > 0 && sourceWidth > 0 && sourceHeight > 0 && contentWidth > 0 && contentHeight > 0;
+    }
+    bool isPadded() const { return canvasWidth != contentWidth || canvasHeight != contentHeight; }
+    bool isCropped() const { return sourceWidth != originalWidth || sourceHeight != originalHeight; }
+
+    // Scale factors (content / source)
+    double scaleX() const { return (double)contentWidth / sourceWidth; }
+    double scaleY() const { return (double)contentHeight / sourceHeight; }
+
+    // Original image coordinates -> canvas coordinates
+    int toCanvasX(int x) const;
+    int toCanvasY(int y) const;
+
+    // Canvas coordinates -> original image coordinates, clamped to the image except under Stretch (padding
+    // maps to the nearest edge; a cropped canvas only covers the source region)
+    int toOriginalX(int x) const;
+    int toOriginalY(int y) const;
+};
+
+// Per-image canvas size picked from how busy the screenshot is: sparse screens (settings pages, dialogs)
+// are sent smaller, dense ones (text feeds) larger, never above the token budget
+struct AdaptiveResolution {
+    bool enabled = false;
+    double sparseDensity = 0.03;    // Edge density at or below which minTokens is used
+    double denseDensity = 0.15;     // Edge density at or above which maxTokens is used
+    int minTokens = 256;
+    int maxTokens = 1280;           // Token budget per image
+
+    // Compact textual form for cache keys, e.g. "0.03-0.15-256-1280"
+    std::string toString() const;
+};
+
+// Single source of the model input geometry: the resize stage, prompts, question rewriting and answer
+// rescaling all go through the transform planned here
+struct ResizePolicy {
+    ResizeMode mode = ResizeMode::Stretch;
+    int targetSize = 960;   // Canvas side for Stretch/Letterbox, long side for Fit (unused by PatchGrid)
+
+    // Vision token grid of the VL model: one token per patchSize x patchSize block
+    // (14 px ViT patches merged 2x2). The defaults match the server's own bounds for qwen-vl-max.
+    int patchSize = 28;
+    int minTokens = 4;
+    int maxTokens = 1280;           // Token budget per image
+    bool sendPixelBounds = false;   // Send min_pixels/max_pixels with each image so the server keeps our size
+
+    int minPixels() const { return minTokens * patchSize * patchSize; }
+    int maxPixels() const { return maxTokens * patchSize * patchSize; }
+
+    // Geometry for the whole image, or for the region of it (clamped to the image) when one is given
+    ImageTransform plan(int originalWidth, int originalHeight, const ImageRegion& region = ImageRegion()) const;
+
+    // This policy with its size scaled for a source of the given edge density: about the interpolated token
+    // count (capped by maxTokens), without upscaling the source
+    ResizePolicy adaptToDensity(double density, const AdaptiveResolution& adaptive, int sourceWidth, int sourceHeight) const;
+
+    // Image tokens the model will spend on this canvas, after the server's own patch-grid resize
+    int estimateTokens(const ImageTransform& transform) const;
+
+    // The model's resize rule: round both sides to multiples of patchSize, then scale (keeping aspect ratio)
+    // into [minPixels, maxPixels]
+    static void snapToPatchGrid(int width, int height, int patchSize, int minPixels, int maxPixels,
+        int& gridWidth, int& gridHeight);
+
+    // Compact textual form for cache keys, e.g. "s960", "l960", "f960", "p28-4-1280"
+    std::string toString() const;
+
+    // Sentence telling the model what image it is looking at and which coordinate space to answer in
+    static std::string describeForPrompt(const ImageTransform& transform);
+};
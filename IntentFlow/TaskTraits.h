@@ -0,0 +1,130 @@
+#pragma once
+#include <string>
+
+// Benchmark task types. The names ("gui_grounding", ...) are only parsed at the public entry points;
+// internally tasks carry a TaskKind and everything that differs between types comes from TaskTraits.
+enum class TaskKind {
+    Grounding,
+    Referring,
+    VQA
+};
+
+// Per task type policy: names and data locations, the fixed prompt text, and which pipeline stages apply.
+// A new task type is a TaskKind, a specialization here, a case in visitTaskKind, and its
+// GUITaskProcessor::parseResult specialization.
+template <TaskKind Kind> struct TaskTraits;
+
+template <> struct TaskTraits<TaskKind::Grounding> {
+    static const TaskKind kind = TaskKind::Grounding;
+    static const char* name() { return "gui_grounding"; }
+    static const char* folder() { return "GUI_Grounding"; }        // test\<folder>\<folder>.json, images in test\<folder>\image
+    static const char* resultFile() { return "gui_grounding_result.json"; }
+
+    static const bool mapsQuestionBox = false;  // Box in the question is mapped onto the canvas
+    static const bool boxAnswer = true;         // The answer is just a box
+    static const bool packable = true;          // Several questions per request
+    static const bool refinable = true;         // Answers carry a box a two-pass crop can refine
+    static const bool tileable = true;          // Elongated screenshots can be asked tile by tile
+    static const bool croppable = false;        // Question box can be asked on a crop around it
+
+    static const char* role() { return "You are an expert in GUI understanding. "; }
+    static const char* instruction() { return "Please identify the coordinates of the UI component mentioned in the question. "; }
+    static const char* answerFormat() { return "Return only the coordinates in the format [x1,y1,x2,y2] or [x,y], nothing else. "; }
+    static const char* coordinateNote() { return "Note that the coordinates should be based on "; }
+    static const char* packedInstruction() { return "Please identify the coordinates of the UI component mentioned in each of the following "; }
+    static const char* packedInstructionEnd() { return " questions. "; }
+    static const char* packedItemFormat() { return "Each string is the coordinates in the format [x1,y1,x2,y2] or [x,y]. "; }
+};
+
+template <> struct TaskTraits<TaskKind::Referring> {
+    static const TaskKind kind = TaskKind::Referring;
+    static const char* name() { return "gui_referring"; }
+    static const char* folder() { return "GUI_Referring"; }
+    static const char* resultFile() { return "gui_referring_result.json"; }
+
+    static const bool mapsQuestionBox = true;
+    static const bool boxAnswer = false;
+    static const bool packable = false;
+    static const bool refinable = false;
+    static const bool tileable = false;
+    static const bool croppable = true;
+
+    static const char* role() { return "You are an expert in mobile app GUI understanding. "; }
+    static const char* instruction() { return "Please identify and describe the UI component at the specified location. "; }
+    static const char* answerFormat() { return "Return only a brief textual description of the component's function or content, nothing else."; }
+    static const char* coordinateNote() { return nullptr; }     // Answers are text only
+    static const char* packedInstruction() { return nullptr; }
+    static const char* packedInstructionEnd() { return nullptr; }
+    static const char* packedItemFormat() { return nullptr; }
+};
+
+template <> struct TaskTraits<TaskKind::VQA> {
+    static const TaskKind kind = TaskKind::VQA;
+    static const char* name() { return "advanced_vqa"; }
+    static const char* folder() { return "GUI_VQA"; }
+    static const char* resultFile() { return "gui_vqa_result.json"; }
+
+    static const bool mapsQuestionBox = false;
+    static const bool boxAnswer = false;
+    static const bool packable = true;
+    static const bool refinable = true;
+    static const bool tileable = false;
+    static const bool croppable = false;
+
+    static const char* role() { return "You are an expert in mobile app GUI understanding. "; }
+    static const char* instruction() { return "Please answer the question according to the screen information. "; }
+    static const char* answerFormat() { return "Return the answer in the format \"text [x1, y1, x2, y2]\" where the coordinates indicate relevant UI components. "; }
+    static const char* coordinateNote() { return "The coordinates should be based on "; }
+    static const char* packedInstruction() { return "Please answer each of the following "; }
+    static const char* packedInstructionEnd() { return " questions according to the screen information. "; }
+    static const char* packedItemFormat() { return "Each string is in the format \"text [x1, y1, x2, y2]\" where the coordinates indicate relevant UI components. "; }
+};
+
+const TaskKind kTaskKinds[] = { TaskKind::Grounding, TaskKind::Referring, TaskKind::VQA };
+
+// Calls visitor with a TaskTraits<kind> value, so the code in a generic lambda is instantiated once per
+// task type and the only runtime dispatch is this switch
+template <typename Visitor>
+auto visitTaskKind(TaskKind kind, Visitor&& visitor) -> decltype(visitor(TaskTraits<TaskKind::Grounding>())) {
+    switch (kind) {
+    case TaskKind::Referring: return visitor(TaskTraits<TaskKind::Referring>());
+    case TaskKind::VQA: return visitor(TaskTraits<TaskKind::VQA>());
+    default: return visitor(TaskTraits<TaskKind::Grounding>());
+    }
+}
+
+// Runtime view of the traits, for code that handles tasks of several types together
+struct TaskInfo {
+    TaskKind kind;
+    const char* name;
+    const char* folder;
+    const char* resultFile;
+    bool packable;
+    bool refinable;
+    bool tileable;
+    bool croppable;
+};
+
+inline TaskInfo taskInfo(TaskKind kind) {
+    return visitTaskKind(kind, [](auto traits) {
+        typedef decltype(traits) Traits;
+        TaskInfo info = { Traits::kind, Traits::name(), Traits::folder(), Traits::resultFile(),
+            Traits::packable, Traits::refinable, Traits::tileable, Traits::croppable };
+        return info;
+    });
+}
+
+inline bool taskKindFromName(const std::string& name, TaskKind& kind) {
+    for (TaskKind candidate : kTaskKinds) {
+        if (name == taskInfo(candidate).name) {
+            kind = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline std::wstring taskKindName(TaskKind kind) {
+    std::string name = taskInfo(kind).name;
+    return std::wstring(name.begin(), name.end());
+}
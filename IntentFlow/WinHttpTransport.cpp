@@ -0,0 +1,395 @@
+#include "pch.h"
+#include "WinHttpTransport.h"
+#include <iostream>
+#include <algorithm>
+#pragma comment(lib, "winhttp.lib")
+
+namespace {
+	std::wstring widen(const std::string& text) {
+		return std::wstring(text.begin(), text.end());
+	}
+
+	std::string hostKey(const HttpUrl& url) {
+		return (url.secure ? "https://" : "http://") + url.host + ":" + std::to_string(url.port);
+	}
+
+	std::wstring headerBlock(const HttpRequest& request) {
+		std::wstring headers;
+		for (const auto& header : request.headers) {
+			headers += widen(header.first) + L": " + widen(header.second) + L"\r\n";
+		}
+		return headers;
+	}
+}
+
+struct WinHttpTransport::AsyncRequest {
+	WinHttpTransport* transport = nullptr;
+	HINTERNET handle = nullptr;
+	std::wstring headers;
+	HttpResponse response;
+	Completion done;
+	std::vector<char> buffer;
+	bool connected = false;     // WinHTTP opened a socket for this request
+	bool finished = false;
+};
+
+std::shared_ptr<HttpTransport> HttpTransport::createDefault(const Options& options) {
+	return std::make_shared<WinHttpTransport>(options);
+}
+
+WinHttpTransport::WinHttpTransport(const Options& options) : options_(options) {
+}
+
+WinHttpTransport::~WinHttpTransport() {
+	// Completions of the requests still in flight run first; their handles must close before the session
+	std::unique_lock<std::mutex> lock(mutex_);
+	asyncDrained_.wait(lock, [this]() { return asyncInFlight_ == 0; });
+	for (auto& entry : asyncConnects_) {
+		WinHttpCloseHandle(entry.second);
+	}
+	asyncConnects_.clear();
+	if (asyncSession_) {
+		WinHttpCloseHandle(asyncSession_);
+		asyncSession_ = nullptr;
+	}
+}
+
+std::shared_ptr<HttpConnectionPool> WinHttpTransport::poolFor(const HttpUrl& url) {
+	std::string key = hostKey(url);
+	std::lock_guard<std::mutex> lock(mutex_);
+	std::shared_ptr<HttpConnectionPool>& pool = pools_[key];
+	if (!pool) {
+		HttpConnectionPool::Options poolOptions;
+		poolOptions.size = options_.connections;
+		poolOptions.idleTimeoutSeconds = options_.idleTimeoutSeconds;
+		pool = std::make_shared<HttpConnectionPool>(widen(url.host), static_cast<INTERNET_PORT>(url.port), url.secure, poolOptions);
+		std::wcout << L"[WinHttpTransport] Connection pool for " << widen(key) << L": " << pool->options().size
+			<< L" connections, idle timeout " << pool->options().idleTimeoutSeconds << L" s" << std::endl;
+	}
+	return pool;
+}
+
+HttpResponse WinHttpTransport::send(const HttpRequest& request) {
+	HttpResponse response;
+	HttpUrl url;
+	if (!HttpUrl::parse(request.url, url)) {
+		response.errorMessage = "Invalid URL: " + request.url;
+		return response;
+	}
+
+	// Lease a pooled connection; the pool outlives the lease even if the transport goes away meanwhile
+	std::shared_ptr<HttpConnectionPool> pool = poolFor(url);
+	HttpConnectionPool::Lease connection = pool->acquire();
+	HINTERNET hRequest = nullptr;
+
+	do {
+		if (!connection.valid()) {
+			response.errorMessage = "Failed to connect to server";
+			break;
+		}
+
+		// Create request
+		hRequest = WinHttpOpenRequest(connection.connect(), widen(request.method).c_str(),
+			widen(url.path).c_str(),
+			nullptr, WINHTTP_NO_REFERER,
+			WINHTTP_DEFAULT_ACCEPT_TYPES,
+			pool->requestFlags());
+		if (!hRequest) {
+			response.errorMessage = "Failed to create HTTP request";
+			break;
+		}
+
+		if (request.timeoutSeconds > 0) {
+			int timeoutMs = request.timeoutSeconds * 1000;
+			WinHttpSetTimeouts(hRequest, timeoutMs, timeoutMs, timeoutMs, timeoutMs);
+		}
+
+		// Set request headers
+		std::wstring headers = headerBlock(request);
+
+		// Send request with proper headers
+		DWORD bodyLength = request.body ? static_cast<DWORD>(request.body->length()) : 0;
+		if (!WinHttpSendRequest(hRequest,
+			headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : headers.c_str(), static_cast<DWORD>(headers.length()),
+			bodyLength ? (LPVOID)request.body->c_str() : WINHTTP_NO_REQUEST_DATA, bodyLength,
+			bodyLength, connection.context())) {
+			response.errorMessage = "Failed to send HTTP request: " + std::to_string(GetLastError());
+			break;
+		}
+
+		// Receive response
+		if (!WinHttpReceiveResponse(hRequest, NULL)) {
+			response.errorMessage = "Failed to receive HTTP response: " + std::to_string(GetLastError());
+			break;
+		}
+		response.connectionReused = connection.recordRequest();
+
+		// Get response status code
+		DWORD dwStatusCode = 0;
+		DWORD dwSize = sizeof(dwStatusCode);
+		WinHttpQueryHeaders(hRequest,
+			WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+			WINHTTP_HEADER_NAME_BY_INDEX,
+			&dwStatusCode, &dwSize, WINHTTP_NO_HEADER_INDEX);
+		response.statusCode = static_cast<int>(dwStatusCode);
+
+		// Read response content; the socket only goes back to the connection once the body is read to the end
+		DWORD dwDownloaded = 0;
+		std::vector<char> buffer(10240); // 10KB buffer
+		bool readFailed = false;
+
+		do {
+			if (!WinHttpReadData(hRequest, (LPVOID)buffer.data(), static_cast<DWORD>(buffer.size()), &dwDownloaded)) {
+				response.errorMessage = "Error reading HTTP data: " + std::to_string(GetLastError());
+				readFailed = true;
+				break;
+			}
+
+			if (dwDownloaded > 0) {
+				response.body.append(buffer.data(), dwDownloaded);
+			}
+		} while (dwDownloaded > 0);
+
+		if (readFailed) {
+			break;
+		}
+		response.completed = true;
+	} while (false);
+
+	if (hRequest) WinHttpCloseHandle(hRequest);
+	if (!response.completed) {
+		// The lease closes the connection rather than handing a broken socket to the next request
+		connection.discard();
+		std::lock_guard<std::mutex> lock(mutex_);
+		failed_++;
+	}
+	return response;
+}
+
+HINTERNET WinHttpTransport::asyncConnectFor(const HttpUrl& url) {
+	if (!asyncSession_) {
+		asyncSession_ = WinHttpOpen(L"QwenAPI Client/1.0",
+			WINHTTP_ACCESS_TYPE_DEFAULT_PROXY,
+			WINHTTP_NO_PROXY_NAME,
+			WINHTTP_NO_PROXY_BYPASS,
+			WINHTTP_FLAG_ASYNC);
+		if (!asyncSession_) {
+			std::wcout << L"[WinHttpTransport] Failed to create asynchronous WinHTTP session: " << GetLastError() << std::endl;
+			return nullptr;
+		}
+		// Requests beyond this many per host wait inside WinHTTP for a connection to free up
+		DWORD maxConnections = static_cast<DWORD>((std::max)(1, options_.connections));
+		WinHttpSetOption(asyncSession_, WINHTTP_OPTION_MAX_CONNS_PER_SERVER, &maxConnections, sizeof(maxConnections));
+		WinHttpSetStatusCallback(asyncSession_, &WinHttpTransport::asyncCallback,
+			WINHTTP_CALLBACK_FLAG_ALL_COMPLETIONS | WINHTTP_CALLBACK_FLAG_HANDLES | WINHTTP_CALLBACK_FLAG_CONNECTED_TO_SERVER, 0);
+	}
+
+	HINTERNET& connect = asyncConnects_[hostKey(url)];
+	if (!connect) {
+		connect = WinHttpConnect(asyncSession_, widen(url.host).c_str(), static_cast<INTERNET_PORT>(url.port), 0);
+	}
+	return connect;
+}
+
+void WinHttpTransport::sendAsync(const HttpRequest& request, Completion done) {
+	std::unique_ptr<AsyncRequest> pending(new AsyncRequest());
+	pending->transport = this;
+	pending->done = std::move(done);
+
+	HttpUrl url;
+	HINTERNET connect = nullptr;
+	bool parsed = HttpUrl::parse(request.url, url);
+	if (parsed) {
+		std::lock_guard<std::mutex> lock(mutex_);
+		connect = asyncConnectFor(url);
+	}
+	if (connect) {
+		pending->handle = WinHttpOpenRequest(connect, widen(request.method).c_str(), widen(url.path).c_str(),
+			nullptr, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES, url.secure ? WINHTTP_FLAG_SECURE : 0);
+	}
+	if (!pending->handle) {
+		pending->response.errorMessage = !parsed ? "Invalid URL: " + request.url :
+			!connect ? std::string("Failed to connect to server") : std::string("Failed to create HTTP request");
+		std::lock_guard<std::mutex> lock(mutex_);
+		asyncStats_.failed++;
+		failed_++;
+		pending->done(pending->response);
+		return;
+	}
+
+	// From here the request belongs to its handle: the callback frees it on HANDLE_CLOSING
+	AsyncRequest* context = pending.release();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		asyncInFlight_++;
+	}
+	DWORD_PTR contextValue = reinterpret_cast<DWORD_PTR>(context);
+	WinHttpSetOption(context->handle, WINHTTP_OPTION_CONTEXT_VALUE, &contextValue, sizeof(contextValue));
+	if (request.timeoutSeconds > 0) {
+		int timeoutMs = request.timeoutSeconds * 1000;
+		WinHttpSetTimeouts(context->handle, timeoutMs, timeoutMs, timeoutMs, timeoutMs);
+	}
+
+	context->headers = headerBlock(request);
+	DWORD bodyLength = request.body ? static_cast<DWORD>(request.body->length()) : 0;
+	if (!WinHttpSendRequest(context->handle,
+		context->headers.empty() ? WINHTTP_NO_ADDITIONAL_HEADERS : context->headers.c_str(), static_cast<DWORD>(context->headers.length()),
+		bodyLength ? (LPVOID)request.body->c_str() : WINHTTP_NO_REQUEST_DATA, bodyLength,
+		bodyLength, contextValue)) {
+		finishAsync(context, "Failed to send HTTP request: " + std::to_string(GetLastError()));
+	}
+}
+
+void CALLBACK WinHttpTransport::asyncCallback(HINTERNET handle, DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLength) {
+	AsyncRequest* request = reinterpret_cast<AsyncRequest*>(context);
+	if (!request) {
+		return;     // Session and connect handles
+	}
+
+	switch (status) {
+	case WINHTTP_CALLBACK_STATUS_CONNECTED_TO_SERVER:
+		request->connected = true;
+		break;
+	case WINHTTP_CALLBACK_STATUS_SENDREQUEST_COMPLETE:
+		if (!WinHttpReceiveResponse(handle, NULL)) {
+			finishAsync(request, "Failed to receive HTTP response: " + std::to_string(GetLastError()));
+		}
+		break;
+	case WINHTTP_CALLBACK_STATUS_HEADERS_AVAILABLE: {
+		DWORD dwStatusCode = 0;
+		DWORD dwSize = sizeof(dwStatusCode);
+		WinHttpQueryHeaders(handle,
+			WINHTTP_QUERY_STATUS_CODE | WINHTTP_QUERY_FLAG_NUMBER,
+			WINHTTP_HEADER_NAME_BY_INDEX,
+			&dwStatusCode, &dwSize, WINHTTP_NO_HEADER_INDEX);
+		request->response.statusCode = static_cast<int>(dwStatusCode);
+		if (!WinHttpQueryDataAvailable(handle, NULL)) {
+			finishAsync(request, "Error reading HTTP data: " + std::to_string(GetLastError()));
+		}
+		break;
+	}
+	case WINHTTP_CALLBACK_STATUS_DATA_AVAILABLE: {
+		DWORD available = *static_cast<DWORD*>(info);
+		if (available == 0) {
+			finishAsync(request, std::string());
+			break;
+		}
+		request->buffer.resize(available);
+		if (!WinHttpReadData(handle, request->buffer.data(), available, NULL)) {
+			finishAsync(request, "Error reading HTTP data: " + std::to_string(GetLastError()));
+		}
+		break;
+	}
+	case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
+		if (infoLength == 0) {
+			finishAsync(request, std::string());
+			break;
+		}
+		request->response.body.append(static_cast<const char*>(info), infoLength);
+		if (!WinHttpQueryDataAvailable(handle, NULL)) {
+			finishAsync(request, "Error reading HTTP data: " + std::to_string(GetLastError()));
+		}
+		break;
+	case WINHTTP_CALLBACK_STATUS_REQUEST_ERROR: {
+		const WINHTTP_ASYNC_RESULT* result = static_cast<const WINHTTP_ASYNC_RESULT*>(info);
+		finishAsync(request, "HTTP request failed: " + std::to_string(result->dwError));
+		break;
+	}
+	case WINHTTP_CALLBACK_STATUS_HANDLE_CLOSING: {
+		WinHttpTransport* transport = request->transport;
+		delete request;
+		// Notify under the lock: the destructor may be waiting to free the condition variable
+		std::lock_guard<std::mutex> lock(transport->mutex_);
+		transport->asyncInFlight_--;
+		transport->asyncDrained_.notify_all();
+		break;
+	}
+	default:
+		break;
+	}
+}
+
+void WinHttpTransport::finishAsync(AsyncRequest* request, const std::string& errorMessage) {
+	if (request->finished) {
+		return;     // Callbacks that trail the close of a failed request
+	}
+	request->finished = true;
+
+	HttpResponse& response = request->response;
+	WinHttpTransport* transport = request->transport;
+	{
+		std::lock_guard<std::mutex> lock(transport->mutex_);
+		if (errorMessage.empty()) {
+			response.completed = true;
+			response.connectionReused = !request->connected;
+			transport->asyncStats_.requests++;
+			transport->asyncStats_.reused += response.connectionReused ? 1 : 0;
+			transport->asyncStats_.opened += request->connected ? 1 : 0;
+		}
+		else {
+			response.errorMessage = errorMessage;
+			transport->asyncStats_.failed++;
+			transport->failed_++;
+		}
+	}
+	request->done(response);
+
+	// HANDLE_CLOSING follows, on this thread or another, and frees the request
+	WinHttpCloseHandle(request->handle);
+}
+
+int WinHttpTransport::prewarm(const std::string& url, int count) {
+	HttpUrl parsed;
+	if (!HttpUrl::parse(url, parsed)) {
+		std::wcout << L"[WinHttpTransport] Invalid URL: " << widen(url) << std::endl;
+		return 0;
+	}
+	int connections = (std::max)(1, options_.connections);
+	if (count <= 0 || count > connections) {
+		count = connections;
+	}
+	// Warms the asynchronous session, which every request of the request engine is sent from
+	int warmed = prewarmAsync(url, count);
+	std::wcout << L"[WinHttpTransport] Pre-warmed " << warmed << L"/" << count << L" connections to "
+		<< widen(hostKey(parsed)) << std::endl;
+	return warmed;
+}
+
+HttpTransport::Statistics WinHttpTransport::getStatistics() const {
+	Statistics stats;
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const auto& entry : pools_) {
+		HttpConnectionPool::Statistics poolStats = entry.second->getStatistics();
+		stats.requests += poolStats.requests;
+		stats.reused += poolStats.reused;
+		stats.opened += poolStats.opened;
+		stats.waits += poolStats.waits;
+	}
+	stats.requests += asyncStats_.requests;
+	stats.reused += asyncStats_.reused;
+	stats.opened += asyncStats_.opened;
+	stats.failed = failed_;
+	return stats;
+}
+
+void WinHttpTransport::logStatistics() const {
+	std::vector<std::shared_ptr<HttpConnectionPool>> pools;
+	uint64_t failed = 0;
+	Statistics async;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		for (const auto& entry : pools_) {
+			pools.push_back(entry.second);
+		}
+		failed = failed_;
+		async = asyncStats_;
+	}
+	for (const auto& pool : pools) {
+		pool->logStatistics();
+	}
+	if (async.requests + async.failed > 0) {
+		std::wcout << L"[WinHttpTransport] Asynchronous requests: " << async.requests << L", on a reused connection: " << async.reused
+			<< L", connections opened: " << async.opened << std::endl;
+	}
+	std::wcout << L"[WinHttpTransport] Failed requests: " << failed << std::endl;
+}
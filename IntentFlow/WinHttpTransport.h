@@ -0,0 +1,46 @@
+#pragma once
+#include "HttpTransport.h"
+#include "HttpConnectionPool.h"
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+// HttpTransport over WinHTTP, with one HttpConnectionPool per scheme, host and port. Asynchronous requests
+// go through a separate WINHTTP_FLAG_ASYNC session whose callbacks run on the WinHTTP thread pool, so any
+// number of them can be in flight without a thread each; prewarm() opens that session's connections.
+class WinHttpTransport : public HttpTransport {
+public:
+    explicit WinHttpTransport(const Options& options);
+    ~WinHttpTransport();
+
+    WinHttpTransport(const WinHttpTransport&) = delete;
+    WinHttpTransport& operator=(const WinHttpTransport&) = delete;
+
+    HttpResponse send(const HttpRequest& request) override;
+    void sendAsync(const HttpRequest& request, Completion done) override;
+    int prewarm(const std::string& url, int count) override;
+    Statistics getStatistics() const override;
+    void logStatistics() const override;
+
+private:
+    // Requests hold a reference, so a pool outlives the transport until its last request ends
+    std::shared_ptr<HttpConnectionPool> poolFor(const HttpUrl& url);
+
+    // One asynchronous request: the context of its request handle, freed when the handle closes
+    struct AsyncRequest;
+    static void CALLBACK asyncCallback(HINTERNET handle, DWORD_PTR context, DWORD status, LPVOID info, DWORD infoLength);
+    static void finishAsync(AsyncRequest* request, const std::string& errorMessage);
+    HINTERNET asyncConnectFor(const HttpUrl& url);     // Called with mutex_ held
+
+    Options options_;
+    mutable std::mutex mutex_;
+    std::map<std::string, std::shared_ptr<HttpConnectionPool>> pools_;    // Keyed by scheme://host:port
+    uint64_t failed_ = 0;
+
+    // Asynchronous session, created on first use; WinHTTP keeps its connections per host
+    HINTERNET asyncSession_ = nullptr;
+    std::map<std::string, HINTERNET> asyncConnects_;
+    int asyncInFlight_ = 0;
+    std::condition_variable asyncDrained_;
+    Statistics asyncStats_;
+};
@@ -0,0 +1,81 @@
+#include "pch.h"
+#include "WorkerPool.h"
+#include <chrono>
+#include <algorithm>
+
+WorkerPool::WorkerPool(size_t threadCount, size_t queueCapacity) {
+	if (threadCount == 0) {
+		threadCount = std::thread::hardware_concurrency();
+	}
+	if (threadCount == 0) {
+		threadCount = 1;
+	}
+	queueCapacity_ = queueCapacity > 0 ? queueCapacity : threadCount * 2;
+
+	workers_.reserve(threadCount);
+	for (size_t i = 0; i < threadCount; ++i) {
+		workers_.emplace_back(&WorkerPool::workerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	notEmpty_.notify_all();
+	notFull_.notify_all();
+
+	// Workers drain the remaining queue before exiting, so outstanding futures are still fulfilled
+	for (auto& worker : workers_) {
+		if (worker.joinable()) {
+			worker.join();
+		}
+	}
+}
+
+void WorkerPool::enqueue(std::function<void()> job) {
+	std::unique_lock<std::mutex> lock(mutex_);
+	notFull_.wait(lock, [this]() { return stopping_ || queue_.size() < queueCapacity_; });
+	if (stopping_) {
+		// Run inline rather than dropping the job, so the caller's future never hangs
+		lock.unlock();
+		job();
+		return;
+	}
+
+	queue_.push_back(std::move(job));
+	stats_.submitted++;
+	stats_.maxQueueDepth = (std::max)(stats_.maxQueueDepth, queue_.size());
+	lock.unlock();
+	notEmpty_.notify_one();
+}
+
+void WorkerPool::workerLoop() {
+	for (;;) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			notEmpty_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+			if (queue_.empty()) {
+				return; // Stopping and nothing left to do
+			}
+			job = std::move(queue_.front());
+			queue_.pop_front();
+		}
+		notFull_.notify_one();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		job();
+		double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		stats_.completed++;
+		stats_.busyMs += elapsedMs;
+	}
+}
+
+WorkerPool::Statistics WorkerPool::getStatistics() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return stats_;
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <cstdint>
+
+// Fixed-size worker pool with a bounded job queue.
+// submit() blocks while the queue is full, which keeps producers (the batch loop) at most a
+// queue's worth of jobs ahead of the workers.
+class WorkerPool {
+public:
+    struct Statistics {
+        uint64_t submitted = 0;
+        uint64_t completed = 0;
+        size_t maxQueueDepth = 0;
+        double busyMs = 0.0;        // Sum of job run times over all workers
+    };
+
+    // threadCount 0 uses the number of hardware threads; queueCapacity 0 uses 2 * threadCount
+    explicit WorkerPool(size_t threadCount = 0, size_t queueCapacity = 0);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    template <typename F>
+    auto submit(F task) -> std::future<decltype(task())> {
+        typedef decltype(task()) Result;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> future = packaged->get_future();
+        enqueue([packaged]() { (*packaged)(); });
+        return future;
+    }
+
+    size_t threadCount() const { return workers_.size(); }
+    size_t queueCapacity() const { return queueCapacity_; }
+    Statistics getStatistics() const;
+
+private:
+    void enqueue(std::function<void()> job);
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> queue_;
+    size_t queueCapacity_;
+    bool stopping_ = false;
+
+    mutable std::mutex mutex_;
+    std::condition_variable notEmpty_;
+    std::condition_variable notFull_;
+    Statistics stats_;
+};
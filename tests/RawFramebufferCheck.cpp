@@ -0,0 +1,90 @@
+// Runs RawFramebuffer over in-memory screencap dumps with both header layouts: the 12-byte one of older
+// devices and the 16-byte one with the color space field (Android 9+). Exits non-zero on the first mismatch.
+#include "RawFramebuffer.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace {
+	int failures = 0;
+
+	void check(bool condition, const char* what) {
+		if (!condition) {
+			std::wcout << L"[RawFramebufferCheck] FAILED: " << what << std::endl;
+			failures++;
+		}
+	}
+
+	void putLE32(std::vector<unsigned char>& bytes, uint32_t value) {
+		for (int i = 0; i < 4; ++i) {
+			bytes.push_back(static_cast<unsigned char>(value >> (8 * i)));
+		}
+	}
+
+	// A width x height dump whose pixel bytes count up from 0, so each pixel can be told apart
+	std::vector<unsigned char> makeDump(int width, int height, RawFramebuffer::PixelFormat format, bool colorSpace) {
+		std::vector<unsigned char> bytes;
+		putLE32(bytes, static_cast<uint32_t>(width));
+		putLE32(bytes, static_cast<uint32_t>(height));
+		putLE32(bytes, static_cast<uint32_t>(format));
+		if (colorSpace) {
+			putLE32(bytes, 1);      // sRGB
+		}
+		size_t pixelBytes = (size_t)width * height * RawFramebuffer::bytesPerPixel(format);
+		for (size_t i = 0; i < pixelBytes; ++i) {
+			bytes.push_back(static_cast<unsigned char>(i));
+		}
+		return bytes;
+	}
+
+	void checkDump(int width, int height, RawFramebuffer::PixelFormat format, bool colorSpace, int matType) {
+		std::vector<unsigned char> dump = makeDump(width, height, format, colorSpace);
+		size_t headerSize = colorSpace ? 16 : 12;
+		int pixelSize = RawFramebuffer::bytesPerPixel(format);
+
+		RawFramebuffer::Header header;
+		check(RawFramebuffer::parseHeader(dump.data(), dump.size(), header), "parseHeader accepts the dump");
+		check(header.width == width && header.height == height, "parseHeader size");
+		check(header.format == format && header.bytesPerPixel == pixelSize, "parseHeader format");
+		check(header.headerSize == headerSize, "parseHeader header layout");
+
+		// One byte more or less is no dump at all
+		std::vector<unsigned char> truncated(dump.begin(), dump.end() - 1);
+		check(!RawFramebuffer::parseHeader(truncated.data(), truncated.size(), header), "parseHeader rejects a truncated dump");
+		std::vector<unsigned char> padded = dump;
+		padded.push_back(0);
+		check(!RawFramebuffer::parseHeader(padded.data(), padded.size(), header), "parseHeader rejects trailing bytes");
+
+		// Starts from a buffer with stale contents, as when the pipeline reuses one across captures
+		std::istringstream in(std::string(dump.begin(), dump.end()));
+		std::vector<unsigned char> bytes(3 * dump.size(), 0xFF);
+		check(RawFramebuffer::read(in, bytes), "read accepts the dump");
+		check(bytes == dump, "read returns the bytes of the stream");
+
+		cv::Mat pixels;
+		check(RawFramebuffer::wrap(bytes, pixels, header), "wrap accepts the dump");
+		check(pixels.rows == height && pixels.cols == width && pixels.type() == matType, "wrap size and type");
+		check(pixels.data == bytes.data() + headerSize, "wrap points into the buffer without copying");
+		size_t lastPixel = (size_t)(height - 1) * width + (width - 1);
+		check(pixels.data[lastPixel * pixelSize] == static_cast<unsigned char>(lastPixel * pixelSize), "wrap pixel layout");
+	}
+}
+
+int main() {
+	checkDump(3, 2, RawFramebuffer::PixelFormat::RGBA_8888, false, CV_8UC4);
+	checkDump(3, 2, RawFramebuffer::PixelFormat::RGBA_8888, true, CV_8UC4);
+	checkDump(5, 4, RawFramebuffer::PixelFormat::RGB_888, false, CV_8UC3);
+	checkDump(5, 4, RawFramebuffer::PixelFormat::RGB_565, true, CV_8UC2);
+
+	// A PNG is never taken for a dump
+	const unsigned char png[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R' };
+	RawFramebuffer::Header header;
+	check(!RawFramebuffer::parseHeader(png, sizeof(png), header), "parseHeader rejects a PNG");
+
+	if (failures == 0) {
+		std::wcout << L"[RawFramebufferCheck] All checks passed" << std::endl;
+	}
+	return failures == 0 ? 0 : 1;
+}